@@ -13,35 +13,87 @@ const int DEFAULT_DISK_SIZE = 524288000;
 // Limits for names and paths
 const int MAX_FILENAME_LENGTH = 255;       // Maximum length for a single filename
 const int MAX_PATH_LENGTH = 1024;          // Maximum length for a full path
-const int MAX_SYSTEM_OPEN_FILES = 64;      // Maximum number of files that can be opened system-wide
-const int MAX_OPEN_FILES_PER_PROCESS = 16; // Maximum number of files that can be opened by a single process
+const int DEFAULT_MAX_SYSTEM_OPEN_FILES = 4096;      // Default system-wide open file limit (configurable per FileSystem)
+const int DEFAULT_MAX_OPEN_FILES_PER_PROCESS = 1024; // Default per-process open file limit (configurable per FileSystem)
 
 // Block and Inode related constants
 const int NUM_DIRECT_BLOCKS = 10;      // Number of direct block pointers in an Inode struct
-const int DEFAULT_BLOCK_SIZE = 1024;   // Default block size in bytes.
-                                       // While SuperBlock stores actual block_size for a formatted disk,
-                                       // this can be used for array sizing in structs like FreeBlockGroup.
-const int INODE_SIZE_BYTES = 128;      // Assumed size of an Inode struct for calculations if needed.
-                                       // Actual Inode struct size will be determined by its members.
-const int DEFAULT_TOTAL_INODES = 1024; // Default number of inodes to create during format.
+const int DEFAULT_BLOCK_SIZE = 1024;   // Block size used when formatting unless another one is requested.
+                                       // The block size of a formatted disk is SuperBlock::block_size.
+const int MIN_BLOCK_SIZE = 1024;       // Supported block sizes are powers of two in [MIN_BLOCK_SIZE, MAX_BLOCK_SIZE]
+const int MAX_BLOCK_SIZE = 65536;
+const int INODE_SIZE_BYTES = 256;      // On-disk inode slot size; sizeof(Inode) must not exceed it.
+const int DEFAULT_INITIAL_INODES = 64;  // Inodes provisioned at format; further inode chunks are allocated on demand.
+
+// Block cache and sequential readahead
+const long long DEFAULT_BLOCK_CACHE_BYTES = 4LL * 1024 * 1024; // Memory budget of VirtualDisk's LRU block cache
+const int READAHEAD_INITIAL_BLOCKS = 4;      // Readahead window after the first sequential read is detected
+const int READAHEAD_MAX_BLOCKS = 256;        // Upper bound the window doubles towards on continued sequential access
+
+// Write-back block cache flusher
+const int DIRTY_BACKGROUND_RATIO_PERCENT = 10; // Dirty share of the block cache that wakes the flusher to write everything back
+const int DIRTY_EXPIRE_MS = 3000;              // Dirty blocks older than this are written back on the flusher's next pass
+const int FLUSHER_INTERVAL_MS = 500;           // Period of the background flusher thread
+const int IO_QUEUE_DEPTH = 32;                 // Block I/O requests kept in flight by the io_uring backend
+const int IO_MAX_RUN_BYTES = 256 * 1024;       // Upper bound of one coalesced multi-block request
+
+// O_DIRECT and aligned buffers
+const int DIRECT_IO_ALIGNMENT = 4096;   // Address/offset/length alignment required for O_DIRECT I/O
+const int BUFFER_POOL_MAX_FREE = 256;   // Block buffers kept for reuse by VirtualDisk's aligned buffer pool
+
+// Metadata journal (write-ahead log between the inode bitmap and the data area)
+const int JOURNAL_DISK_FRACTION = 64;                  // Journal size is 1/JOURNAL_DISK_FRACTION of the disk ...
+const int JOURNAL_MIN_BLOCKS = 64;                     // ... but at least this many blocks (smaller disks get no journal)
+const long long JOURNAL_MAX_BYTES = 32LL * 1024 * 1024; // ... and at most this many bytes
+const int JOURNAL_COMMIT_INTERVAL_MS = 1000;           // Group commit: closed transactions are written to the journal together
+                                                       // once the oldest is this old, or when the running batch grows large
+const int JOURNAL_MAGIC_NUMBER = 0x4A524E4C;           // "JRNL", stamped on every journal block
+
+// Log-structured layout (optional, chosen at format): write-back appends every block to a log of segments
+const long long LOG_SEGMENT_BYTES = 1024 * 1024;    // Segment size; the cleaner always frees whole segments
+const int LOG_MIN_SEGMENT_BLOCKS = 16;              // Lower bound for large block sizes
+const int LOG_OVERPROVISION_PERCENT = 15;           // Segment space never handed to the file system, so cleaning always gains
+const int LOG_RESERVED_SEGMENTS = 2;                // Free segments only the cleaner may write into
+const int LOG_BACKGROUND_CLEAN_SEGMENTS = 8;        // The flusher cleans one segment per pass while fewer are free
+const int LOG_CHECKPOINT_SEGMENTS = 64;             // Segments filled between block map checkpoints (bounds roll-forward)
+const long long LOG_MAX_LOGICAL_BLOCKS = 1LL << 26; // The block map lives in memory (8 bytes per block); larger disks are capped
+const int LOG_MAGIC_NUMBER = 0x4C4F4753;            // "LOGS", on the log header and every segment summary
+
+// Write-behind buffering of small sequential writes
+const int WRITE_BUFFER_BLOCKS = 8;        // Buffered blocks per open file before whole blocks are flushed
+const int WRITE_BUFFER_MAX_AGE_MS = 1000; // Buffered data older than this is flushed by the next write or the background thread
+
+// Deferred deletion: rm unlinks at once and a background thread reclaims the orphaned inodes
+const int RECLAIM_SLICE_INODES = 256; // Inodes reclaimed per journal transaction; operations wait for at most one slice
+
+// Filename index: trigram posting lists are compacted once stale postings outnumber live ones
+const size_t TRIGRAM_COMPACT_MIN_STALE = 65536;
+
+// Block addresses are 64-bit so that images and files are not capped at 2^31 blocks
+typedef long long BlockId;
 
 // 成组链接法 (Grouped Free Block List) constants
-// Assuming block IDs and counts are stored as 'int'
-const int BLOCK_ID_TYPE_SIZE = sizeof(int);
-// Number of free block IDs that can be stored in a FreeBlockGroup block,
-// excluding the 'count' field itself. This must be a compile-time constant
-// for the FreeBlockGroup struct's array definition.
-const int N_FREE_BLOCKS_PER_GROUP = (DEFAULT_BLOCK_SIZE / BLOCK_ID_TYPE_SIZE) - 1;
+// Block IDs and the group's count are stored as BlockId
+const int BLOCK_ID_TYPE_SIZE = sizeof(BlockId);
+// A FreeBlockGroup block holds (block_size / BLOCK_ID_TYPE_SIZE) - 1 block IDs after its 'count'
+// field; the number depends on the formatted block size and is computed at runtime.
 
 // File System Identification
 const int FILESYSTEM_MAGIC_NUMBER = 0xDA05F50A; // "DAOS FS0A" - A unique magic number for your filesystem
+const int FILESYSTEM_FORMAT_VERSION = 8;        // On-disk layout version: 2 = 64-bit block pointers, triple indirection,
+                                                // 3 = inode chunks allocated on demand, 4 = lazy format (untouched free extent,
+                                                // lazily zeroed inode bitmap), 5 = metadata journal,
+                                                // 6 = shared block reference counts (reflink), 7 = orphan directory,
+                                                // 8 = filename index.
+                                                // Older disks must be reformatted.
 
 // Known/Reserved Inode IDs
 const int ROOT_DIRECTORY_INODE_ID = 0; // Typically, the root directory has a fixed inode ID (e.g., 0 or 1)
+const int ORPHAN_DIRECTORY_INODE_ID = 1; // Hidden directory holding unlinked inodes until the reclaimer frees them
 
 // Invalid ID sentinels
 const int INVALID_INODE_ID = -1;
-const int INVALID_BLOCK_ID = -1;
+const BlockId INVALID_BLOCK_ID = -1;
 const int INVALID_FD = -1;
 
 // =====================================================================================
@@ -91,6 +143,37 @@ enum class FileType : short
     // BLOCK_DEVICE
 };
 
+/**
+ * @brief Whether the volume was written back and unmounted cleanly.
+ * Used in SuperBlock::state. DIRTY is zero so that a superblock that never recorded a clean unmount reads as dirty.
+ */
+enum class VolumeState : int
+{
+    DIRTY, // Mounted, or the last session did not unmount cleanly
+    CLEAN  // Every dirty block was written back before the volume was released
+};
+
+/**
+ * @brief How blocks are placed on the disk image, chosen at format.
+ * A log-structured image is recognised at mount by the LOG_MAGIC_NUMBER header in its first block.
+ */
+enum class DiskLayout : int
+{
+    IN_PLACE,      // Block N lives at offset N * block_size and is overwritten in place
+    LOG_STRUCTURED // Blocks are remapped and every write-back is appended sequentially to a segment log
+};
+
+/**
+ * @brief Kind of a block in the journal region.
+ * Used in JournalBlockHeader::type.
+ */
+enum class JournalBlockType : int
+{
+    SUPERBLOCK = 1, // First block of the region: where the log starts
+    DESCRIPTOR,     // Home locations of the block images that follow it
+    COMMIT          // Ends a transaction; carries a checksum over its blocks
+};
+
 /**
  * @brief Defines modes for opening files.
  * Used in open() command and SystemOpenFileEntry.
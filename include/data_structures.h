@@ -1,11 +1,31 @@
 #ifndef DATA_STRUCTURES_H
 #define DATA_STRUCTURES_H
 #include "common_defs.h"
+#include <vector>
+#include <stack>
+#include <unordered_map>
+#include <chrono>
+
+// 每个打开文件的顺序预读状态
+struct ReadaheadState
+{
+    long long next_offset = 0;         // 顺序访问时下一次读取应开始的偏移量
+    long long readahead_end_block = 0; // 已预读到的逻辑块上界 (不含)
+    int window_blocks = 0;             // 当前预读窗口 (块)，0 表示尚未检测到顺序访问
+};
 
 struct ProcessOpenFileEntry
 {
     int system_table_idx;     // 指向系统级打开文件表中对应条目的索引
     long long current_offset; // 当前读写指针位置
+    ReadaheadState readahead; // 顺序预读状态
+};
+
+// readv/writev 使用的缓冲区描述 (对应 POSIX struct iovec)
+struct IoVec
+{
+    char *base; // 缓冲区起始地址 (writev 时只读取)
+    int length; // 缓冲区长度 (字节)
 };
 
 struct SuperBlock
@@ -13,27 +33,43 @@ struct SuperBlock
     int magic_number;            // 文件系统魔数
     long long total_blocks;      // 虚拟磁盘总块数
     long long free_blocks_count; // 空闲数据块数量
-    int total_inodes;            // i-node总数
-    int free_inodes_count;       // 空闲i-node数量
+    int total_inodes;            // 已分配的 i-node 块提供的 i-node 总数 (按需增长)
+    int free_inodes_count;       // 其中空闲i-node数量
     int block_size;              // 每块大小 (例如 1024 bytes)
     int inode_size;              // 每个i-node大小
 
     // i-node 位图信息
     int inode_bitmap_start_block_idx; // i-node位图的起始块号
     int inode_bitmap_blocks_count;    // i-node位图占用的块数
+    int max_inodes;                   // i-node位图能描述的 i-node 数上限
+    int inode_bitmap_initialized_blocks; // 已清零的位图块数，其后的位图块在 i-node 表增长到那里时才清零
+
+    // 元数据日志区 (紧随 i-node 位图之后)，journal_blocks_count 为 0 表示没有日志
+    BlockId journal_start_block_idx; // 日志区第一块 (日志超级块) 的块号
+    int journal_blocks_count;        // 日志区块数
 
-    // i-node 表信息
-    int inode_table_start_block_idx; // i-node表的起始块号
-                                     // (i-node表的块数可以根据total_inodes, inode_size, block_size计算得到)
+    // i-node 表信息: i-node 块 (chunk) 按需从数据区分配，每块存放 block_size / inode_size 个 i-node。
+    // 各 chunk 的块号依次记录在 chunk 映射块链中，映射块的 [0] 为下一个映射块。
+    BlockId inode_chunk_map_head_idx; // 第一个 chunk 映射块的块号
+    int inode_chunk_count;            // 已分配的 chunk 数
 
     int first_data_block_idx; // 第一个数据块的起始块号
     int root_dir_inode_idx;   // 根目录的inode号
+    int orphan_dir_inode_idx; // 孤儿目录的inode号: 已删除、尚未回收的 i-node 登记在这里
+    int name_index_inode_idx; // 文件名索引文件的inode号，INVALID_INODE_ID 表示没有建立索引
 
     // 成组链接法相关
-    int free_block_stack_top_idx; // 空闲块堆栈顶块的块号 (栈中第一个块)
+    BlockId free_block_stack_top_idx; // 空闲块堆栈顶块的块号 (栈中第一个块)
+    BlockId free_extent_start_idx;    // [free_extent_start_idx, total_blocks) 为从未分配过的空闲块，不在堆栈中
+
+    // 共享块引用计数表 (reflink): 被不止一处引用的块登记在表块链中，未登记的块引用数为 1
+    BlockId block_refcount_head_idx; // 第一个引用计数表块的块号
+    long long shared_blocks_count;   // 表中登记的共享块数
 
     int max_filename_length; // 最大文件名长度
     int max_path_length;     // 最大路径长度
+    int format_version;      // 磁盘布局版本 (FILESYSTEM_FORMAT_VERSION)，旧格式的磁盘此处为 0
+    VolumeState state;       // 挂载时置为 DIRTY，卸载前写回全部数据后置为 CLEAN
 };
 
 struct Inode
@@ -48,11 +84,12 @@ struct Inode
     long long creation_time;              // 创建时间 (时间戳)
     long long modification_time;          // 最后修改时间 (时间戳)
     long long access_time;                // 最后访问时间 (时间戳)
-    int direct_blocks[NUM_DIRECT_BLOCKS]; // 直接数据块指针 (NUM_DIRECT_BLOCKS 在 common_defs.h 定义)
-    int single_indirect_block;            // 一级间接数据块指针
-    int double_indirect_block;            // 二级间接数据块指针
-    // int triple_indirect_block; // 三级间接数据块指针 (根据需要可选)
+    BlockId direct_blocks[NUM_DIRECT_BLOCKS]; // 直接数据块指针 (NUM_DIRECT_BLOCKS 在 common_defs.h 定义)
+    BlockId single_indirect_block;            // 一级间接数据块指针
+    BlockId double_indirect_block;            // 二级间接数据块指针
+    BlockId triple_indirect_block;            // 三级间接数据块指针
 };
+static_assert(sizeof(Inode) <= INODE_SIZE_BYTES, "Inode 超出 i-node 表槽位大小");
 
 struct DirectoryEntry
 {
@@ -60,10 +97,73 @@ struct DirectoryEntry
     int inode_id;                       // 对应的i-node编号
 };
 
+// 文件名索引文件中的一个槽位，parent_inode_id 为 INVALID_INODE_ID 表示空槽
+struct NameIndexSlot
+{
+    int parent_inode_id;  // 目录项所在目录的inode号
+    DirectoryEntry entry;
+};
+
 struct FreeBlockGroup
 {
-    int count;                                                   // 本组空闲块数量 (最多 N_FREE_BLOCKS_PER_GROUP)
-    int next_group_block_ids[/*N_FREE_BLOCKS_PER_GROUP_CONST*/]; // 指向下一组空闲块的块号
+    BlockId count;                  // 本组空闲块数量 (最多 block_size / BLOCK_ID_TYPE_SIZE - 1)，占一个块号槽位
+    BlockId next_group_block_ids[]; // 指向下一组空闲块的块号，长度由块大小决定
+};
+
+// 引用计数表块: [0] 槽位为下一个表块的块号，其后每项占两个块号槽位
+struct BlockRefCount
+{
+    BlockId block_id;   // 共享的数据块或间接块
+    BlockId references; // 引用数 (>= 2)
+};
+
+// 日志区: 第一块是日志超级块 (只有 JournalBlockHeader)，其后依次存放事务。
+// 一个事务由若干个 "描述块 + 它登记的块映像" 和一个提交块组成，都带有相同的序号。
+struct JournalBlockHeader
+{
+    int magic;             // JOURNAL_MAGIC_NUMBER
+    JournalBlockType type; // 块的种类
+    long long sequence;    // 事务序号；日志超级块中为日志里第一个事务的序号
+};
+
+struct JournalDescriptor
+{
+    JournalBlockHeader header;
+    long long count;     // 之后紧跟的块映像数
+    BlockId block_ids[]; // 各块映像的原位置，长度由块大小决定
+};
+
+struct JournalCommit
+{
+    JournalBlockHeader header;
+    long long block_count;       // 事务包含的块映像总数
+    unsigned long long checksum; // 覆盖全部块号和块映像，用于识别写了一半的事务
+};
+
+// 日志结构布局的映像: 物理块 0 是 LogHeader，其后是检查点块映射 (逻辑块号 -> 物理块号，每项一个 BlockId)，
+// 再往后是等长的段。段由若干部分段顺序组成，每个部分段是一个摘要块加上它登记的块。
+struct LogHeader
+{
+    int magic;                     // LOG_MAGIC_NUMBER
+    int block_size;                // 块大小 (逻辑块与物理块相同)
+    long long logical_blocks;      // 文件系统看到的块数
+    BlockId map_start_block;       // 检查点块映射的第一个物理块
+    long long map_blocks;          // 检查点块映射占用的块数
+    BlockId segments_start_block;  // 第一个段的物理块号
+    long long segment_count;       // 段数
+    long long segment_blocks;      // 每段块数
+    long long checkpoint_sequence; // 检查点包含的最后一个部分段序号；序号更大的部分段在挂载时前滚
+    long long map_initialized_blocks; // 映射区中写过的块数，之后的块是旧映像的残留 (格式化时不清零映射区)
+    unsigned long long log_id;     // 格式化时随机生成，参与摘要校验和: 旧映像残留的摘要不会被误认
+};
+
+struct LogSummary
+{
+    int magic;                   // LOG_MAGIC_NUMBER
+    int count;                   // 之后紧跟的块数
+    long long sequence;          // 全局递增的部分段序号
+    unsigned long long checksum; // 覆盖 sequence、count 和 block_ids，识别写了一半的摘要块
+    BlockId block_ids[];         // 各块的逻辑块号，长度由块大小决定
 };
 
 struct User
@@ -74,12 +174,30 @@ struct User
     int home_directory_inode_id; // 用户家目录的inode编号
 };
 
+// 写缓冲 (write-behind): 合并连续的小写入，缓冲满、超时、close 或 fsync 时写出
+struct WriteBuffer
+{
+    std::vector<char> data;                                 // 尚未写入磁盘的数据
+    long long start_offset = 0;                             // data[0] 对应的文件偏移
+    std::chrono::steady_clock::time_point first_write_time; // 缓冲中最早数据的写入时间
+};
+
 struct SystemOpenFileEntry
 {
-    int inode_id;      // 文件的inode编号
-    Inode inode_cache; // inode的内存副本，避免频繁读盘
-    OpenMode mode;     // 打开模式 (read, write, append)
-    int open_count;    // 此文件被打开的次数 (被多少个进程级表项引用)
+    int inode_id;             // 文件的inode编号
+    Inode inode_cache;        // inode的内存副本，避免频繁读盘
+    OpenMode mode;            // 打开模式 (read, write, append)
+    int open_count;           // 此文件被打开的次数 (被多少个进程级表项引用)
+    WriteBuffer write_buffer; // 该打开文件的写缓冲，所有引用它的 fd 共享
+};
+
+// 系统级打开文件表: inode号到表项下标的哈希索引 + 空闲槽位栈, 查找/打开/关闭均为 O(1)
+struct SystemOpenFileTable
+{
+    std::vector<SystemOpenFileEntry> entries;  // 表项, 下标即 system_table_idx
+    std::unordered_map<int, int> inode_index;  // inode_id -> entries 下标 (仅包含正在使用的表项)
+    std::stack<int> free_slots;                // 已释放、可复用的 entries 下标
+    int max_entries = DEFAULT_MAX_SYSTEM_OPEN_FILES;
 };
 
 #endif // DATA_STRUCTURES_H
\ No newline at end of file
@@ -4,27 +4,67 @@
 #include "fs_core/inode_manager.h"
 #include "fs_core/datablock_manager.h"
 #include "fs_core/superblock_manager.h"
+#include "file_operations/name_index.h"
 #include "data_structures.h"
 #include "common_defs.h"
 #include <vector>
 #include <string>
 #include <iostream>
 
+class DirectoryManager;
+
+// Streams the entries of one directory block by block. Only a single block buffer is held,
+// entries are handed out as pointers into it, and cookie() can be used to resume later.
+class DirectoryIterator
+{
+public:
+    bool next(const DirectoryEntry *&entry); // false at end of directory (or on read error, see failed())
+    long long cookie() const;                // opaque resume position, pass to DirectoryManager::openDirectory
+    bool failed() const;
+
+private:
+    friend class DirectoryManager;
+    DirectoryIterator(InodeManager *inodeManager, VirtualDisk *vdisk, const Inode &dirInode, int blockSize, long long cookie);
+    bool loadBlock(long long logicalBlock);
+
+    InodeManager *inode_manager_;
+    VirtualDisk *vdisk_;
+    Inode dir_inode_;
+    int block_size_;
+    int entries_per_block_;
+    long long entry_count_;
+    long long next_index_;        // index of the next slot to examine
+    long long loaded_block_;      // logical block currently in block_buffer_, -1 if none
+    BlockId loaded_block_id_;     // physical block id of loaded_block_
+    AlignedBuffer block_buffer_;
+    DirectoryEntry *current_;     // last entry returned by next(), points into block_buffer_
+    bool failed_;
+};
+
 class DirectoryManager
 {
 public:
     DirectoryManager(DataBlockManager *dbManager, InodeManager *inodeManager, SuperBlockManager *sbManager);
     bool addEntry(Inode &parentDirInode, const std::string &name, int entryInodeId, FileType type); // FileType 在 common_defs.h
+    bool appendEntries(Inode &dirInode, const std::vector<DirectoryEntry> &entries); // bulk add to a directory without holes; names must be new
     bool removeEntry(Inode &parentDirInode, const std::string &name);
+    bool replaceEntry(Inode &dirInode, const std::string &name, int entryInodeId); // repoints an existing name in place
+    int takeEntries(Inode &dirInode, int maxEntries, std::vector<DirectoryEntry> &taken); // pops live entries off the end, returns how many
     int findEntry(Inode &dirInode, const std::string &name) const;
     std::vector<DirectoryEntry> listEntries(Inode &dirInode) const;                                                           // DirectoryEntry 在 data_structures.h
+    DirectoryIterator openDirectory(const Inode &dirInode, long long cookie = 0) const;                                        // cookie 0 starts at the first entry
+    void prefetchDirectories(std::vector<Inode> &dirInodes);                                                                  // reads the entry blocks of all of them in one batch
     int resolvePathToInode(const std::string &path, int currentDirInodeId, int rootDirInodeId, const User *currentUser, // User 在 data_structures.h
                            int *parentInodeId = nullptr, std::string *lastName = nullptr, bool followLastLink = true);
     int createDirectoryInode(short ownerUid, short permissions);
+    void setNameIndex(NameIndex *nameIndex); // entry changes are mirrored into it while it is enabled
 
 private:
     DataBlockManager *db_manager_;
     InodeManager *inode_manager_;
     SuperBlockManager *sb_manager_;
+    NameIndex *name_index_;
+
+    bool indexed(const Inode &dirInode, const std::string &name) const;
 };
 #endif // DIRECTORY_MANAGER_H
\ No newline at end of file
@@ -17,13 +17,24 @@ class FileManager
 public:
     FileManager(DataBlockManager *dbManager, InodeManager *inodeManager, SuperBlockManager *sbManager, DirectoryManager *dirManager);
     int createFileInode(short ownerUid, short permissions);
-    int openFile(int inodeId, OpenMode mode, std::vector<ProcessOpenFileEntry> &processOpenFileTable, std::vector<SystemOpenFileEntry> &systemOpenFileTable); // OpenMode, ProcessOpenFileEntry, SystemOpenFileEntry
-    bool closeFile(int fd, std::vector<ProcessOpenFileEntry> &processOpenFileTable, std::vector<SystemOpenFileEntry> &systemOpenFileTable);
-    int readFile(int fd, char *buffer, int length, const std::vector<ProcessOpenFileEntry> &processOpenFileTable, std::vector<SystemOpenFileEntry> &systemOpenFileTable);
-    int writeFile(int fd, const char *buffer, int length, std::vector<ProcessOpenFileEntry> &processOpenFileTable, std::vector<SystemOpenFileEntry> &systemOpenFileTable);
+    int openFile(int inodeId, OpenMode mode, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable); // OpenMode, ProcessOpenFileEntry, SystemOpenFileEntry
+    bool closeFile(int fd, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable);
+    int readFile(int fd, char *buffer, int length, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable);
+    int writeFile(int fd, const char *buffer, int length, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable);
+    // Positional variants: operate at an explicit offset and never touch current_offset
+    int readFileAt(int fd, char *buffer, int length, long long offset, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable);
+    int writeFileAt(int fd, const char *buffer, int length, long long offset, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable);
+    // Vectored variants: the iovec array is transferred as one contiguous range starting at offset
+    int readFileVecAt(int fd, const IoVec *iov, int iovcnt, long long offset, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable);
+    int writeFileVecAt(int fd, const IoVec *iov, int iovcnt, long long offset, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable);
     bool deleteFileByInode(int inodeId);
+    // Write-behind buffer: writeFile buffers small sequential writes; every other path flushes first
+    bool flushWriteBuffer(SystemOpenFileEntry &sysEntry, bool wholeBlocksOnly = false);
+    bool syncFile(int fd, std::vector<ProcessOpenFileEntry> &processOpenFileTable, SystemOpenFileTable &systemOpenFileTable);
 
 private:
+    void releaseSystemEntry(int systemIdx, SystemOpenFileTable &systemOpenFileTable);
+
     DataBlockManager *db_manager_;
     InodeManager *inode_manager_;
     SuperBlockManager *sb_manager_;
@@ -0,0 +1,72 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include "fs_core/inode_manager.h"
+#include "fs_core/datablock_manager.h"
+#include "data_structures.h"
+#include "common_defs.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+// Optional filename index used by FileSystem::find. Every directory entry (except "." and "..")
+// has one fixed-size slot in a hidden index file; the whole index is held in memory, hashed by
+// name, by (directory, name) and by the entry's inode. DirectoryManager keeps it current as
+// entries are added, removed or repointed, so each change rewrites a single slot.
+// Paths are not stored: they are rebuilt by following the entries of the parent directories up
+// to the root, which also drops entries left under a removed directory that is not yet reclaimed.
+// Glob patterns are answered from a trigram index over the names: the records holding the rarest
+// trigram of the pattern's literal parts are the only candidates, and fnmatch confirms them.
+class NameIndex
+{
+public:
+    NameIndex(DataBlockManager *dbManager, InodeManager *inodeManager);
+    bool enabled() const;
+    bool load(int indexInodeId);  // reads every slot of an existing index file
+    bool reset(int indexInodeId); // empties the index file before it is filled again with add()
+    void disable();
+    void add(int parentInodeId, const DirectoryEntry &entry);
+    void remove(int parentInodeId, const std::string &name);
+    void retarget(int parentInodeId, const std::string &name, int entryInodeId);
+    void lookup(const std::string &name, std::vector<NameIndexSlot> &matches) const;
+    void match(const std::string &pattern, std::vector<NameIndexSlot> &matches) const; // fnmatch-style glob
+    bool entryOf(int inodeId, int &parentInodeId, std::string &name) const; // the entry naming a directory
+    size_t size() const;
+
+private:
+    struct Record
+    {
+        int parent_inode_id; // INVALID_INODE_ID for a free slot
+        int inode_id;
+        std::string name;
+        size_t name_position; // position in by_name_[hash of name], for O(1) removal
+    };
+
+    DataBlockManager *db_manager_;
+    InodeManager *inode_manager_;
+    bool enabled_;
+    Inode index_inode_;
+    std::vector<Record> records_; // mirrors the slots of the index file
+    std::vector<size_t> free_records_;
+    std::unordered_map<size_t, std::vector<size_t>> by_name_; // name hash -> records
+    std::unordered_multimap<size_t, size_t> by_entry_;        // (directory, name) hash -> record
+    std::unordered_map<int, size_t> by_inode_;                // entry inode -> record
+    // Trigram postings are only appended to; records removed or renamed since stay behind as stale
+    // postings (filtered by the final fnmatch) until they outnumber the live ones and all lists are rebuilt.
+    std::unordered_map<uint32_t, std::vector<size_t>> trigrams_;
+    size_t live_postings_;
+    size_t stale_postings_;
+
+    static size_t entryHash(int parentInodeId, const std::string &name);
+    static void nameTrigrams(const std::string &name, std::vector<uint32_t> &trigrams);       // distinct trigrams of a name
+    static void patternTrigrams(const std::string &pattern, std::vector<uint32_t> &trigrams); // trigrams every match must contain
+    static size_t bracketEnd(const std::string &pattern, size_t open);                        // the ']' closing a bracket expression
+    NameIndexSlot toSlot(const Record &record) const;
+    void addPostings(size_t slot);
+    void rebuildPostings();
+    size_t findRecord(int parentInodeId, const std::string &name) const; // records_.size() if absent
+    void insertRecord(size_t slot, int parentInodeId, int inodeId, const std::string &name);
+    void eraseRecord(size_t slot);
+    bool writeSlot(size_t slot);
+};
+#endif // NAME_INDEX_H
@@ -7,14 +7,26 @@
 #include "fs_core/inode_manager.h"
 #include "file_operations/directory_manager.h"
 #include "file_operations/file_manager.h"
+#include "file_operations/name_index.h"
 #include "user_management/user_manager.h"
 #include <vector>
 #include <stack>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
 
 class FileSystem
 {
 public:
-    FileSystem(const std::string &diskFilePath, long long diskSize);
+    FileSystem(const std::string &diskFilePath, long long diskSize,
+               int maxSystemOpenFiles = DEFAULT_MAX_SYSTEM_OPEN_FILES, int maxOpenFilesPerProcess = DEFAULT_MAX_OPEN_FILES_PER_PROCESS,
+               bool directIo = false,           // directIo: bypass the host page cache (O_DIRECT)
+               int blockSize = DEFAULT_BLOCK_SIZE, // blockSize: used by format(); a mounted disk keeps its own
+               DiskLayout layout = DiskLayout::IN_PLACE); // layout: used by format(); detected from the image at mount
     ~FileSystem();
     bool mount();
     bool format();
@@ -23,18 +35,29 @@ public:
     bool mkdir(const std::string &path);
     bool chdir(const std::string &path);
     std::string dir(const std::string &path);
+    bool readdir(const std::string &path, long long &cookie, int maxEntries, std::vector<std::string> &names); // pages through a directory, cookie 0 = start
     bool create(const std::string &path);
     int open(const std::string &path, OpenMode mode); // OpenMode 在 common_defs.h
     bool close(int fd);
     int read(int fd, char *buffer, int length);
     int write(int fd, const char *buffer, int length);
+    int pread(int fd, char *buffer, int length, long long offset);        // does not move the fd offset
+    int pwrite(int fd, const char *buffer, int length, long long offset); // does not move the fd offset
+    long long lseek(int fd, long long offset, int whence);                // whence: SEEK_SET / SEEK_CUR / SEEK_END (<cstdio>)
+    int readv(int fd, const IoVec *iov, int iovcnt);                      // IoVec 在 data_structures.h
+    int writev(int fd, const IoVec *iov, int iovcnt);
+    bool fsync(int fd); // writes out the file's buffered writes and waits for the block cache write-back
+    bool sync();        // flushes every open file and writes back all dirty blocks
+    bool beginBatch();  // groups following operations into journal transactions (large batches commit between operations)
+    bool commitBatch(); // ends the batch and commits the rest; false if any part of it could not go through the journal
     bool rm(const std::string &path, bool recursive, bool force);
     bool cp(const std::string &sourcePath, const std::string &destPath, bool recursive);
     bool mv(const std::string &sourcePath, const std::string &destPath);
     bool ln(const std::string &targetPath, const std::string &linkPath);
     bool chmod(const std::string &path, short mode);
     bool chown(const std::string &path, const std::string &newOwnerUsername);
-    std::vector<std::string> find(const std::string &startPath, const std::string &filename);
+    std::vector<std::string> find(const std::string &startPath, const std::string &filename); // absolute paths, sorted
+    bool buildNameIndex(); // creates or rebuilds the filename index; afterwards find answers from it
     std::string getCurrentPathPrompt() const;
 
 private:
@@ -44,16 +67,45 @@ private:
     DataBlockManager db_manager_;
     DirectoryManager dir_manager_;
     FileManager file_manager_;
+    NameIndex name_index_;
     UserManager user_manager_;
     int current_dir_inode_id_;
     int root_dir_inode_id_;
+    int orphan_dir_inode_id_; // unlinked inodes waiting for the reclaimer
     std::vector<ProcessOpenFileEntry> process_open_file_table_; // ProcessOpenFileEntry 在 data_structures.h
-    std::vector<SystemOpenFileEntry> system_open_file_table_;   // SystemOpenFileEntry 在 data_structures.h
+    std::stack<int> free_fds_;                                  // 已关闭、可复用的 fd
+    int max_open_files_per_process_;
+    int format_block_size_;    // block size chosen for format()
+    DiskLayout format_layout_; // block layout chosen for format()
+    bool mounted_;             // set once mount() succeeds; the destructor then records a clean unmount
+    std::unique_ptr<JournalTransaction> batch_; // open between beginBatch() and commitBatch()
+    SystemOpenFileTable system_open_file_table_;                // SystemOpenFileTable 在 data_structures.h
+    // The managers do not lock, so every public method and each reclaimer step holds mutex_.
+    mutable std::recursive_mutex mutex_;
+    std::condition_variable_any reclaim_cv_;
+    bool stop_reclaimer_;
+    bool reclaim_pending_;       // the orphan directory may hold something the reclaimer can free
+    int reclaim_deferred_;       // open files put back by the last slice; taken again on top of the budget
+    bool write_buffer_started_;  // a write buffer went from empty to holding data since the reclaimer last looked
+    std::thread reclaimer_;      // started by mount(); also flushes write buffers that outlive WRITE_BUFFER_MAX_AGE_MS
     int getFreeFd();
     void releaseFd(int fd);
-    // bool recursiveDelete(int dirInodeId); // This logic will be part of rm or a helper called by rm
     // bool recursiveCopy(int sourceDirInodeId, int destParentDirInodeId, const std::string& newName); // This logic will be part of cp or a helper called by cp
     std::string getPathFromInodeId(int targetInodeId) const;
+    int cloneFileInode(int sourceInodeId);                        // reflink copy of a file, not yet linked into a directory
+    int makeEmptyDirectory(int parentInodeId, short permissions); // directory holding only "." and "..", not yet linked
+    bool isInTree(int rootInodeId, int inodeId);
+    bool copyTree(int sourceDirInodeId, int destDirInodeId); // fills an empty destination directory, level by level
+    bool dropLink(Inode &inode);                                   // true when the last link is gone
+    bool queueOrphans(const std::vector<DirectoryEntry> &entries); // hands unlinked inodes to the reclaimer
+    void reclaimerLoop();
+    std::chrono::steady_clock::time_point flushAgedWriteBuffers(); // returns when the next buffer is due
+    bool reclaimSlice(); // frees up to RECLAIM_SLICE_INODES orphaned inodes, false when nothing could be freed
+    // Called for every entry below the start directory with the path of the directory holding it
+    using TreeVisitor = std::function<void(const std::string &dirPath, int dirInodeId, const DirectoryEntry &entry, const Inode &inode)>;
+    void walkTree(int startDirInodeId, bool checkPermissions, const TreeVisitor &visit);
+    bool fillNameIndex(int indexInodeId);
+    std::vector<std::string> findIndexed(int startDirInodeId, const std::string &filename);
 };
 
 #endif // FILESYSTEM_H
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef ALIGNED_BUFFER_POOL_H
+#define ALIGNED_BUFFER_POOL_H
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+class AlignedBufferPool;
+
+// 从 AlignedBufferPool 取得的对齐缓冲区，析构时自动归还 (只能移动，不能复制)
+class AlignedBuffer
+{
+public:
+    AlignedBuffer() = default;
+    AlignedBuffer(AlignedBuffer &&other) noexcept;
+    AlignedBuffer &operator=(AlignedBuffer &&other) noexcept;
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+    ~AlignedBuffer();
+
+    char *data() const { return data_; }
+    size_t size() const { return size_; }
+    char &operator[](size_t index) const { return data_[index]; }
+
+private:
+    friend class AlignedBufferPool;
+    AlignedBuffer(AlignedBufferPool *pool, char *data, size_t size, size_t capacity);
+    void reset();
+
+    AlignedBufferPool *pool_ = nullptr;
+    char *data_ = nullptr;
+    size_t size_ = 0;     // 请求的大小
+    size_t capacity_ = 0; // 实际分配的大小 (按对齐粒度向上取整)
+};
+
+// 对齐缓冲区池: 提供按 alignment 对齐、清零的缓冲区，满足 O_DIRECT 对内存地址和长度的要求。
+// 与 bufferSize 相同大小的缓冲区在归还后留在空闲表中复用 (最多 maxFree 个)，
+// 其他大小按需分配、归还时释放。线程安全。
+class AlignedBufferPool
+{
+public:
+    AlignedBufferPool(size_t bufferSize, size_t alignment, size_t maxFree);
+    ~AlignedBufferPool();
+    AlignedBufferPool(const AlignedBufferPool &) = delete;
+    AlignedBufferPool &operator=(const AlignedBufferPool &) = delete;
+
+    AlignedBuffer acquire();                                   // bufferSize 字节，已清零
+    AlignedBuffer acquire(size_t size, bool zeroFill = true); // 任意大小；直接用于读盘的缓冲区可不清零
+    void setBufferSize(size_t bufferSize);                     // 改变池中缓冲区的大小，释放旧的空闲缓冲区
+    size_t bufferSize() const { return buffer_size_; }
+    size_t alignment() const { return alignment_; }
+
+private:
+    friend class AlignedBuffer;
+    void release(char *data, size_t capacity);
+    size_t roundUp(size_t size) const;
+
+    size_t buffer_size_;
+    size_t alignment_;
+    size_t max_free_;
+    std::mutex mutex_;
+    std::vector<char *> free_; // 空闲的 bufferSize 缓冲区
+};
+#endif // ALIGNED_BUFFER_POOL_H
@@ -0,0 +1,59 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <chrono>
+#include <functional>
+#include "common_defs.h"
+
+// 块缓存: 以块号为键的 LRU 写回 (write-back) 缓存，由 VirtualDisk 持有，所有块读写都经过它。
+// 写入只把块标记为脏，由 VirtualDisk 的后台刷写线程或 sync 写回磁盘；淘汰脏块前先经回调写回。
+// 被钉住 (pinned) 的块属于尚未提交到日志的事务: 不会被淘汰，也不会被收集写回，直到解除钉住。
+// 它们放在单独的链表中，淘汰和收集脏块只遍历未钉住的块。
+// 本类自身不加锁，由 VirtualDisk 负责互斥。
+class BlockCache
+{
+public:
+    using WritebackHandler = std::function<void(BlockId blockId, const char *data)>;
+
+    BlockCache(int blockSize, size_t capacityBlocks);
+    void setWritebackHandler(WritebackHandler handler);        // 淘汰脏块时调用
+    bool lookup(BlockId blockId, char *buffer);                    // 命中时复制到 buffer 并刷新 LRU 位置
+    void insert(BlockId blockId, const char *data, bool dirty);    // 插入或覆盖，超出容量时淘汰最久未用的块
+    bool contains(BlockId blockId) const;
+    void invalidate(BlockId blockId);                              // 直接丢弃 (包括脏数据)
+    void clear();
+    void reset(int blockSize, size_t capacityBlocks);          // 清空并改用新的块大小和容量
+    size_t size() const;
+    size_t capacity() const;
+    size_t dirtyCount() const;
+    size_t unpinnedDirtyCount() const; // 可以写回的脏块数: 钉住的块在事务提交前写不出去
+    std::vector<BlockId> collectDirty(std::chrono::steady_clock::time_point dirtiedBefore) const; // 按块号升序
+    bool takeDirty(BlockId blockId, char *buffer);                 // 若为未钉住的脏块则复制到 buffer 并标记为干净
+    bool pin(BlockId blockId);                                     // 块须已在缓存中；钉住期间可能超出容量
+    void unpin(BlockId blockId);
+
+private:
+    struct CachedBlock
+    {
+        BlockId block_id;
+        bool dirty;
+        bool pinned; // 在日志提交前不得写回原位置
+        std::chrono::steady_clock::time_point dirtied_at; // 由干净变脏的时间
+        std::vector<char> data;
+    };
+
+    int block_size_;
+    size_t capacity_blocks_;
+    size_t dirty_count_;
+    size_t pinned_dirty_count_; // dirty_count_ 中被钉住的块
+    WritebackHandler writeback_;
+    std::list<CachedBlock> lru_;    // 未钉住的块，表头为最近使用
+    std::list<CachedBlock> pinned_; // 钉住的块，解除钉住时回到 lru_ 表头
+    std::unordered_map<BlockId, std::list<CachedBlock>::iterator> index_;
+
+    bool evictUnpinned();
+};
+#endif // BLOCK_CACHE_H
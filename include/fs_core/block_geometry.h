@@ -0,0 +1,61 @@
+#ifndef BLOCK_GEOMETRY_H
+#define BLOCK_GEOMETRY_H
+#include "common_defs.h"
+
+constexpr int constexprLog2(int value)
+{
+    return value <= 1 ? 0 : 1 + constexprLog2(value / 2);
+}
+
+// 编译期块几何: 块大小为模板参数，偏移到块号、块内偏移、每块指针数/i-node 数/位数都是常量，
+// 除法和取模由编译器化为移位和掩码。管理器的热点路径按块大小实例化，挂载时按超级块选择实例。
+template <int BlockSize>
+struct BlockGeometry
+{
+    static_assert(BlockSize >= MIN_BLOCK_SIZE && BlockSize <= MAX_BLOCK_SIZE && (BlockSize & (BlockSize - 1)) == 0,
+                  "块大小必须是受支持范围内的 2 的幂");
+    static_assert(BlockSize % INODE_SIZE_BYTES == 0, "块大小必须是 i-node 大小的整数倍");
+
+    static constexpr int kBlockSize = BlockSize;
+    static constexpr int kPointersPerBlock = BlockSize / BLOCK_ID_TYPE_SIZE; // 间接块中的块号数
+    static constexpr int kPointerShift = constexprLog2(kPointersPerBlock);      // 间接块下标的位数
+    static constexpr int kInodesPerBlock = BlockSize / INODE_SIZE_BYTES;     // i-node 表每块的 i-node 数
+    static constexpr int kBitsPerBlock = BlockSize * 8;                      // 位图每块的位数
+
+    static constexpr long long blockIndex(long long offset) { return offset / BlockSize; }
+    static constexpr int offsetInBlock(long long offset) { return static_cast<int>(offset % BlockSize); }
+};
+
+// 按运行时块大小调用 select(BlockGeometry<N>())，为每个受支持的块大小各生成一个实例。
+// 返回值: blockSize 不受支持时为 false (不调用 select)。
+template <typename Selector>
+bool selectBlockGeometry(int blockSize, Selector &&select)
+{
+    switch (blockSize)
+    {
+    case 1024:
+        select(BlockGeometry<1024>());
+        return true;
+    case 2048:
+        select(BlockGeometry<2048>());
+        return true;
+    case 4096:
+        select(BlockGeometry<4096>());
+        return true;
+    case 8192:
+        select(BlockGeometry<8192>());
+        return true;
+    case 16384:
+        select(BlockGeometry<16384>());
+        return true;
+    case 32768:
+        select(BlockGeometry<32768>());
+        return true;
+    case 65536:
+        select(BlockGeometry<65536>());
+        return true;
+    default:
+        return false;
+    }
+}
+#endif // BLOCK_GEOMETRY_H
@@ -0,0 +1,37 @@
+#ifndef BLOCK_IO_BACKEND_H
+#define BLOCK_IO_BACKEND_H
+#include <memory>
+#include "common_defs.h"
+
+// 一次块 I/O 请求: 从 start_block_id 起的 block_count 个连续块
+struct BlockIoRequest
+{
+    bool is_write;       // true 为写，false 为读
+    BlockId start_block_id; // 起始块号
+    int block_count;     // 连续块数
+    char *buffer;        // 数据缓冲区，至少 block_count * 块大小 字节 (写请求只读取)
+    bool completed;      // 由后端在请求完成时置为 true
+    bool ok;             // 请求是否成功 (completed 后有效)
+};
+
+// 块 I/O 后端: 批量提交请求、异步回收完成事件。
+// 优先使用 io_uring (直接系统调用，无外部依赖)，内核不支持时退化为同步 pread/pwrite。
+// 本类不加锁，由 VirtualDisk 在持有 io 锁时使用。
+class BlockIoBackend
+{
+public:
+    virtual ~BlockIoBackend() = default;
+    virtual const char *name() const = 0;
+    // 提交一批请求，不等待完成；在途请求达到队列深度时会先回收一部分完成事件。
+    // 请求对象在完成前必须保持有效。返回值: 是否全部提交成功
+    virtual bool submit(BlockIoRequest *requests, int count) = 0;
+    // 等待至少 minCompletions 个在途请求完成，返回本次回收的完成数
+    virtual int reap(int minCompletions) = 0;
+    virtual int inFlight() const = 0;
+
+    bool submitAndWait(BlockIoRequest *requests, int count); // 提交并等待全部完成，返回是否全部成功
+
+    // fd: 已打开的磁盘映像文件描述符 (由调用者关闭)
+    static std::unique_ptr<BlockIoBackend> create(int fd, int blockSize, int queueDepth);
+};
+#endif // BLOCK_IO_BACKEND_H
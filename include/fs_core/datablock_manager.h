@@ -9,12 +9,19 @@ class DataBlockManager
 {
 public:
     DataBlockManager(VirtualDisk *vdisk, InodeManager *inodeManager, SuperBlockManager *sbManager);
-    int readFileData(Inode &inode, long long offset, char *buffer, int length);
+    int readFileData(Inode &inode, long long offset, char *buffer, int length, ReadaheadState *readahead = nullptr);
     int writeFileData(Inode &inode, long long offset, const char *buffer, int length, bool &sizeChanged);
+    int readFileDataV(Inode &inode, long long offset, const IoVec *iov, int iovcnt, ReadaheadState *readahead = nullptr); // 分散读
+    int writeFileDataV(Inode &inode, long long offset, const IoVec *iov, int iovcnt, bool &sizeChanged); // 聚集写
     void clearInodeDataBlocks(Inode &inode);
+    void releaseInodeDataBlocks(Inode &inode, std::vector<BlockId> &blockIds); // 收集要释放的块，交给 freeBlocks 批量释放
+    bool shareInodeDataBlocks(const Inode &source, Inode &destination); // reflink: destination 与 source 共享全部数据块
     VirtualDisk *vdisk_;
 
 private: // 添加私有成员变量
+    void readahead(Inode &inode, long long offset, int length, ReadaheadState &state);
+    void collectIndirectTree(BlockId blockId, int depth, std::vector<BlockId> &blockIds); // depth: 1 = 一级间接块
+
     InodeManager *inode_manager_;
     SuperBlockManager *sb_manager_;
 };
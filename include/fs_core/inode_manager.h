@@ -10,10 +10,32 @@ public:
     InodeManager(VirtualDisk *vdisk, SuperBlockManager *sbManager);
     bool readInode(int inodeId, Inode &inode) const; // Inode 结构体在 data_structures.h
     bool writeInode(int inodeId, const Inode &inode);
-    int getBlockIdForFileOffset(Inode &inode, long long offset, bool allocateIfMissing);
+    // allocateIfMissing 为 true 表示为写入取块: 缺失的块被分配，路径上被共享的块先复制 (copy-on-write)；
+    // overwriteWholeBlock 表示调用者会写满整个数据块，复制共享数据块时不必拷贝旧内容；
+    // newlyAllocated 非空时告知返回的数据块是否刚分配 (内容是之前释放者留下的旧数据，调用者须清零)
+    BlockId getBlockIdForFileOffset(Inode &inode, long long offset, bool allocateIfMissing, bool overwriteWholeBlock = false,
+                                    bool *newlyAllocated = nullptr);
+    void prefetchInodes(const std::vector<int> &inodeIds); // 把这些 i-node 所在的块一次批量读入块缓存
+    bool selectGeometry(int blockSize); // 挂载时按超级块的块大小选择模板实例
 
 private:                            // 添加私有成员变量
     VirtualDisk *vdisk_;            // 指向虚拟磁盘对象的指针
     SuperBlockManager *sb_manager_; // 指向超级块管理器对象的指针
+
+    // 按块大小实例化的实现，公有接口经下面的成员函数指针转发
+    template <int BlockSize>
+    bool readInodeFor(int inodeId, Inode &inode) const;
+    template <int BlockSize>
+    bool writeInodeFor(int inodeId, const Inode &inode);
+    template <int BlockSize>
+    BlockId getBlockIdForFileOffsetFor(Inode &inode, long long offset, bool allocateIfMissing, bool overwriteWholeBlock, bool *newlyAllocated);
+    template <int BlockSize>
+    BlockId allocateIndirectBlock();
+    template <int BlockSize>
+    BlockId unshareBlock(BlockId blockId, bool isIndirect, bool copyContents); // 为本文件复制一个共享块
+
+    bool (InodeManager::*read_inode_)(int, Inode &) const;
+    bool (InodeManager::*write_inode_)(int, const Inode &);
+    BlockId (InodeManager::*block_id_for_offset_)(Inode &, long long, bool, bool, bool *);
 };
 #endif // INODE_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <set>
+#include <chrono>
+#include "common_defs.h"
+
+class VirtualDisk;
+
+// 元数据预写日志 (write-ahead journal)，由 VirtualDisk 持有。
+// 事务打开期间经 writeBlock 写入的块被钉在块缓存中并登记到当前运行的事务；事务关闭后不立即提交，
+// 多个已关闭的事务合并 (group commit)，运行时间超过 JOURNAL_COMMIT_INTERVAL_MS 或块数较多时
+// 一次性顺序写入日志区并只做一次 fdatasync。提交后这些块才解除钉住，由后台刷写线程延迟、合并地写回原位置。
+// 日志空间不足或卸载时做检查点: 写回全部脏块、fdatasync，然后从日志区开头重新记录。
+// 文件数据块不进日志 (ordered 模式): 事务写入的数据块在提交块之前先写回原位置并落盘，
+// 重放后的 i-node 大小和块指针不会指向尚未写入的块。
+// 挂载时按序号重放日志中完整 (提交块校验和正确) 的事务。
+// 本类不加锁: 除 enabled() 外的方法都由 VirtualDisk 在持有 cache_mutex_ (注明时还需 io_mutex_) 时调用。
+class Journal
+{
+public:
+    explicit Journal(VirtualDisk *vdisk);
+    bool enabled() const;
+    bool format(BlockId startBlockId, int blockCount);  // 需持有 io_mutex_: 初始化空日志并启用
+    bool recover(BlockId startBlockId, int blockCount); // 需持有 io_mutex_: 重放已提交的事务并启用
+    void disable();                                     // 调用者应先提交并做检查点
+    bool commit();                                      // 需持有 io_mutex_: 把运行中的事务写入日志；日志装不下时写回原位置并返回 false
+    bool checkpoint();                                  // 需持有 io_mutex_: 写回全部脏块后清空日志
+    void recordWrite(BlockId blockId, bool isData);     // 块已写入缓存: 事务打开时登记并钉住
+    bool commitDue(std::chrono::steady_clock::time_point now) const; // 没有打开的事务且运行中的事务该提交了
+    bool runningFull() const;                                        // 运行中的事务达到提交阈值
+    bool hasRunning() const;
+    int openHandles() const;
+    void addHandle();
+    void dropHandle();
+
+private:
+    VirtualDisk *vdisk_;
+    bool enabled_;
+    BlockId start_block_;      // 日志超级块
+    int blocks_count_;         // 日志区块数 (含日志超级块)
+    long long first_sequence_; // 日志中第一个事务的序号 (记录在日志超级块中)
+    long long next_sequence_;  // 下一个提交的事务序号
+    BlockId head_;             // 下一个事务写入的位置
+    std::set<BlockId> running_; // 运行中的事务 (尚未提交) 包含的块，按块号排序
+    std::set<BlockId> logged_;  // 自上次检查点以来写入日志的块
+    std::set<BlockId> ordered_; // 运行中的事务写入的文件数据块: 提交前写回原位置
+    std::chrono::steady_clock::time_point running_since_;
+    int open_handles_; // 打开的事务数 (beginTransaction 未配对 endTransaction)
+
+    int descriptorCapacity() const; // 每个描述块能登记的块数
+    size_t commitThreshold() const; // 运行中的事务达到这么多块时提前提交
+    bool writeSuperBlock();          // 需持有 io_mutex_
+    void releaseRunning();           // 解除钉住并清空运行中的事务
+    bool writeOrderedData();         // 需持有 io_mutex_: 写回运行中的事务的数据块并落盘
+};
+
+// 把一个文件系统操作产生的全部元数据写入放进同一个日志事务 (RAII)。
+// 事务打开期间本线程调用 VirtualDisk::sync 不会提交这个事务。
+class JournalTransaction
+{
+public:
+    explicit JournalTransaction(VirtualDisk &vdisk);
+    ~JournalTransaction();
+    JournalTransaction(const JournalTransaction &) = delete;
+    JournalTransaction &operator=(const JournalTransaction &) = delete;
+
+private:
+    VirtualDisk &vdisk_;
+};
+#endif // JOURNAL_H
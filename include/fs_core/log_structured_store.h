@@ -0,0 +1,76 @@
+#ifndef LOG_STRUCTURED_STORE_H
+#define LOG_STRUCTURED_STORE_H
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <functional>
+#include "common_defs.h"
+#include "data_structures.h"
+#include "fs_core/block_io_backend.h"
+#include "fs_core/aligned_buffer_pool.h"
+
+class VirtualDisk;
+
+// 日志结构布局 (格式化时选择)，由 VirtualDisk 持有。
+// 文件系统看到的逻辑块经块映射落到物理块上: 写回的块 (数据和元数据一样) 先攒进待写部分段，
+// 攒满或需要落盘时连同一个摘要块顺序追加到当前段，旧位置随之作废；因此映像上只有大块的顺序写。
+// 块映射常驻内存，变化的映射块在检查点时写回映射区；挂载时读入检查点映射，再按序号前滚检查点之后的部分段。
+// 空闲段不足时清理存活块最少的段: 依摘要找出仍被映射的块，追加到日志末尾后整段回收。
+// 本类不加锁: 所有方法都由 VirtualDisk 在持有 io_mutex_ 时调用。
+class LogStructuredStore
+{
+public:
+    explicit LogStructuredStore(VirtualDisk *vdisk);
+    bool format(long long physicalBlocks); // 在整个映像上建立空日志
+    bool load(const LogHeader &header);    // 读入检查点映射并前滚之后写入的部分段
+    long long logicalBlocks() const;
+    bool submit(std::vector<BlockIoRequest> &requests); // 按逻辑块号读写: 写请求进入待写部分段
+    bool flush();                                       // 把待写部分段追加到日志 (不等待落盘)
+    bool sync();                                        // flush 并 fdatasync 映像
+    bool checkpoint();                                  // 写出变化的映射块和日志头，之后挂载无需前滚
+    bool backgroundWork();                              // 刷写线程调用: 空闲段偏少时清理一个段，到期时做检查点
+
+private:
+    // 段中的一个部分段: 摘要和它登记的第一个块的物理块号
+    using PartialVisitor = std::function<void(const LogSummary &summary, BlockId firstBlock)>;
+
+    VirtualDisk *vdisk_;
+    LogHeader header_;
+    std::vector<BlockId> map_;       // 逻辑块号 -> 物理块号，INVALID_BLOCK_ID 表示从未写过 (读出为 0)
+    std::vector<int> live_;          // 每段仍被映射的块数
+    std::vector<char> free_;         // 段是否空闲
+    std::vector<long long> free_segments_;  // 可以直接覆盖的空闲段
+    std::vector<long long> recently_freed_; // 上次 fdatasync 之后才作废的段: 新位置落盘前不覆盖旧内容
+    std::set<long long> dirty_map_blocks_; // 自上次检查点以来变化的映射块
+    long long current_segment_;            // 正在追加的段，-1 表示还没有
+    long long current_offset_;             // 当前段中下一个空位
+    long long next_sequence_;
+    long long segments_since_checkpoint_;
+    bool cleaning_;                        // 清理中: 可以使用保留段，不再嵌套清理
+
+    std::vector<BlockId> pending_ids_;                 // 待写部分段中各块的逻辑块号
+    std::unordered_map<BlockId, size_t> pending_slots_; // 逻辑块号 -> 待写部分段中的位置
+    AlignedBuffer pending_data_;
+
+    int summaryCapacity() const;  // 每个摘要块能登记的块数
+    size_t pendingCapacity() const;
+    int mapEntriesPerBlock() const;
+    BlockId segmentStart(long long segment) const;
+    long long segmentOf(BlockId physicalBlock) const;
+    unsigned long long summaryChecksum(const LogSummary &summary) const;
+    size_t freeSegmentCount() const;
+    void reset();
+    bool syncImage(); // fdatasync 映像，之后 recently_freed_ 中的段可以覆盖
+    bool writeHeader(); // 写日志头并等待落盘
+    bool writeMapBlocks();
+    bool readMap();
+    bool bufferWrite(BlockId blockId, const char *data);
+    bool appendBlocks(const BlockId *blockIds, const char *data, size_t count);
+    bool openSegment(); // 当前段写满时换一个空闲段，空闲段不足时先清理
+    void retireSegment(long long segment); // 离开当前段时: 没有存活块就回收
+    void releaseSegment(long long segment);
+    void remap(BlockId blockId, BlockId physicalBlock);
+    bool cleanSegment(long long maxLive); // 清理存活块最少且不超过 maxLive 的段，返回是否腾出了一个段
+    bool walkSegment(long long segment, const char *image, const PartialVisitor &visit); // image 为空时逐个读取摘要块
+};
+#endif // LOG_STRUCTURED_STORE_H
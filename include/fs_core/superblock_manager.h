@@ -10,12 +10,19 @@ public:
     SuperBlockManager(VirtualDisk *vdisk);
     bool loadSuperBlock();
     bool saveSuperBlock();
-    bool formatFileSystem(int totalInodes, int blockSize);
-    int allocateBlock();
-    void freeBlock(int blockId);
-    int allocateInode();
+    bool formatFileSystem(int initialInodes, int blockSize, DiskLayout layout = DiskLayout::IN_PLACE); // initialInodes: 格式化时预先分配的 i-node 数
+    BlockId allocateBlock();
+    void freeBlock(BlockId blockId);           // 共享块只减少一个引用，最后一个引用释放时才归还空闲块
+    void freeBlocks(std::vector<BlockId> blockIds); // 批量释放: 每个空闲块组只读写一次，超级块只保存一次
+    bool addBlockReference(BlockId blockId);   // 块多了一处引用 (reflink 克隆)
+    long long blockReferences(BlockId blockId) const; // 未登记在引用计数表中的块为 1
+    int allocateInode(); // 没有空闲 i-node 时自动分配新的 i-node 块
     void freeInode(int inodeId);
+    BlockId inodeChunkBlock(int chunk) const; // i-node 块 (chunk) 所在的磁盘块，不存在时为 INVALID_BLOCK_ID
     const SuperBlock &getSuperBlockInfo() const;
+    bool setVolumeState(VolumeState state); // 修改卸载状态并立即写回磁盘
+    bool setNameIndexInode(int inodeId);    // 记录文件名索引文件的inode号
+    bool recoverFreeCounts();               // 非正常卸载后按位图和空闲块堆栈重新统计空闲计数
 
 private:
     VirtualDisk *vdisk_;    // 指向虚拟磁盘的指针
@@ -24,10 +31,43 @@ private:
     // 用于i-node位图操作的私有辅助方法声明
     bool readInodeBitmapBlock(int bitmap_block_offset, char *buffer) const;
     bool writeInodeBitmapBlock(int bitmap_block_offset, const char *buffer);
-    bool getInodeBit(int inodeId, bool &isSet) const;
+    bool getInodeBit(int inodeId, bool &isSet) const; // 经 get_inode_bit_ 调用当前块大小的实例
     bool setInodeBit(int inodeId, bool setToUsed);
+    template <int BlockSize>
+    bool getInodeBitFor(int inodeId, bool &isSet) const;
+    template <int BlockSize>
+    bool setInodeBitFor(int inodeId, bool setToUsed);
+    bool selectGeometry(int blockSize, int inodeSize); // 按超级块选择位图操作的模板实例
+
+    bool (SuperBlockManager::*get_inode_bit_)(int, bool &) const;
+    bool (SuperBlockManager::*set_inode_bit_)(int, bool);
 
     void initializeFreeBlockGroups(); // 这个方法已在您的片段中
+    int freeBlocksPerGroup() const;   // 每个空闲块组块中的块号数
+
+    // 按需分配的 i-node 表
+    std::vector<BlockId> inode_chunk_blocks_;     // 内存索引: chunk 号 -> 块号
+    std::vector<BlockId> inode_chunk_map_blocks_; // chunk 映射块链
+    int inode_alloc_hint_;                        // 编号更小的 i-node 都已被使用
+    bool loadInodeChunkMap();
+    bool growInodeTable(); // 分配一个新的 i-node 块并登记到映射块链
+    int findFreeInode();   // 从 inode_alloc_hint_ 起在位图中查找空闲 i-node
+    int inodesPerChunk() const;
+    long long countFreeBlocks(); // 空闲块堆栈中的块数加上未分配区间的长度，链损坏时为 -1
+
+    // 共享块引用计数表: 内存中按块号索引，每项记下引用数和它在表中的位置
+    struct SharedBlock
+    {
+        long long references;
+        size_t slot;
+    };
+    std::unordered_map<BlockId, SharedBlock> shared_blocks_;
+    std::vector<BlockId> refcount_slots_;        // 表中各项的块号 (表项紧凑排列)
+    std::vector<BlockId> refcount_table_blocks_; // 引用计数表块链
+    int refCountsPerTableBlock() const;
+    bool loadBlockRefCounts();
+    bool writeRefCountSlot(size_t slot); // 把内存中的一项写回它所在的表块 (表块已存在)
+    bool dropRefCountSlot(BlockId blockId); // 引用数回到 1: 用表尾一项填补空位，表尾的表块空出时释放
 };
 
 #endif // SUPERBLOCK_MANAGER_H
\ No newline at end of file
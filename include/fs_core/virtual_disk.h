@@ -1,22 +1,88 @@
 #ifndef VIRTUAL_DISK_H
 #define VIRTUAL_DISK_H
 #include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include "fs_core/block_cache.h"
+#include "fs_core/block_io_backend.h"
+#include "fs_core/aligned_buffer_pool.h"
+#include "fs_core/journal.h"
+#include "fs_core/log_structured_store.h"
 class VirtualDisk
 {
 public:
-    VirtualDisk(const std::string &diskFilePath, long long diskSize);
+    VirtualDisk(const std::string &diskFilePath, long long diskSize, bool directIo = false); // directIo: 以 O_DIRECT 打开映像
     ~VirtualDisk();
-    bool readBlock(int blockId, char *buffer, int bufferSize);
-    bool writeBlock(int blockId, const char *buffer, int bufferSize);
+    bool readBlock(BlockId blockId, char *buffer, int bufferSize);
+    bool writeBlock(BlockId blockId, const char *buffer, int bufferSize); // 写入块缓存，由后台线程写回；事务中的元数据写入经日志
+    bool writeDataBlock(BlockId blockId, const char *buffer, int bufferSize); // 写入文件内容: 不经日志
+    bool readBlocks(BlockId startBlockId, int count, char *buffer); // 一次读取连续的 count 个块
+    void prefetchBlocks(const std::vector<BlockId> &blockIds);       // 把尚未缓存的块按连续段批量读入块缓存
+    bool sync();                                                 // 写回全部脏块并等待完成
+    bool setBlockSize(int blockSize);                            // 按新块大小划分磁盘 (格式化或挂载时调用)
+    bool readHeader(char *buffer, int length);                   // 读取块 0 开头的字节，不依赖当前块大小
+    bool formatLayout(DiskLayout layout);                        // 格式化时选择块的布局 (总块数随之改变)
+    bool formatJournal(BlockId startBlockId, int blockCount); // 在日志区建立空日志并启用
+    bool openJournal(BlockId startBlockId, int blockCount);   // 挂载时重放日志并启用
+    bool closeJournal();                                      // 提交、做检查点并停用日志
+    void beginTransaction(); // 通常经 JournalTransaction 使用；可嵌套
+    void endTransaction();
+    bool commitJournal(); // 立即提交已结束的事务 (包括批处理中途提交的失败)
     long long getTotalBlocks() const;
     int getBlockSize() const;
+    AlignedBufferPool &bufferPool(); // 各管理器的块大小临时缓冲区
     bool exists() const;
     bool createDiskFile();
 
 private:
-    std::string diskFilePath_; // ✅ 添加此行：磁盘文件路径
+    friend class Journal;
+    friend class LogStructuredStore;
+    std::string diskFilePath_;
     long long diskSize_;
     long long totalBlocks_;
     long long blockSize_;
+    BlockCache cache_;
+    int disk_fd_;                                // 磁盘映像的文件描述符，首次 I/O 时打开
+    std::unique_ptr<BlockIoBackend> io_backend_; // io_uring，不可用时为 pread/pwrite
+    bool direct_io_;                             // 是否绕过主机页缓存 (O_DIRECT)
+    AlignedBufferPool buffer_pool_;
+
+    // 锁顺序: cache_mutex_ 先于 io_mutex_；持有 io_mutex_ 时不得再获取 cache_mutex_
+    std::mutex cache_mutex_;                // 保护 cache_ 和刷写线程状态
+    std::mutex io_mutex_;                   // 串行化对磁盘文件的读写
+    std::condition_variable flusher_cv_;
+    bool stop_flusher_;
+    std::thread flusher_;
+
+    Journal journal_;                       // 由 cache_mutex_ 保护
+    std::unique_ptr<LogStructuredStore> log_; // 日志结构布局时非空；同时持有两把锁才能替换，使用时需持有 io_mutex_
+    std::condition_variable journal_cv_;    // 等待打开的事务结束或提交完成
+    bool commit_waiting_;                   // 有提交在等待打开的事务结束，新事务暂缓开始
+    bool batch_commit_failed_;              // 批处理中途的提交失败，由下一次 commitJournal 报告
+
+    bool openDiskFd();                                                   // 需持有 io_mutex_
+    bool submitIo(std::vector<BlockIoRequest> &requests);                // 需持有 io_mutex_: 按逻辑块号
+    bool submitPhysical(std::vector<BlockIoRequest> &requests);          // 需持有 io_mutex_: 按映像中的物理块号
+    bool isDirectIoAligned(const BlockIoRequest &request) const;
+    bool bounceIo(const BlockIoRequest &request);                        // 需持有 io_mutex_
+    bool readFromDisk(BlockId startBlockId, int count, char *buffer);        // 需持有 io_mutex_
+    bool writeToDisk(BlockId startBlockId, int count, const char *buffer);   // 需持有 io_mutex_
+    bool readBlockLocked(BlockId blockId, char *buffer);                     // 需持有 cache_mutex_
+    bool readBlocksLocked(BlockId startBlockId, int count, char *buffer);    // 需持有 cache_mutex_
+    bool writeBlockImpl(BlockId blockId, const char *buffer, int bufferSize, bool isData);
+    bool writeBackDirty(std::chrono::steady_clock::time_point dirtiedBefore);
+    bool writeBackAllLocked();                                  // 需持有 cache_mutex_ 和 io_mutex_
+    bool writeBackLocked(const std::vector<BlockId> &blockIds); // 需持有 cache_mutex_ 和 io_mutex_: 块号须升序
+    bool flushDeviceLocked();                                   // 需持有 io_mutex_: 写入全部已提交的块并 fdatasync
+    bool fdatasyncLocked();                                     // 需持有 io_mutex_
+    bool readImageStart(char *buffer, int length);              // 需持有 io_mutex_: 读取映像开头的原始字节
+    bool loadLogLayout();                                       // 映像是日志结构布局时切换块大小并加载块映射
+    bool commitJournalLocked(std::unique_lock<std::mutex> &lock); // lock 须锁住 cache_mutex_
+    bool overDirtyRatio() const;
+    void flusherLoop();
 };
-#endif // !VIRTUAL_DISK_H
\ No newline at end of file
+#endif // !VIRTUAL_DISK_H
@@ -29,10 +29,17 @@ private:
     void handleClose(const std::vector<std::string> &args);
     void handleWrite(const std::vector<std::string> &args);
     void handleRead(const std::vector<std::string> &args);
+    void handleSeek(const std::vector<std::string> &args);
+    void handleFsync(const std::vector<std::string> &args);
+    void handleSync(const std::vector<std::string> &args);
     void handleCd(const std::vector<std::string> &args);
     void handleLs(const std::vector<std::string> &args);
     void handleCreate(const std::vector<std::string> &args);
     void handleRm(const std::vector<std::string> &args);
+    void handleCp(const std::vector<std::string> &args);
+    void handleMv(const std::vector<std::string> &args);
+    void handleFind(const std::vector<std::string> &args);
+    void handleIndex(const std::vector<std::string> &args);
 };
 
 #endif // SHELL_H
\ No newline at end of file
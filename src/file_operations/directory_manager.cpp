@@ -1,10 +1,11 @@
 #include "file_operations/directory_manager.h"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <sstream>
 
 DirectoryManager::DirectoryManager(DataBlockManager *dbManager, InodeManager *inodeManager, SuperBlockManager *sbManager)
-    : db_manager_(dbManager), inode_manager_(inodeManager), sb_manager_(sbManager) {}
+    : db_manager_(dbManager), inode_manager_(inodeManager), sb_manager_(sbManager), name_index_(nullptr) {}
 
 // 简化版的路径解析，实际需要更完善的错误处理和细节
 // parentInodeId 和 lastName 是输出参数
@@ -198,117 +199,73 @@ bool DirectoryManager::addEntry(Inode &parentDirInode, const std::string &name,
     // Directory entries are stored one after another in data blocks.
     // Each data block can hold block_size / sizeof(DirectoryEntry) entries.
 
-    char blockBuffer[DEFAULT_BLOCK_SIZE]; //
+    // Entry k lives in logical block k / entriesPerBlock at slot k % entriesPerBlock, and
+    // file_size is always (number of slots) * sizeof(DirectoryEntry).
+    int blockSize = sb_manager_->getSuperBlockInfo().block_size;
+    AlignedBuffer blockBuffer = db_manager_->vdisk_->bufferPool().acquire(blockSize);
+    DirectoryEntry *entries = reinterpret_cast<DirectoryEntry *>(blockBuffer.data());
     bool entryWritten = false;
-    long long dirSize = parentDirInode.file_size;                      //
-    int entriesPerBlock = DEFAULT_BLOCK_SIZE / sizeof(DirectoryEntry); //
+    int entriesPerBlock = blockSize / sizeof(DirectoryEntry);
+    long long dirEntriesCount = parentDirInode.file_size / sizeof(DirectoryEntry);
 
     // 检查现有块是否有空位 (inode_id == INVALID_INODE_ID)
-    for (int i = 0; i < NUM_DIRECT_BLOCKS; ++i)
-    { //
-        if (parentDirInode.direct_blocks[i] == INVALID_BLOCK_ID)
-            continue; //
-        if (!db_manager_->vdisk_->readBlock(parentDirInode.direct_blocks[i], blockBuffer, DEFAULT_BLOCK_SIZE))
-        { //
-            std::cerr << "Error reading directory block " << parentDirInode.direct_blocks[i] << std::endl;
+    for (long long first = 0; first < dirEntriesCount && !entryWritten; first += entriesPerBlock)
+    {
+        BlockId blockId = inode_manager_->getBlockIdForFileOffset(parentDirInode, (first / entriesPerBlock) * blockSize, false);
+        if (blockId == INVALID_BLOCK_ID)
+            continue;
+        if (!db_manager_->vdisk_->readBlock(blockId, blockBuffer.data(), blockSize))
+        {
+            std::cerr << "Error reading directory block " << blockId << std::endl;
             continue;
         }
-        DirectoryEntry *entries = reinterpret_cast<DirectoryEntry *>(blockBuffer); //
-        for (int j = 0; j < entriesPerBlock; ++j)
+        int slotsInBlock = static_cast<int>(std::min<long long>(entriesPerBlock, dirEntriesCount - first));
+        for (int j = 0; j < slotsInBlock; ++j)
         {
             if (entries[j].inode_id == INVALID_INODE_ID)
-            { //
+            {
                 entries[j] = newEntry;
-                if (!db_manager_->vdisk_->writeBlock(parentDirInode.direct_blocks[i], blockBuffer, DEFAULT_BLOCK_SIZE))
-                { //
-                    std::cerr << "Error writing to directory block " << parentDirInode.direct_blocks[i] << std::endl;
+                if (!db_manager_->vdisk_->writeBlock(blockId, blockBuffer.data(), blockSize))
+                {
+                    std::cerr << "Error writing to directory block " << blockId << std::endl;
                     return false; // Critical error
                 }
                 entryWritten = true;
                 break;
             }
         }
-        if (entryWritten)
-            break;
     }
-    // TODO: Handle indirect blocks if needed
 
     if (!entryWritten)
     {
-        // 没有空位，需要分配新块或在最后一个块的末尾追加（如果空间足够）
-        int currentBlockIndex = (dirSize / DEFAULT_BLOCK_SIZE); //
-        int offsetInBlock = (dirSize % DEFAULT_BLOCK_SIZE);     //
-
-        if (offsetInBlock == 0 || currentBlockIndex >= NUM_DIRECT_BLOCKS /* simplistic */)
+        // 没有空位，追加到末尾；新槽位落在块首时需要分配新块 (直接块和间接块均可)
+        long long logicalBlock = dirEntriesCount / entriesPerBlock;
+        int slotInBlock = static_cast<int>(dirEntriesCount % entriesPerBlock);
+        bool needsNewBlock = (slotInBlock == 0);
+        BlockId blockId = inode_manager_->getBlockIdForFileOffset(parentDirInode, logicalBlock * blockSize, needsNewBlock);
+        if (blockId == INVALID_BLOCK_ID)
         {
-            // 需要新的数据块
-            if (currentBlockIndex >= NUM_DIRECT_BLOCKS)
-            { //
-                // TODO: Implement indirect blocks for directory
-                std::cerr << "Directory full (direct blocks only implemented for addEntry)." << std::endl;
-                return false;
-            }
-            int newBlockId = sb_manager_->allocateBlock(); //
-            if (newBlockId == INVALID_BLOCK_ID)
-            { //
-                std::cerr << "Failed to allocate block for directory entry." << std::endl;
-                return false;
-            }
-            parentDirInode.direct_blocks[currentBlockIndex] = newBlockId; //
-            memset(blockBuffer, 0, DEFAULT_BLOCK_SIZE);                   // // 清零新块
-            offsetInBlock = 0;                                            // 从新块的开始写
-            // --- DEBUG START: Log block allocation ---
-            // std::cout << "[DEBUG] addEntry: Allocated new block " << newBlockId 
-            //           << " for parent inode " << parentDirInode.inode_id 
-            //           << " at direct_blocks[" << currentBlockIndex << "]" << std::endl;
-            //--- DEBUG END ---
+            std::cerr << "Failed to allocate block for directory entry." << std::endl;
+            return false;
         }
-        else
+        if (needsNewBlock)
         {
-            // 当前块还有空间，读取它
-            if (!db_manager_->vdisk_->readBlock(parentDirInode.direct_blocks[currentBlockIndex - 1], blockBuffer, DEFAULT_BLOCK_SIZE))
-            { //
-                std::cerr << "Error reading directory block for append." << std::endl;
-                return false;
-            }
-            // --- DEBUG START: Log reading existing block for append ---
-            // std::cout << "[DEBUG] addEntry: Reading existing block " 
-            //           << parentDirInode.direct_blocks[currentBlockIndex == 0 ? 0 : currentBlockIndex] 
-            //           << " for appending." << std::endl;
-            //--- DEBUG END ---
+            memset(blockBuffer.data(), 0, blockSize); // 清零新块
         }
-
-        DirectoryEntry *entries = reinterpret_cast<DirectoryEntry *>(blockBuffer); //
-        int entryIndexInBlock = offsetInBlock / sizeof(DirectoryEntry);
-        if (entryIndexInBlock < entriesPerBlock)
+        else if (!db_manager_->vdisk_->readBlock(blockId, blockBuffer.data(), blockSize))
         {
-            entries[entryIndexInBlock] = newEntry;
-            // --- DEBUG START: Log details of entry being placed ---
-            // std::cout << "[DEBUG] addEntry: Placing entry ('" << newEntry.filename << "', " << newEntry.inode_id 
-            //           << ") into blockBuffer at index " << entryIndexInBlock << std::endl;
-            // --- DEBUG END ---
-            int blockToWrite = parentDirInode.direct_blocks[currentBlockIndex]; // currentBlockIndex 是目标块的索引
-
-            if (!db_manager_->vdisk_->writeBlock(blockToWrite, blockBuffer, DEFAULT_BLOCK_SIZE))
-            {  //
-                std::cerr << "Error writing new entry to directory block." << std::endl;
-                // TODO: should free allocated block if this was a new block
-                return false;
-            }
-            entryWritten = true;
-            parentDirInode.file_size += sizeof(DirectoryEntry); //
-            // --- DEBUG START: Log parent inode file_size change ---
-            // std::cout << "[DEBUG] addEntry: Parent inode " << parentDirInode.inode_id 
-            //           << " file_size changed from " << dirSize 
-            //           << " to " << parentDirInode.file_size << std::endl;
-            // --- DEBUG END ---
+            std::cerr << "Error reading directory block for append." << std::endl;
+            return false;
         }
-        else
+
+        entries[slotInBlock] = newEntry;
+        if (!db_manager_->vdisk_->writeBlock(blockId, blockBuffer.data(), blockSize))
         {
-            // Should not happen if logic is correct (new block was allocated if needed)
-            std::cerr << "Internal error: No space in block even after allocation/check." << std::endl;
+            std::cerr << "Error writing new entry to directory block." << std::endl;
             return false;
         }
+        entryWritten = true;
+        parentDirInode.file_size += sizeof(DirectoryEntry);
     }
 
     if (!entryWritten)
@@ -332,47 +289,190 @@ bool DirectoryManager::addEntry(Inode &parentDirInode, const std::string &name,
         // TODO: Potential inconsistency, might need to revert the write of DirectoryEntry
         return false;
     }
+    if (indexed(parentDirInode, name))
+    {
+        name_index_->add(parentDirInode.inode_id, newEntry);
+    }
     return true;
 }
 
-int DirectoryManager::findEntry(Inode &dirInode, const std::string &name) const
-{ //
+// Appends entries after the last slot of dirInode, filling each directory block in memory and
+// writing it once, then writes the inode once. Unlike addEntry it does not look for holes or
+// duplicate names, so it is meant for directories that are being filled from scratch (recursive
+// copy), where adding n entries one by one would rescan the directory n times.
+bool DirectoryManager::appendEntries(Inode &dirInode, const std::vector<DirectoryEntry> &entries)
+{
     if (dirInode.file_type != FileType::DIRECTORY)
-    {                            //
-        return INVALID_INODE_ID; //
+    {
+        std::cerr << "Error: Parent inode is not a directory." << std::endl;
+        return false;
+    }
+    if (entries.empty())
+    {
+        return true;
     }
-    if (name.length() >= MAX_FILENAME_LENGTH)
-        return INVALID_INODE_ID; //
 
-    char blockBuffer[DEFAULT_BLOCK_SIZE];                                      //
-    DirectoryEntry *entries = reinterpret_cast<DirectoryEntry *>(blockBuffer); //
-    int entriesPerBlock = DEFAULT_BLOCK_SIZE / sizeof(DirectoryEntry);         //
-    long long dirEntriesCount = dirInode.file_size / sizeof(DirectoryEntry);   //
-    long long entriesRead = 0;
+    int blockSize = sb_manager_->getSuperBlockInfo().block_size;
+    int entriesPerBlock = blockSize / sizeof(DirectoryEntry);
+    AlignedBuffer blockBuffer = db_manager_->vdisk_->bufferPool().acquire(blockSize);
+    DirectoryEntry *slots = reinterpret_cast<DirectoryEntry *>(blockBuffer.data());
+    long long dirEntriesCount = dirInode.file_size / sizeof(DirectoryEntry);
 
-    // 遍历直接块
-    for (int i = 0; i < NUM_DIRECT_BLOCKS && entriesRead < dirEntriesCount; ++i)
-    {                                            //
-        int blockId = dirInode.direct_blocks[i]; //
+    size_t next = 0;
+    while (next < entries.size())
+    {
+        long long logicalBlock = dirEntriesCount / entriesPerBlock;
+        int slotInBlock = static_cast<int>(dirEntriesCount % entriesPerBlock);
+        bool needsNewBlock = (slotInBlock == 0);
+        BlockId blockId = inode_manager_->getBlockIdForFileOffset(dirInode, logicalBlock * blockSize, needsNewBlock);
         if (blockId == INVALID_BLOCK_ID)
-            continue; //
+        {
+            std::cerr << "Failed to allocate block for directory entry." << std::endl;
+            return false;
+        }
+        if (needsNewBlock)
+        {
+            memset(blockBuffer.data(), 0, blockSize);
+        }
+        else if (!db_manager_->vdisk_->readBlock(blockId, blockBuffer.data(), blockSize))
+        {
+            std::cerr << "Error reading directory block for append." << std::endl;
+            return false;
+        }
+        size_t count = std::min<size_t>(entriesPerBlock - slotInBlock, entries.size() - next);
+        std::copy(entries.begin() + next, entries.begin() + next + count, slots + slotInBlock);
+        if (!db_manager_->vdisk_->writeBlock(blockId, blockBuffer.data(), blockSize))
+        {
+            std::cerr << "Error writing new entries to directory block." << std::endl;
+            return false;
+        }
+        next += count;
+        dirEntriesCount += count;
+        dirInode.file_size = dirEntriesCount * sizeof(DirectoryEntry);
+    }
 
-        if (!db_manager_->vdisk_->readBlock(blockId, blockBuffer, DEFAULT_BLOCK_SIZE))
-        { //
-            // Error reading block
-            return INVALID_INODE_ID; //
+    auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    dirInode.modification_time = now;
+    dirInode.access_time = now;
+    if (!inode_manager_->writeInode(dirInode.inode_id, dirInode))
+    {
+        std::cerr << "Failed to write directory inode after appending entries." << std::endl;
+        return false;
+    }
+    for (const DirectoryEntry &entry : entries)
+    {
+        if (indexed(dirInode, entry.filename))
+        {
+            name_index_->add(dirInode.inode_id, entry);
         }
+    }
+    return true;
+}
 
-        for (int j = 0; j < entriesPerBlock && entriesRead < dirEntriesCount; ++j)
+// Removes up to maxEntries live entries ("." and ".." excepted) from the end of a directory and
+// returns how many were taken. The directory simply shrinks: its blocks stay allocated until the
+// inode itself is freed, and later appendEntries calls reuse them.
+int DirectoryManager::takeEntries(Inode &dirInode, int maxEntries, std::vector<DirectoryEntry> &taken)
+{
+    if (dirInode.file_type != FileType::DIRECTORY || maxEntries <= 0)
+    {
+        return 0;
+    }
+
+    int blockSize = sb_manager_->getSuperBlockInfo().block_size;
+    int entriesPerBlock = blockSize / sizeof(DirectoryEntry);
+    AlignedBuffer blockBuffer = db_manager_->vdisk_->bufferPool().acquire(blockSize, false);
+    const DirectoryEntry *slots = reinterpret_cast<const DirectoryEntry *>(blockBuffer.data());
+    long long dirEntriesCount = dirInode.file_size / sizeof(DirectoryEntry);
+    long long loadedBlock = -1;
+    int count = 0;
+
+    while (dirEntriesCount > 0 && count < maxEntries)
+    {
+        long long index = dirEntriesCount - 1;
+        long long logicalBlock = index / entriesPerBlock;
+        if (logicalBlock != loadedBlock)
         {
-            if (entries[j].inode_id != INVALID_INODE_ID && strncmp(entries[j].filename, name.c_str(), MAX_FILENAME_LENGTH) == 0)
-            {                               //
-                return entries[j].inode_id; //
+            BlockId blockId = inode_manager_->getBlockIdForFileOffset(dirInode, logicalBlock * blockSize, false);
+            if (blockId == INVALID_BLOCK_ID || !db_manager_->vdisk_->readBlock(blockId, blockBuffer.data(), blockSize))
+            {
+                std::cerr << "Error reading directory block while taking entries." << std::endl;
+                break;
+            }
+            loadedBlock = logicalBlock;
+        }
+        const DirectoryEntry &entry = slots[index % entriesPerBlock];
+        if (entry.inode_id != INVALID_INODE_ID && strcmp(entry.filename, ".") != 0 && strcmp(entry.filename, "..") != 0)
+        {
+            taken.push_back(entry);
+            ++count;
+            if (indexed(dirInode, entry.filename))
+            {
+                name_index_->remove(dirInode.inode_id, entry.filename);
             }
-            entriesRead++;
+        }
+        else if (entry.inode_id != INVALID_INODE_ID)
+        {
+            break; // "." and ".." are the first two slots, nothing live remains before them
+        }
+        dirEntriesCount = index;
+    }
+
+    if (dirEntriesCount * static_cast<long long>(sizeof(DirectoryEntry)) != dirInode.file_size)
+    {
+        dirInode.file_size = dirEntriesCount * sizeof(DirectoryEntry);
+        auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        dirInode.modification_time = now;
+        if (!inode_manager_->writeInode(dirInode.inode_id, dirInode))
+        {
+            std::cerr << "Failed to write directory inode after taking entries." << std::endl;
+        }
+    }
+    return count;
+}
+
+// Gathers the entry blocks of every directory and hands them to VirtualDisk::prefetchBlocks,
+// which reads the uncached ones as one batch of parallel requests.
+void DirectoryManager::prefetchDirectories(std::vector<Inode> &dirInodes)
+{
+    int blockSize = sb_manager_->getSuperBlockInfo().block_size;
+    std::vector<BlockId> blockIds;
+    for (Inode &dirInode : dirInodes)
+    {
+        if (dirInode.file_type != FileType::DIRECTORY)
+        {
+            continue;
+        }
+        for (long long offset = 0; offset < dirInode.file_size; offset += blockSize)
+        {
+            BlockId blockId = inode_manager_->getBlockIdForFileOffset(dirInode, offset, false);
+            if (blockId != INVALID_BLOCK_ID)
+            {
+                blockIds.push_back(blockId);
+            }
+        }
+    }
+    db_manager_->vdisk_->prefetchBlocks(blockIds);
+}
+
+int DirectoryManager::findEntry(Inode &dirInode, const std::string &name) const
+{ //
+    if (dirInode.file_type != FileType::DIRECTORY)
+    {                            //
+        return INVALID_INODE_ID; //
+    }
+    if (name.length() >= MAX_FILENAME_LENGTH)
+        return INVALID_INODE_ID; //
+
+    DirectoryIterator it = openDirectory(dirInode);
+    const DirectoryEntry *entry = nullptr;
+    while (it.next(entry))
+    {
+        if (strncmp(entry->filename, name.c_str(), MAX_FILENAME_LENGTH) == 0)
+        {
+            return entry->inode_id;
         }
     }
-    // TODO: 遍历间接块
     return INVALID_INODE_ID; //
 }
 
@@ -384,36 +484,91 @@ std::vector<DirectoryEntry> DirectoryManager::listEntries(Inode &dirInode) const
         return result; // Empty list
     }
 
-    char blockBuffer[DEFAULT_BLOCK_SIZE];                                      //
-    DirectoryEntry *entries = reinterpret_cast<DirectoryEntry *>(blockBuffer); //
-    int entriesPerBlock = DEFAULT_BLOCK_SIZE / sizeof(DirectoryEntry);         //
-    long long dirEntriesCount = dirInode.file_size / sizeof(DirectoryEntry);   //
-    long long entriesCollected = 0;
+    // Materialises the whole directory; prefer openDirectory() for large directories.
+    DirectoryIterator it = openDirectory(dirInode);
+    const DirectoryEntry *entry = nullptr;
+    while (it.next(entry))
+    {
+        result.push_back(*entry);
+    }
+    return result;
+}
 
-    // 遍历直接块
-    for (int i = 0; i < NUM_DIRECT_BLOCKS && entriesCollected < dirEntriesCount; ++i)
-    {                                            //
-        int blockId = dirInode.direct_blocks[i]; //
-        if (blockId == INVALID_BLOCK_ID)
-            continue; //
+DirectoryIterator DirectoryManager::openDirectory(const Inode &dirInode, long long cookie) const
+{
+    return DirectoryIterator(inode_manager_, db_manager_->vdisk_, dirInode, sb_manager_->getSuperBlockInfo().block_size, cookie);
+}
 
-        if (!db_manager_->vdisk_->readBlock(blockId, blockBuffer, DEFAULT_BLOCK_SIZE))
-        { //
-            // Error reading block, skip or report
+DirectoryIterator::DirectoryIterator(InodeManager *inodeManager, VirtualDisk *vdisk, const Inode &dirInode, int blockSize, long long cookie)
+    : inode_manager_(inodeManager), vdisk_(vdisk), dir_inode_(dirInode), block_size_(blockSize),
+      entries_per_block_(blockSize / static_cast<int>(sizeof(DirectoryEntry))),
+      entry_count_(dirInode.file_type == FileType::DIRECTORY ? dirInode.file_size / static_cast<long long>(sizeof(DirectoryEntry)) : 0),
+      next_index_(cookie > 0 ? cookie : 0), loaded_block_(-1), loaded_block_id_(INVALID_BLOCK_ID), current_(nullptr), failed_(false)
+{
+    if (entries_per_block_ <= 0)
+    {
+        entry_count_ = 0;
+    }
+}
+
+bool DirectoryIterator::loadBlock(long long logicalBlock)
+{
+    loaded_block_ = logicalBlock;
+    loaded_block_id_ = inode_manager_->getBlockIdForFileOffset(dir_inode_, logicalBlock * block_size_, false);
+    if (loaded_block_id_ == INVALID_BLOCK_ID)
+    {
+        return true; // hole: the caller skips the whole block
+    }
+    if (!block_buffer_.data())
+    {
+        block_buffer_ = vdisk_->bufferPool().acquire(block_size_);
+    }
+    if (!vdisk_->readBlock(loaded_block_id_, block_buffer_.data(), block_size_))
+    {
+        std::cerr << "Error reading directory block " << loaded_block_id_ << std::endl;
+        loaded_block_ = -1;
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool DirectoryIterator::next(const DirectoryEntry *&entry)
+{
+    while (!failed_ && next_index_ < entry_count_)
+    {
+        long long logicalBlock = next_index_ / entries_per_block_;
+        if (logicalBlock != loaded_block_ && !loadBlock(logicalBlock))
+        {
+            return false;
+        }
+        if (loaded_block_id_ == INVALID_BLOCK_ID)
+        {
+            next_index_ = (logicalBlock + 1) * entries_per_block_;
             continue;
         }
 
-        for (int j = 0; j < entriesPerBlock && entriesCollected < dirEntriesCount; ++j)
+        DirectoryEntry *slot = reinterpret_cast<DirectoryEntry *>(block_buffer_.data()) + (next_index_ % entries_per_block_);
+        next_index_++;
+        if (slot->inode_id != INVALID_INODE_ID)
         {
-            if (entries[j].inode_id != INVALID_INODE_ID)
-            { //
-                result.push_back(entries[j]);
-            }
-            entriesCollected++;
+            current_ = slot;
+            entry = slot;
+            return true;
         }
     }
-    // TODO: 遍历间接块
-    return result;
+    current_ = nullptr;
+    return false;
+}
+
+long long DirectoryIterator::cookie() const
+{
+    return next_index_;
+}
+
+bool DirectoryIterator::failed() const
+{
+    return failed_;
 }
 
 int DirectoryManager::createDirectoryInode(short ownerUid, short permissions)
@@ -451,6 +606,7 @@ int DirectoryManager::createDirectoryInode(short ownerUid, short permissions)
         newDirInode.direct_blocks[i] = INVALID_BLOCK_ID;  //
     newDirInode.single_indirect_block = INVALID_BLOCK_ID; //
     newDirInode.double_indirect_block = INVALID_BLOCK_ID; //
+    newDirInode.triple_indirect_block = INVALID_BLOCK_ID; //
 
     if (!inode_manager_->writeInode(inodeId, newDirInode))
     {                                    //
@@ -473,47 +629,31 @@ bool DirectoryManager::removeEntry(Inode &parentDirInode, const std::string &nam
         return false;
     }
 
-    char blockBuffer[DEFAULT_BLOCK_SIZE];                                          //
-    DirectoryEntry *entries = reinterpret_cast<DirectoryEntry *>(blockBuffer);     //
-    int entriesPerBlock = DEFAULT_BLOCK_SIZE / sizeof(DirectoryEntry);             //
-    long long dirEntriesCount = parentDirInode.file_size / sizeof(DirectoryEntry); //
-    long long entriesProcessed = 0;
     bool foundAndRemoved = false;
-    int targetInodeId = INVALID_INODE_ID; //
-
-    for (int i = 0; i < NUM_DIRECT_BLOCKS && entriesProcessed < dirEntriesCount && !foundAndRemoved; ++i)
-    {                                                  //
-        int blockId = parentDirInode.direct_blocks[i]; //
-        if (blockId == INVALID_BLOCK_ID)
-            continue; //
-
-        if (!db_manager_->vdisk_->readBlock(blockId, blockBuffer, DEFAULT_BLOCK_SIZE))
-        { //
-            std::cerr << "Error reading directory block " << blockId << std::endl;
-            return false; // Critical error
-        }
-
-        for (int j = 0; j < entriesPerBlock && entriesProcessed < dirEntriesCount; ++j)
+    DirectoryIterator it = openDirectory(parentDirInode);
+    const DirectoryEntry *entry = nullptr;
+    while (it.next(entry))
+    {
+        if (strncmp(entry->filename, name.c_str(), MAX_FILENAME_LENGTH) == 0)
         {
-            if (entries[j].inode_id != INVALID_INODE_ID && strncmp(entries[j].filename, name.c_str(), MAX_FILENAME_LENGTH) == 0)
-            {                                           //
-                targetInodeId = entries[j].inode_id;    //
-                entries[j].inode_id = INVALID_INODE_ID; // Mark as free
-                // Optionally clear filename: memset(entries[j].filename, 0, MAX_FILENAME_LENGTH);
-                if (!db_manager_->vdisk_->writeBlock(blockId, blockBuffer, DEFAULT_BLOCK_SIZE))
-                { //
-                    std::cerr << "Error writing to directory block " << blockId << " after removal." << std::endl;
-                    // Entry is logically removed from inode, but disk state might be inconsistent.
-                    // For robustness, may need to mark file system as dirty or attempt recovery.
-                    return false;
-                }
-                foundAndRemoved = true;
-                break;
+            // Mark the slot free inside the iterator's block buffer and write that block back.
+            it.current_->inode_id = INVALID_INODE_ID;
+            // Optionally clear filename: memset(it.current_->filename, 0, MAX_FILENAME_LENGTH);
+            if (!db_manager_->vdisk_->writeBlock(it.loaded_block_id_, it.block_buffer_.data(), it.block_size_))
+            { //
+                std::cerr << "Error writing to directory block " << it.loaded_block_id_ << " after removal." << std::endl;
+                // Entry is logically removed from inode, but disk state might be inconsistent.
+                // For robustness, may need to mark file system as dirty or attempt recovery.
+                return false;
             }
-            entriesProcessed++;
+            foundAndRemoved = true;
+            break;
         }
     }
-    // TODO: Handle indirect blocks
+    if (it.failed())
+    {
+        return false; // Critical error
+    }
 
     if (!foundAndRemoved)
     {
@@ -535,6 +675,10 @@ bool DirectoryManager::removeEntry(Inode &parentDirInode, const std::string &nam
         std::cerr << "Failed to write parent directory inode after removing entry." << std::endl;
         return false;
     }
+    if (indexed(parentDirInode, name))
+    {
+        name_index_->remove(parentDirInode.inode_id, name);
+    }
 
     // The caller (FileSystem::rm) is responsible for:
     // 1. Decrementing link_count of the targetInodeId.
@@ -542,4 +686,61 @@ bool DirectoryManager::removeEntry(Inode &parentDirInode, const std::string &nam
     // 3. If targetInodeId was a directory, decrementing parentDirInode's link_count (due to ".." no longer pointing to it).
 
     return true;
-}
\ No newline at end of file
+}
+
+// Points an existing entry at another inode in place: the one block holding the entry is rewritten,
+// so a rename over an existing name never shows a moment where the name is missing.
+bool DirectoryManager::replaceEntry(Inode &dirInode, const std::string &name, int entryInodeId)
+{
+    if (dirInode.file_type != FileType::DIRECTORY)
+    {
+        std::cerr << "Parent is not a directory." << std::endl;
+        return false;
+    }
+
+    DirectoryIterator it = openDirectory(dirInode);
+    const DirectoryEntry *entry = nullptr;
+    while (it.next(entry))
+    {
+        if (strncmp(entry->filename, name.c_str(), MAX_FILENAME_LENGTH) == 0)
+        {
+            it.current_->inode_id = entryInodeId;
+            if (!db_manager_->vdisk_->writeBlock(it.loaded_block_id_, it.block_buffer_.data(), it.block_size_))
+            {
+                std::cerr << "Error writing to directory block " << it.loaded_block_id_ << " after replacing an entry." << std::endl;
+                return false;
+            }
+            auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            dirInode.modification_time = now;
+            dirInode.access_time = now;
+            if (!inode_manager_->writeInode(dirInode.inode_id, dirInode))
+            {
+                std::cerr << "Failed to write directory inode after replacing an entry." << std::endl;
+                return false;
+            }
+            if (indexed(dirInode, name))
+            {
+                name_index_->retarget(dirInode.inode_id, name, entryInodeId);
+            }
+            return true;
+        }
+    }
+    if (!it.failed())
+    {
+        std::cerr << "Entry '" << name << "' not found in directory." << std::endl;
+    }
+    return false;
+}
+
+void DirectoryManager::setNameIndex(NameIndex *nameIndex)
+{
+    name_index_ = nameIndex;
+}
+
+// Whether a change to this entry must reach the filename index: "." and ".." and the entries of the
+// orphan directory are never indexed.
+bool DirectoryManager::indexed(const Inode &dirInode, const std::string &name) const
+{
+    return name_index_ && name_index_->enabled() && dirInode.inode_id != sb_manager_->getSuperBlockInfo().orphan_dir_inode_idx &&
+           name != "." && name != "..";
+}
@@ -27,6 +27,7 @@ int FileManager::createFileInode(short ownerUid, short permissions)
         newFileInode.direct_blocks[i] = INVALID_BLOCK_ID;  //
     newFileInode.single_indirect_block = INVALID_BLOCK_ID; //
     newFileInode.double_indirect_block = INVALID_BLOCK_ID; //
+    newFileInode.triple_indirect_block = INVALID_BLOCK_ID; //
 
     if (!inode_manager_->writeInode(inodeId, newFileInode))
     {                                    //
@@ -39,18 +40,17 @@ int FileManager::createFileInode(short ownerUid, short permissions)
 // processOpenFileTable 和 systemOpenFileTable 作为引用传递，因为 FileManager 会修改它们
 int FileManager::openFile(int inodeId, OpenMode mode,                              //
                           std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
-                          std::vector<SystemOpenFileEntry> &systemOpenFileTable)
+                          SystemOpenFileTable &systemOpenFileTable)
 { //
 
-    // 1. 查找或创建系统打开文件表条目
+    // 1. 查找或创建系统打开文件表条目 (hash lookup by inode id)
     int system_idx = -1;
-    for (size_t i = 0; i < systemOpenFileTable.size(); ++i)
+    auto indexed = systemOpenFileTable.inode_index.find(inodeId);
+    if (indexed != systemOpenFileTable.inode_index.end())
     {
-        if (systemOpenFileTable[i].inode_id == inodeId)
-        { //
-            system_idx = i;
-            break;
-        }
+        system_idx = indexed->second;
+        // Buffered writes must reach the disk inode before it is re-read below
+        flushWriteBuffer(systemOpenFileTable.entries[system_idx]);
     }
 
     Inode inode_cache_copy; //
@@ -60,69 +60,65 @@ int FileManager::openFile(int inodeId, OpenMode mode,
         return -1; // Indicate failure
     }
 
+    std::vector<SystemOpenFileEntry> &entries = systemOpenFileTable.entries;
     if (system_idx == -1)
     { // Not found in system table, create new entry
-        // Find a free slot in systemOpenFileTable or add a new one
+        // Reuse a released slot if there is one, otherwise grow the table up to its limit
         int free_sys_slot = -1;
-        for (size_t i = 0; i < systemOpenFileTable.size(); ++i)
+        if (!systemOpenFileTable.free_slots.empty())
         {
-            if (systemOpenFileTable[i].inode_id == INVALID_INODE_ID)
-            { // Assuming INVALID_INODE_ID marks a free slot
-                free_sys_slot = i;
-                break;
-            }
+            free_sys_slot = systemOpenFileTable.free_slots.top();
+            systemOpenFileTable.free_slots.pop();
         }
-        if (free_sys_slot == -1)
-        { // No free slot, add to end
-            if (systemOpenFileTable.size() < MAX_SYSTEM_OPEN_FILES)
-            {
-                systemOpenFileTable.push_back({}); // Add an empty entry
-                free_sys_slot = systemOpenFileTable.size() - 1;
-            }
-            else
-            {
-                std::cerr << "FileManager::openFile: System open file table is full." << std::endl;
-                return -1;
-            }
+        else if (entries.size() < static_cast<size_t>(systemOpenFileTable.max_entries))
+        {
+            entries.push_back({}); // Add an empty entry
+            free_sys_slot = entries.size() - 1;
+        }
+        else
+        {
+            std::cerr << "FileManager::openFile: System open file table is full." << std::endl;
+            return -1;
         }
         system_idx = free_sys_slot;
-        systemOpenFileTable[system_idx].inode_id = inodeId;             //
-        systemOpenFileTable[system_idx].inode_cache = inode_cache_copy; //
-        systemOpenFileTable[system_idx].open_count = 1;                 //
-        systemOpenFileTable[system_idx].mode = mode;                    // Store the mode it was first opened with, or most permissive? Usually per-process.
-                                                                        // The mode in SystemOpenFileEntry might be more about caching/dirty flags
-                                                                        // than strict open mode enforcement (which is per FD).
-                                                                        // Let's simplify and assume the mode is relevant for the system entry.
+        systemOpenFileTable.inode_index[inodeId] = system_idx;
+        entries[system_idx].inode_id = inodeId;             //
+        entries[system_idx].inode_cache = inode_cache_copy; //
+        entries[system_idx].open_count = 1;                 //
+        entries[system_idx].mode = mode;                    // Store the mode it was first opened with, or most permissive? Usually per-process.
+                                                            // The mode in SystemOpenFileEntry might be more about caching/dirty flags
+                                                            // than strict open mode enforcement (which is per FD).
+                                                            // Let's simplify and assume the mode is relevant for the system entry.
     }
     else
-    {                                                 // Found in system table
-        systemOpenFileTable[system_idx].open_count++; //
+    {                                     // Found in system table
+        entries[system_idx].open_count++; //
         // Mode compatibility check:
         // If it's already open, and the new mode is incompatible (e.g. trying to open for write something already open for read by another process if exclusivity is desired)
         // This simplistic model doesn't handle complex sharing modes.
         // We can update the cached inode if the disk version is newer (e.g. via modification time)
         // but for now, just use the existing cache or the newly read one.
         // For safety, let's re-assign/update cache to the freshly read one.
-        systemOpenFileTable[system_idx].inode_cache = inode_cache_copy; //
+        entries[system_idx].inode_cache = inode_cache_copy; //
     }
 
     // 处理 MODE_WRITE: 截断文件 (truncate)
     if (mode == OpenMode::MODE_WRITE)
     { //
         // Clear all data blocks associated with this inode
-        db_manager_->clearInodeDataBlocks(systemOpenFileTable[system_idx].inode_cache); //
+        db_manager_->clearInodeDataBlocks(entries[system_idx].inode_cache); //
         // Reset file size in cache and on disk
-        systemOpenFileTable[system_idx].inode_cache.file_size = 0; //
+        entries[system_idx].inode_cache.file_size = 0; //
         auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-        systemOpenFileTable[system_idx].inode_cache.modification_time = now; //
-        systemOpenFileTable[system_idx].inode_cache.access_time = now;       //
-        if (!inode_manager_->writeInode(inodeId, systemOpenFileTable[system_idx].inode_cache))
+        entries[system_idx].inode_cache.modification_time = now; //
+        entries[system_idx].inode_cache.access_time = now;       //
+        if (!inode_manager_->writeInode(inodeId, entries[system_idx].inode_cache))
         { //
             std::cerr << "FileManager::openFile: Failed to write truncated inode " << inodeId << std::endl;
             // Decrement open count as open failed partially
-            systemOpenFileTable[system_idx].open_count--; //
-            if (systemOpenFileTable[system_idx].open_count == 0)
-                systemOpenFileTable[system_idx].inode_id = INVALID_INODE_ID; //
+            entries[system_idx].open_count--; //
+            if (entries[system_idx].open_count == 0)
+                releaseSystemEntry(system_idx, systemOpenFileTable);
             return -1;
         }
     }
@@ -134,7 +130,7 @@ int FileManager::openFile(int inodeId, OpenMode mode,
 
 bool FileManager::closeFile(int fd,                                                  //
                             std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
-                            std::vector<SystemOpenFileEntry> &systemOpenFileTable)
+                            SystemOpenFileTable &systemOpenFileTable)
 { //
     if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size())
     {
@@ -143,8 +139,8 @@ bool FileManager::closeFile(int fd,
     }
 
     int system_idx = processOpenFileTable[fd].system_table_idx; //
-    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.size() ||
-        systemOpenFileTable[system_idx].inode_id == INVALID_INODE_ID)
+    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.entries.size() ||
+        systemOpenFileTable.entries[system_idx].inode_id == INVALID_INODE_ID)
     { //
         std::cerr << "FileManager::closeFile: Invalid system_table_idx for fd " << fd << std::endl;
         // fd might have already been closed or was invalid.
@@ -153,8 +149,12 @@ bool FileManager::closeFile(int fd,
         return false;                                           // Or true if we consider "already closed" as success for idempotency.
     }
 
-    SystemOpenFileEntry &sys_entry = systemOpenFileTable[system_idx]; //
-    sys_entry.open_count--;                                           //
+    SystemOpenFileEntry &sys_entry = systemOpenFileTable.entries[system_idx]; //
+    if (!flushWriteBuffer(sys_entry))
+    {
+        std::cerr << "FileManager::closeFile: Failed to flush buffered writes for fd " << fd << std::endl;
+    }
+    sys_entry.open_count--; //
 
     if (sys_entry.open_count == 0)
     { //
@@ -171,8 +171,7 @@ bool FileManager::closeFile(int fd,
             // This is problematic. The file is closed, but inode state might be lost.
         }
         // Mark the system open file table entry as free
-        sys_entry.inode_id = INVALID_INODE_ID; //
-        // sys_entry.inode_cache can be cleared too.
+        releaseSystemEntry(system_idx, systemOpenFileTable);
     }
 
     // The FileSystem layer will mark processOpenFileTable[fd] as free.
@@ -182,38 +181,49 @@ bool FileManager::closeFile(int fd,
 }
 
 int FileManager::readFile(int fd, char *buffer, int length,                              //
-                          const std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
-                          std::vector<SystemOpenFileEntry> &systemOpenFileTable)
+                          std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
+                          SystemOpenFileTable &systemOpenFileTable)
 { // System table is non-const because inode_cache (access time) might be updated. //
     if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size() || length <= 0)
     {
         return -1; // Invalid arguments
     }
-    const ProcessOpenFileEntry &proc_entry = processOpenFileTable[fd]; //
-    int system_idx = proc_entry.system_table_idx;                      //
+    // proc_entry.current_offset is advanced by FileSystem::read
+    return readFileAt(fd, buffer, length, processOpenFileTable[fd].current_offset, processOpenFileTable, systemOpenFileTable);
+}
 
-    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.size() ||
-        systemOpenFileTable[system_idx].inode_id == INVALID_INODE_ID)
+int FileManager::readFileAt(int fd, char *buffer, int length, long long offset,          //
+                            std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
+                            SystemOpenFileTable &systemOpenFileTable)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size() || length <= 0 || offset < 0)
+    {
+        return -1; // Invalid arguments
+    }
+    ProcessOpenFileEntry &proc_entry = processOpenFileTable[fd]; // // Non-const for readahead state
+    int system_idx = proc_entry.system_table_idx;                //
+
+    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.entries.size() ||
+        systemOpenFileTable.entries[system_idx].inode_id == INVALID_INODE_ID)
     { //
         std::cerr << "FileManager::readFile: Invalid system_table_idx for fd " << fd << std::endl;
         return -1;
     }
 
-    SystemOpenFileEntry &sys_entry = systemOpenFileTable[system_idx]; //
+    SystemOpenFileEntry &sys_entry = systemOpenFileTable.entries[system_idx]; //
+    if (!flushWriteBuffer(sys_entry))
+    {
+        return -1;
+    }
 
     // Check open mode permission for reading
-    OpenMode current_mode = sys_entry.mode; // This 'mode' in SystemOpenFileEntry might be the mode of the *first* opener.
-                                            // A better design would store OpenMode in ProcessOpenFileEntry.
-                                            // Let's assume FileSystem::open already put a relevant mode in ProcessOpenFileEntry,
-                                            // or that sys_entry.mode is sufficient if we simplify that all openers must be compatible.
-                                            // For now, we'll rely on FileSystem to have checked permissions on open.
-                                            // A quick check here:
+    // The 'mode' in SystemOpenFileEntry is the mode of the *first* opener; a better design would
+    // store OpenMode in ProcessOpenFileEntry. For now we rely on FileSystem to have checked permissions on open.
     // if (sys_entry.mode != OpenMode::MODE_READ && sys_entry.mode != OpenMode::MODE_READ_WRITE) {
     //    std::cerr << "FileManager::readFile: File (fd " << fd << ") not opened for reading." << std::endl;
     //    return -1;
     // }
 
-    long long offset = proc_entry.current_offset;                                              //
     int bytes_to_read = std::min((long long)length, sys_entry.inode_cache.file_size - offset); //
 
     if (bytes_to_read <= 0)
@@ -221,38 +231,152 @@ int FileManager::readFile(int fd, char *buffer, int length,
         return 0; // EOF or nothing to read at this offset
     }
 
-    int bytes_read = db_manager_->readFileData(sys_entry.inode_cache, offset, buffer, bytes_to_read); //
+    // Access time is updated by FileSystem::read / FileSystem::pread after this call.
+    return db_manager_->readFileData(sys_entry.inode_cache, offset, buffer, bytes_to_read, &proc_entry.readahead); //
+}
+
+int FileManager::writeFile(int fd, const char *buffer, int length,                  //
+                           std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
+                           SystemOpenFileTable &systemOpenFileTable)
+{ //
+    if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size() || length < 0)
+    {
+        return -1; // Invalid arguments
+    }
+
+    const ProcessOpenFileEntry &proc_entry = processOpenFileTable[fd]; //
+    int system_idx = proc_entry.system_table_idx;                      //
+    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.entries.size() ||
+        systemOpenFileTable.entries[system_idx].inode_id == INVALID_INODE_ID)
+    { //
+        std::cerr << "FileManager::writeFile: Invalid system_table_idx for fd " << fd << std::endl;
+        return -1;
+    }
 
-    if (bytes_read > 0)
+    // For a simple append, offset is always end of file (including data still sitting in the write buffer).
+    // FileSystem::open set the initial offset for append. Subsequent writes in append mode also go to current EOF,
+    // and FileSystem::write moves the process's current_offset along with it.
+    SystemOpenFileEntry &sys_entry = systemOpenFileTable.entries[system_idx]; //
+    WriteBuffer &wb = sys_entry.write_buffer;
+    long long buffered_end = wb.start_offset + static_cast<long long>(wb.data.size());
+    long long offset = (sys_entry.mode == OpenMode::MODE_APPEND)
+                           ? (wb.data.empty() ? sys_entry.inode_cache.file_size : std::max(sys_entry.inode_cache.file_size, buffered_end))
+                           : proc_entry.current_offset;
+
+    // Large writes go straight to the data layer (writeFileAt flushes the buffer first)
+    const long long buffer_limit = static_cast<long long>(WRITE_BUFFER_BLOCKS) * sb_manager_->getSuperBlockInfo().block_size;
+    if (length >= buffer_limit)
     {
-        // Access time is updated by FileSystem::read after this call.
-        // proc_entry.current_offset += bytes_read; // This is done by FileSystem::read
+        return writeFileAt(fd, buffer, length, offset, processOpenFileTable, systemOpenFileTable);
     }
-    return bytes_read;
+    if (length == 0)
+        return 0;
+
+    // A write that does not continue the buffered range flushes it and starts a new one
+    if (!wb.data.empty() && offset != buffered_end)
+    {
+        if (!flushWriteBuffer(sys_entry))
+            return -1;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (wb.data.empty())
+    {
+        wb.start_offset = offset;
+        wb.first_write_time = now;
+    }
+    wb.data.insert(wb.data.end(), buffer, buffer + length);
+
+    // Full buffer: write out the whole blocks and keep the partial tail; stale buffer: write everything
+    bool flushed = true;
+    if (static_cast<long long>(wb.data.size()) >= buffer_limit)
+    {
+        flushed = flushWriteBuffer(sys_entry, true);
+    }
+    else if (now - wb.first_write_time >= std::chrono::milliseconds(WRITE_BUFFER_MAX_AGE_MS))
+    {
+        flushed = flushWriteBuffer(sys_entry);
+    }
+    return flushed ? length : -1;
 }
 
-int FileManager::writeFile(int fd, const char *buffer, int length,                  //
+// Writes buffered data through the data layer. With wholeBlocksOnly only the part ending on a
+// block boundary is written and the partial tail stays buffered for the next write to extend.
+bool FileManager::flushWriteBuffer(SystemOpenFileEntry &sysEntry, bool wholeBlocksOnly)
+{
+    WriteBuffer &wb = sysEntry.write_buffer;
+    if (wb.data.empty())
+        return true;
+
+    long long end = wb.start_offset + static_cast<long long>(wb.data.size());
+    if (wholeBlocksOnly)
+    {
+        int block_size = sb_manager_->getSuperBlockInfo().block_size;
+        end = end / block_size * block_size;
+        if (end <= wb.start_offset)
+            return true;
+    }
+    int length = static_cast<int>(end - wb.start_offset);
+
+    bool size_changed = false;
+    int written = db_manager_->writeFileData(sysEntry.inode_cache, wb.start_offset, wb.data.data(), length, size_changed);
+    if (written > 0)
+    {
+        wb.data.erase(wb.data.begin(), wb.data.begin() + written);
+        wb.start_offset += written;
+        wb.first_write_time = std::chrono::steady_clock::now();
+    }
+    if (written != length)
+    {
+        std::cerr << "FileManager::flushWriteBuffer: Flushed only " << written << " of " << length
+                  << " bytes for inode " << sysEntry.inode_id << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FileManager::syncFile(int fd,                                                   //
                            std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
-                           std::vector<SystemOpenFileEntry> &systemOpenFileTable)
+                           SystemOpenFileTable &systemOpenFileTable)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size())
+    {
+        return false;
+    }
+    int system_idx = processOpenFileTable[fd].system_table_idx; //
+    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.entries.size() ||
+        systemOpenFileTable.entries[system_idx].inode_id == INVALID_INODE_ID)
+    { //
+        std::cerr << "FileManager::syncFile: Invalid system_table_idx for fd " << fd << std::endl;
+        return false;
+    }
+    return flushWriteBuffer(systemOpenFileTable.entries[system_idx]);
+}
+
+int FileManager::writeFileAt(int fd, const char *buffer, int length, long long offset, //
+                             std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
+                             SystemOpenFileTable &systemOpenFileTable)
 { //
-    if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size() || length < 0)
+    if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size() || length < 0 || offset < 0)
     {
         return -1; // Invalid arguments
     }
     if (length == 0)
         return 0; // Nothing to write
 
-    ProcessOpenFileEntry &proc_entry = processOpenFileTable[fd]; // // Non-const for offset
-    int system_idx = proc_entry.system_table_idx;                //
+    int system_idx = processOpenFileTable[fd].system_table_idx; //
 
-    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.size() ||
-        systemOpenFileTable[system_idx].inode_id == INVALID_INODE_ID)
+    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.entries.size() ||
+        systemOpenFileTable.entries[system_idx].inode_id == INVALID_INODE_ID)
     { //
         std::cerr << "FileManager::writeFile: Invalid system_table_idx for fd " << fd << std::endl;
         return -1;
     }
 
-    SystemOpenFileEntry &sys_entry = systemOpenFileTable[system_idx]; //
+    SystemOpenFileEntry &sys_entry = systemOpenFileTable.entries[system_idx]; //
+    if (!flushWriteBuffer(sys_entry))
+    {
+        return -1;
+    }
 
     // Check open mode permission for writing
     // Similar to readFile, relying on FileSystem layer for initial check.
@@ -261,36 +385,70 @@ int FileManager::writeFile(int fd, const char *buffer, int length,
     //    return -1;
     // }
 
-    long long offset;
-    // If append mode was stored per-FD (in ProcessOpenFileEntry), we'd check that.
-    // Assuming sys_entry.mode reflects the relevant mode for this FD, or FileSystem handles append logic.
-    // For a simple append, offset is always end of file.
-    // FileSystem::open set the initial offset for append. Subsequent writes in append mode also go to current EOF.
-    if (sys_entry.mode == OpenMode::MODE_APPEND)
-    {                                             //
-        offset = sys_entry.inode_cache.file_size; // // Write at current end of file
+    // inode_cache.file_size is updated by writeFileData if it changed.
+    // Modification and Access times are updated by FileSystem::write / FileSystem::pwrite after this call.
+    bool size_changed = false;
+    return db_manager_->writeFileData(sys_entry.inode_cache, offset, buffer, length, size_changed); //
+}
+
+int FileManager::readFileVecAt(int fd, const IoVec *iov, int iovcnt, long long offset,       //
+                               std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
+                               SystemOpenFileTable &systemOpenFileTable)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size() || offset < 0)
+    {
+        return -1; // Invalid arguments
     }
-    else
+    int system_idx = processOpenFileTable[fd].system_table_idx; //
+    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.entries.size() ||
+        systemOpenFileTable.entries[system_idx].inode_id == INVALID_INODE_ID)
+    { //
+        std::cerr << "FileManager::readFileVecAt: Invalid system_table_idx for fd " << fd << std::endl;
+        return -1;
+    }
+    if (!flushWriteBuffer(systemOpenFileTable.entries[system_idx]))
     {
-        offset = proc_entry.current_offset; //
+        return -1;
     }
 
-    bool size_changed = false;
-    int bytes_written = db_manager_->writeFileData(sys_entry.inode_cache, offset, buffer, length, size_changed); //
+    // readFileDataV clamps the request to EOF and updates the access time with a single inode write.
+    return db_manager_->readFileDataV(systemOpenFileTable.entries[system_idx].inode_cache, offset, iov, iovcnt,
+                                      &processOpenFileTable[fd].readahead);
+}
 
-    if (bytes_written > 0)
+int FileManager::writeFileVecAt(int fd, const IoVec *iov, int iovcnt, long long offset, //
+                                std::vector<ProcessOpenFileEntry> &processOpenFileTable, //
+                                SystemOpenFileTable &systemOpenFileTable)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= processOpenFileTable.size() || offset < 0)
     {
-        // inode_cache.file_size would have been updated by writeFileData if it changed.
-        // Modification and Access times are updated by FileSystem::write after this call.
-        // proc_entry.current_offset += bytes_written; // This is done by FileSystem::write
-
-        // If append mode, the process's current_offset should also move to the new EOF
-        if (sys_entry.mode == OpenMode::MODE_APPEND)
-        { //
-          // proc_entry.current_offset = sys_entry.inode_cache.file_size; // FileSystem will handle this.
-        }
+        return -1; // Invalid arguments
     }
-    return bytes_written;
+    int system_idx = processOpenFileTable[fd].system_table_idx; //
+    if (system_idx < 0 || static_cast<size_t>(system_idx) >= systemOpenFileTable.entries.size() ||
+        systemOpenFileTable.entries[system_idx].inode_id == INVALID_INODE_ID)
+    { //
+        std::cerr << "FileManager::writeFileVecAt: Invalid system_table_idx for fd " << fd << std::endl;
+        return -1;
+    }
+    if (!flushWriteBuffer(systemOpenFileTable.entries[system_idx]))
+    {
+        return -1;
+    }
+
+    // writeFileDataV updates size and timestamps and writes the inode back exactly once.
+    bool size_changed = false;
+    return db_manager_->writeFileDataV(systemOpenFileTable.entries[system_idx].inode_cache, offset, iov, iovcnt, size_changed);
+}
+
+// Drops a system table entry whose open_count reached zero: unindex it and recycle the slot.
+void FileManager::releaseSystemEntry(int systemIdx, SystemOpenFileTable &systemOpenFileTable)
+{
+    SystemOpenFileEntry &sys_entry = systemOpenFileTable.entries[systemIdx];
+    systemOpenFileTable.inode_index.erase(sys_entry.inode_id);
+    sys_entry.inode_id = INVALID_INODE_ID; //
+    sys_entry.write_buffer = WriteBuffer();
+    systemOpenFileTable.free_slots.push(systemIdx);
 }
 
 bool FileManager::deleteFileByInode(int inodeId)
@@ -0,0 +1,428 @@
+#include "file_operations/name_index.h"
+#include <cstring>
+#include <iostream>
+#include <functional>
+#include <algorithm>
+#include <fnmatch.h>
+
+NameIndex::NameIndex(DataBlockManager *dbManager, InodeManager *inodeManager)
+    : db_manager_(dbManager), inode_manager_(inodeManager), enabled_(false), live_postings_(0), stale_postings_(0)
+{
+}
+
+bool NameIndex::enabled() const
+{
+    return enabled_;
+}
+
+size_t NameIndex::size() const
+{
+    return records_.size() - free_records_.size();
+}
+
+size_t NameIndex::entryHash(int parentInodeId, const std::string &name)
+{
+    return std::hash<std::string>()(name) * 31 + std::hash<int>()(parentInodeId);
+}
+
+// Reads the index file in large chunks and rebuilds the in-memory tables from its slots.
+bool NameIndex::load(int indexInodeId)
+{
+    disable();
+    if (!inode_manager_->readInode(indexInodeId, index_inode_))
+    {
+        std::cerr << "Error: Could not read the filename index inode " << indexInodeId << "." << std::endl;
+        return false;
+    }
+    long long slotCount = index_inode_.file_size / sizeof(NameIndexSlot);
+    const long long chunkSlots = 1024;
+    std::vector<NameIndexSlot> chunk(chunkSlots);
+    records_.reserve(slotCount);
+    for (long long first = 0; first < slotCount; first += chunkSlots)
+    {
+        int count = static_cast<int>(std::min(chunkSlots, slotCount - first));
+        int length = count * static_cast<int>(sizeof(NameIndexSlot));
+        if (db_manager_->readFileData(index_inode_, first * sizeof(NameIndexSlot), reinterpret_cast<char *>(chunk.data()), length) != length)
+        {
+            std::cerr << "Error: Could not read the filename index." << std::endl;
+            disable();
+            return false;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            const NameIndexSlot &slot = chunk[i];
+            records_.push_back({INVALID_INODE_ID, INVALID_INODE_ID, std::string(), 0});
+            if (slot.parent_inode_id == INVALID_INODE_ID)
+            {
+                free_records_.push_back(records_.size() - 1);
+            }
+            else
+            {
+                insertRecord(records_.size() - 1, slot.parent_inode_id, slot.entry.inode_id,
+                             std::string(slot.entry.filename, strnlen(slot.entry.filename, MAX_FILENAME_LENGTH)));
+            }
+        }
+    }
+    enabled_ = true;
+    return true;
+}
+
+bool NameIndex::reset(int indexInodeId)
+{
+    disable();
+    if (!inode_manager_->readInode(indexInodeId, index_inode_))
+    {
+        std::cerr << "Error: Could not read the filename index inode " << indexInodeId << "." << std::endl;
+        return false;
+    }
+    db_manager_->clearInodeDataBlocks(index_inode_);
+    enabled_ = true;
+    return true;
+}
+
+void NameIndex::disable()
+{
+    enabled_ = false;
+    records_.clear();
+    free_records_.clear();
+    by_name_.clear();
+    by_entry_.clear();
+    by_inode_.clear();
+    trigrams_.clear();
+    live_postings_ = 0;
+    stale_postings_ = 0;
+}
+
+void NameIndex::add(int parentInodeId, const DirectoryEntry &entry)
+{
+    if (!enabled_)
+    {
+        return;
+    }
+    size_t slot = records_.size();
+    if (!free_records_.empty())
+    {
+        slot = free_records_.back();
+        free_records_.pop_back();
+    }
+    else
+    {
+        records_.push_back({INVALID_INODE_ID, INVALID_INODE_ID, std::string(), 0});
+    }
+    insertRecord(slot, parentInodeId, entry.inode_id, std::string(entry.filename, strnlen(entry.filename, MAX_FILENAME_LENGTH)));
+    writeSlot(slot);
+}
+
+void NameIndex::remove(int parentInodeId, const std::string &name)
+{
+    if (!enabled_)
+    {
+        return;
+    }
+    size_t slot = findRecord(parentInodeId, name);
+    if (slot == records_.size())
+    {
+        return;
+    }
+    eraseRecord(slot);
+    free_records_.push_back(slot);
+    writeSlot(slot);
+}
+
+void NameIndex::retarget(int parentInodeId, const std::string &name, int entryInodeId)
+{
+    if (!enabled_)
+    {
+        return;
+    }
+    size_t slot = findRecord(parentInodeId, name);
+    if (slot == records_.size())
+    {
+        return;
+    }
+    auto named = by_inode_.find(records_[slot].inode_id);
+    if (named != by_inode_.end() && named->second == slot)
+    {
+        by_inode_.erase(named);
+    }
+    records_[slot].inode_id = entryInodeId;
+    by_inode_[entryInodeId] = slot;
+    writeSlot(slot);
+}
+
+void NameIndex::lookup(const std::string &name, std::vector<NameIndexSlot> &matches) const
+{
+    auto bucket = by_name_.find(std::hash<std::string>()(name));
+    if (bucket == by_name_.end())
+    {
+        return;
+    }
+    for (size_t slot : bucket->second)
+    {
+        const Record &record = records_[slot];
+        if (record.name == name)
+        {
+            matches.push_back(toSlot(record));
+        }
+    }
+}
+
+void NameIndex::match(const std::string &pattern, std::vector<NameIndexSlot> &matches) const
+{
+    std::vector<uint32_t> wanted;
+    patternTrigrams(pattern, wanted);
+    const std::vector<size_t> *rarest = nullptr;
+    for (uint32_t trigram : wanted)
+    {
+        auto postings = trigrams_.find(trigram);
+        if (postings == trigrams_.end())
+        {
+            return; // no name contains this part of the pattern
+        }
+        if (!rarest || postings->second.size() < rarest->size())
+        {
+            rarest = &postings->second;
+        }
+    }
+
+    // Without a literal run of three characters ("*.c") every name is a candidate; that is still
+    // a scan of memory rather than of the directories.
+    std::vector<size_t> candidates;
+    if (rarest)
+    {
+        candidates = *rarest;
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    }
+    else
+    {
+        candidates.resize(records_.size());
+        for (size_t slot = 0; slot < records_.size(); ++slot)
+        {
+            candidates[slot] = slot;
+        }
+    }
+    for (size_t slot : candidates)
+    {
+        const Record &record = records_[slot];
+        if (record.parent_inode_id != INVALID_INODE_ID && fnmatch(pattern.c_str(), record.name.c_str(), 0) == 0)
+        {
+            matches.push_back(toSlot(record));
+        }
+    }
+}
+
+NameIndexSlot NameIndex::toSlot(const Record &record) const
+{
+    NameIndexSlot slot{};
+    slot.parent_inode_id = record.parent_inode_id;
+    slot.entry.inode_id = record.inode_id;
+    std::strncpy(slot.entry.filename, record.name.c_str(), MAX_FILENAME_LENGTH - 1);
+    return slot;
+}
+
+void NameIndex::nameTrigrams(const std::string &name, std::vector<uint32_t> &trigrams)
+{
+    for (size_t i = 0; i + 3 <= name.size(); ++i)
+    {
+        trigrams.push_back(static_cast<uint32_t>(static_cast<unsigned char>(name[i])) << 16 |
+                           static_cast<uint32_t>(static_cast<unsigned char>(name[i + 1])) << 8 |
+                           static_cast<uint32_t>(static_cast<unsigned char>(name[i + 2])));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+}
+
+// Splits the pattern at its wildcards ("*", "?" and bracket expressions); every run of literal
+// characters must appear in a matching name, and so must each of its trigrams.
+void NameIndex::patternTrigrams(const std::string &pattern, std::vector<uint32_t> &trigrams)
+{
+    std::string literal;
+    auto flush = [&]()
+    {
+        std::vector<uint32_t> run;
+        nameTrigrams(literal, run);
+        trigrams.insert(trigrams.end(), run.begin(), run.end());
+        literal.clear();
+    };
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        char c = pattern[i];
+        if (c == '\\' && i + 1 < pattern.size())
+        {
+            literal += pattern[++i];
+        }
+        else if (c == '*' || c == '?')
+        {
+            flush();
+        }
+        else if (c == '[')
+        {
+            flush();
+            i = bracketEnd(pattern, i);
+        }
+        else
+        {
+            literal += c;
+        }
+    }
+    flush();
+}
+
+// Returns the position of the ']' closing the bracket expression opened at pattern[open], as fnmatch
+// reads it: a ']' right after "[", "[!" or "[^" is a member of the set, "\]" is escaped, and
+// "[:class:]", "[=c=]" and "[.c.]" end at their own ":]", "=]" or ".]". An unterminated expression
+// returns the end of the pattern, so the rest contributes no trigrams (a superset of the matches).
+size_t NameIndex::bracketEnd(const std::string &pattern, size_t open)
+{
+    size_t i = open + 1;
+    if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^'))
+    {
+        ++i;
+    }
+    if (i < pattern.size() && pattern[i] == ']')
+    {
+        ++i;
+    }
+    while (i < pattern.size() && pattern[i] != ']')
+    {
+        if (pattern[i] == '\\')
+        {
+            i += 2;
+        }
+        else if (pattern[i] == '[' && i + 1 < pattern.size() &&
+                 (pattern[i + 1] == ':' || pattern[i + 1] == '=' || pattern[i + 1] == '.'))
+        {
+            size_t close = pattern.find(std::string{pattern[i + 1], ']'}, i + 2);
+            i = (close == std::string::npos) ? pattern.size() : close + 2;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return std::min(i, pattern.size());
+}
+
+void NameIndex::addPostings(size_t slot)
+{
+    std::vector<uint32_t> trigrams;
+    nameTrigrams(records_[slot].name, trigrams);
+    for (uint32_t trigram : trigrams)
+    {
+        trigrams_[trigram].push_back(slot);
+    }
+    live_postings_ += trigrams.size();
+}
+
+void NameIndex::rebuildPostings()
+{
+    trigrams_.clear();
+    live_postings_ = 0;
+    stale_postings_ = 0;
+    for (size_t slot = 0; slot < records_.size(); ++slot)
+    {
+        if (records_[slot].parent_inode_id != INVALID_INODE_ID)
+        {
+            addPostings(slot);
+        }
+    }
+}
+
+bool NameIndex::entryOf(int inodeId, int &parentInodeId, std::string &name) const
+{
+    auto named = by_inode_.find(inodeId);
+    if (named == by_inode_.end())
+    {
+        return false;
+    }
+    parentInodeId = records_[named->second].parent_inode_id;
+    name = records_[named->second].name;
+    return true;
+}
+
+size_t NameIndex::findRecord(int parentInodeId, const std::string &name) const
+{
+    auto range = by_entry_.equal_range(entryHash(parentInodeId, name));
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const Record &record = records_[it->second];
+        if (record.parent_inode_id == parentInodeId && record.name == name)
+        {
+            return it->second;
+        }
+    }
+    return records_.size();
+}
+
+void NameIndex::insertRecord(size_t slot, int parentInodeId, int inodeId, const std::string &name)
+{
+    Record &record = records_[slot];
+    record.parent_inode_id = parentInodeId;
+    record.inode_id = inodeId;
+    record.name = name;
+    std::vector<size_t> &bucket = by_name_[std::hash<std::string>()(name)];
+    record.name_position = bucket.size();
+    bucket.push_back(slot);
+    by_entry_.emplace(entryHash(parentInodeId, name), slot);
+    by_inode_[inodeId] = slot;
+    addPostings(slot);
+}
+
+void NameIndex::eraseRecord(size_t slot)
+{
+    Record &record = records_[slot];
+    auto bucket = by_name_.find(std::hash<std::string>()(record.name));
+    std::vector<size_t> &slots = bucket->second;
+    size_t moved = slots.back();
+    slots[record.name_position] = moved;
+    records_[moved].name_position = record.name_position;
+    slots.pop_back();
+    if (slots.empty())
+    {
+        by_name_.erase(bucket);
+    }
+    auto range = by_entry_.equal_range(entryHash(record.parent_inode_id, record.name));
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == slot)
+        {
+            by_entry_.erase(it);
+            break;
+        }
+    }
+    auto named = by_inode_.find(record.inode_id);
+    if (named != by_inode_.end() && named->second == slot)
+    {
+        by_inode_.erase(named);
+    }
+    std::vector<uint32_t> trigrams;
+    nameTrigrams(record.name, trigrams);
+    live_postings_ -= trigrams.size();
+    stale_postings_ += trigrams.size();
+    record.parent_inode_id = INVALID_INODE_ID;
+    record.inode_id = INVALID_INODE_ID;
+    record.name.clear();
+    if (stale_postings_ > live_postings_ && stale_postings_ > TRIGRAM_COMPACT_MIN_STALE)
+    {
+        rebuildPostings();
+    }
+}
+
+// The slot is rewritten through the data layer; the block cache merges neighbouring slot writes.
+bool NameIndex::writeSlot(size_t slot)
+{
+    const Record &record = records_[slot];
+    NameIndexSlot onDisk{};
+    onDisk.parent_inode_id = record.parent_inode_id;
+    onDisk.entry.inode_id = record.inode_id;
+    std::strncpy(onDisk.entry.filename, record.name.c_str(), MAX_FILENAME_LENGTH - 1);
+    bool sizeChanged = false;
+    if (db_manager_->writeFileData(index_inode_, static_cast<long long>(slot) * sizeof(NameIndexSlot),
+                                   reinterpret_cast<const char *>(&onDisk), sizeof(NameIndexSlot), sizeChanged) != static_cast<int>(sizeof(NameIndexSlot)))
+    {
+        std::cerr << "Error: Could not update the filename index." << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -1,28 +1,69 @@
 #include <chrono>
+#include <cstring>
 #include <sstream>
+#include <algorithm>
+#include <fnmatch.h>
 #include "filesystem.h"
 
-FileSystem::FileSystem(const std::string &diskFilePath, long long diskSize)
-    : vdisk_(diskFilePath, diskSize),
+// Entries of the orphan directory are named after their inode number; it is never looked up by name.
+static DirectoryEntry orphanEntry(int inodeId)
+{
+    DirectoryEntry entry{};
+    std::strncpy(entry.filename, std::to_string(inodeId).c_str(), MAX_FILENAME_LENGTH - 1);
+    entry.inode_id = inodeId;
+    return entry;
+}
+
+FileSystem::FileSystem(const std::string &diskFilePath, long long diskSize, int maxSystemOpenFiles, int maxOpenFilesPerProcess,
+                       bool directIo, int blockSize, DiskLayout layout)
+    : vdisk_(diskFilePath, diskSize, directIo),
       sb_manager_(&vdisk_),
       inode_manager_(&vdisk_, &sb_manager_),
       db_manager_(&vdisk_, &inode_manager_, &sb_manager_),
       dir_manager_(&db_manager_, &inode_manager_, &sb_manager_),
       file_manager_(&db_manager_, &inode_manager_, &sb_manager_, &dir_manager_),
+      name_index_(&db_manager_, &inode_manager_),
       user_manager_(),
       current_dir_inode_id_(INVALID_INODE_ID),
-      root_dir_inode_id_(ROOT_DIRECTORY_INODE_ID)
+      root_dir_inode_id_(ROOT_DIRECTORY_INODE_ID),
+      orphan_dir_inode_id_(ORPHAN_DIRECTORY_INODE_ID),
+      max_open_files_per_process_(maxOpenFilesPerProcess),
+      format_block_size_(blockSize),
+      format_layout_(layout),
+      mounted_(false),
+      stop_reclaimer_(false),
+      reclaim_pending_(false),
+      reclaim_deferred_(0),
+      write_buffer_started_(false)
 {
+    system_open_file_table_.max_entries = maxSystemOpenFiles;
+    dir_manager_.setNameIndex(&name_index_);
 }
 
 FileSystem::~FileSystem()
 {
-
-    sb_manager_.saveSuperBlock();
+    // Orphans the reclaimer has not reached yet stay in the orphan directory for the next mount
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        stop_reclaimer_ = true;
+    }
+    reclaim_cv_.notify_one();
+    if (reclaimer_.joinable())
+    {
+        reclaimer_.join();
+    }
+    batch_.reset(); // an unfinished batch is committed like any other transaction
+    // Files still open at shutdown may hold buffered writes; the cache is written back here too.
+    // Only a volume that was mounted and fully written back is recorded as cleanly unmounted.
+    if (sync() && mounted_)
+    {
+        sb_manager_.setVolumeState(VolumeState::CLEAN);
+    }
 }
 
 bool FileSystem::mount()
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     if (!vdisk_.exists())
     {
         std::cout << "Virtual disk file not found. Attempting to create and format..." << std::endl;
@@ -72,8 +113,33 @@ bool FileSystem::mount()
 
         return false;
     }
+    // Block-geometry math in the inode manager is specialised per block size; pick the one this disk uses
+    if (!inode_manager_.selectGeometry(sb.block_size))
+    {
+        std::cerr << "Unsupported block size " << sb.block_size << "." << std::endl;
+        return false;
+    }
+
+    // A clean volume's counters are trusted as-is; after an unclean shutdown they are rebuilt from the
+    // inode bitmap and the free-block stack before anything is allocated
+    bool uncleanShutdown = sb.state != VolumeState::CLEAN;
+    if (uncleanShutdown)
+    {
+        std::cout << "Volume was not unmounted cleanly; recovering free counts..." << std::endl;
+        if (!sb_manager_.recoverFreeCounts())
+        {
+            std::cerr << "Recovery failed; the free-block stack or inode bitmap is corrupted." << std::endl;
+            return false;
+        }
+    }
+    if (!sb_manager_.setVolumeState(VolumeState::DIRTY))
+    {
+        return false;
+    }
+    mounted_ = true;
 
     root_dir_inode_id_ = sb.root_dir_inode_idx;
+    orphan_dir_inode_id_ = sb.orphan_dir_inode_idx;
     current_dir_inode_id_ = root_dir_inode_id_;
 
     if (!user_manager_.initializeUsers())
@@ -81,13 +147,35 @@ bool FileSystem::mount()
         std::cerr << "Failed to initialize user system." << std::endl;
     }
 
+    // Index slots are file data and skip the journal, so after a crash the index is rebuilt from the tree
+    if (sb.name_index_inode_idx != INVALID_INODE_ID)
+    {
+        if (uncleanShutdown || !name_index_.load(sb.name_index_inode_idx))
+        {
+            std::cout << "Rebuilding the filename index..." << std::endl;
+            if (!fillNameIndex(sb.name_index_inode_idx))
+            {
+                std::cerr << "Warning: Could not rebuild the filename index; find walks the tree instead." << std::endl;
+            }
+        }
+    }
+
+    // A previous session may have left unlinked inodes behind; the reclaimer picks them up again
+    Inode orphanDirInode;
+    reclaim_pending_ = inode_manager_.readInode(orphan_dir_inode_id_, orphanDirInode) && orphanDirInode.file_size > 0;
+    if (!reclaimer_.joinable())
+    {
+        reclaimer_ = std::thread(&FileSystem::reclaimerLoop, this);
+    }
+
     std::cout << "File system mounted successfully." << std::endl;
     return true;
 }
 
 bool FileSystem::format()
 {
-    if (!sb_manager_.formatFileSystem(DEFAULT_TOTAL_INODES, DEFAULT_BLOCK_SIZE))
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (!sb_manager_.formatFileSystem(DEFAULT_INITIAL_INODES, format_block_size_, format_layout_))
     {
         std::cerr << "Filesystem formatting failed." << std::endl;
         return false;
@@ -99,8 +187,16 @@ bool FileSystem::format()
         return false;
     }
     const SuperBlock &sb = sb_manager_.getSuperBlockInfo();
+    if (!inode_manager_.selectGeometry(sb.block_size))
+    {
+        std::cerr << "Unsupported block size " << sb.block_size << "." << std::endl;
+        return false;
+    }
     root_dir_inode_id_ = sb.root_dir_inode_idx;
+    orphan_dir_inode_id_ = sb.orphan_dir_inode_idx;
     current_dir_inode_id_ = root_dir_inode_id_;
+    reclaim_deferred_ = 0;
+    name_index_.disable();
 
     Inode root_inode;
     root_inode.inode_id = root_dir_inode_id_;
@@ -117,6 +213,7 @@ bool FileSystem::format()
         root_inode.direct_blocks[i] = INVALID_BLOCK_ID;
     root_inode.single_indirect_block = INVALID_BLOCK_ID;
     root_inode.double_indirect_block = INVALID_BLOCK_ID;
+    root_inode.triple_indirect_block = INVALID_BLOCK_ID;
 
     if (!inode_manager_.writeInode(root_dir_inode_id_, root_inode))
     {
@@ -142,6 +239,22 @@ bool FileSystem::format()
         return false;
     }
 
+    // The orphan directory is not linked anywhere and has no "." or ".." entries
+    Inode orphan_inode = root_inode;
+    orphan_inode.inode_id = orphan_dir_inode_id_;
+    orphan_inode.link_count = 1;
+    orphan_inode.file_size = 0;
+    for (int i = 0; i < NUM_DIRECT_BLOCKS; ++i)
+        orphan_inode.direct_blocks[i] = INVALID_BLOCK_ID;
+    orphan_inode.single_indirect_block = INVALID_BLOCK_ID;
+    orphan_inode.double_indirect_block = INVALID_BLOCK_ID;
+    orphan_inode.triple_indirect_block = INVALID_BLOCK_ID;
+    if (!inode_manager_.writeInode(orphan_dir_inode_id_, orphan_inode))
+    {
+        std::cerr << "Failed to write orphan directory inode." << std::endl;
+        return false;
+    }
+
     if (!user_manager_.initializeUsers())
     {
         std::cerr << "Failed to initialize users during format." << std::endl;
@@ -160,6 +273,7 @@ bool FileSystem::format()
 
 bool FileSystem::loginUser(const std::string &username, const std::string &password)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     User *user = user_manager_.login(username, password);
     if (user)
     {
@@ -181,11 +295,14 @@ bool FileSystem::loginUser(const std::string &username, const std::string &passw
 
 void FileSystem::logoutUser()
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     user_manager_.logout();
 }
 
 bool FileSystem::mkdir(const std::string &path)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_); // every metadata block this operation writes commits to the journal together
     User *currentUser = user_manager_.getCurrentUser();
     if (!currentUser)
     {
@@ -279,6 +396,7 @@ bool FileSystem::mkdir(const std::string &path)
 
 bool FileSystem::chdir(const std::string &path)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     User *currentUser = user_manager_.getCurrentUser();
     if (!currentUser)
     {
@@ -319,6 +437,7 @@ bool FileSystem::chdir(const std::string &path)
 
 std::string FileSystem::dir(const std::string &path)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     User *currentUser = user_manager_.getCurrentUser();
     if (!currentUser)
     {
@@ -351,16 +470,17 @@ std::string FileSystem::dir(const std::string &path)
         return "Error: Permission denied to read directory '" + path + "'.\n";
     }
 
-    std::vector<DirectoryEntry> entries = dir_manager_.listEntries(dirInode);
     std::ostringstream oss;
     oss << "Contents of directory '" << path << "':\n";
     oss << "Type  Perms Link  UID   Size      Name\n";
     oss << "--------------------------------------------\n";
 
-    for (const auto &entry : entries)
+    DirectoryIterator it = dir_manager_.openDirectory(dirInode);
+    const DirectoryEntry *entry = nullptr;
+    while (it.next(entry))
     {
         Inode entryInode;
-        if (inode_manager_.readInode(entry.inode_id, entryInode))
+        if (inode_manager_.readInode(entry->inode_id, entryInode))
         {
             oss << (entryInode.file_type == FileType::DIRECTORY ? "d" : "f") << "     ";
 
@@ -376,25 +496,60 @@ std::string FileSystem::dir(const std::string &path)
             oss << std::left << entryInode.owner_uid << " ";
             oss.width(8);
             oss << std::right << entryInode.file_size << "  ";
-            oss << entry.filename << "\n";
+            oss << entry->filename << "\n";
         }
     }
     return oss.str();
 }
 
+bool FileSystem::readdir(const std::string &path, long long &cookie, int maxEntries, std::vector<std::string> &names)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    User *currentUser = user_manager_.getCurrentUser();
+    if (!currentUser)
+    {
+        std::cerr << "Error: No user logged in." << std::endl;
+        return false;
+    }
+
+    int dirInodeId = dir_manager_.resolvePathToInode(path, current_dir_inode_id_, root_dir_inode_id_, currentUser);
+    Inode dirInode;
+    if (dirInodeId == INVALID_INODE_ID || !inode_manager_.readInode(dirInodeId, dirInode) || dirInode.file_type != FileType::DIRECTORY)
+    {
+        std::cerr << "Error: '" << path << "' is not a directory." << std::endl;
+        return false;
+    }
+    if (!user_manager_.checkAccessPermission(dirInode, PermissionAction::ACTION_READ))
+    {
+        std::cerr << "Error: Permission denied to read directory '" << path << "'." << std::endl;
+        return false;
+    }
+
+    // Resume where the previous page stopped; cookie is left pointing after the last returned entry.
+    DirectoryIterator it = dir_manager_.openDirectory(dirInode, cookie);
+    const DirectoryEntry *entry = nullptr;
+    int returned = 0;
+    while (returned < maxEntries && it.next(entry))
+    {
+        names.push_back(entry->filename);
+        ++returned;
+    }
+    cookie = it.cookie();
+    return !it.failed();
+}
+
 int FileSystem::getFreeFd()
 {
-    for (int i = 0; i < process_open_file_table_.size(); ++i)
+    if (!free_fds_.empty())
     {
-        if (process_open_file_table_[i].system_table_idx == INVALID_FD)
-        {
-            return i;
-        }
+        int fd = free_fds_.top();
+        free_fds_.pop();
+        return fd;
     }
 
-    if (process_open_file_table_.size() < MAX_OPEN_FILES_PER_PROCESS)
+    if (process_open_file_table_.size() < static_cast<size_t>(max_open_files_per_process_))
     {
-        process_open_file_table_.push_back({INVALID_FD, 0});
+        process_open_file_table_.push_back({INVALID_FD, 0, ReadaheadState()});
         return process_open_file_table_.size() - 1;
     }
     return INVALID_FD;
@@ -406,6 +561,8 @@ void FileSystem::releaseFd(int fd)
     {
         process_open_file_table_[fd].system_table_idx = INVALID_FD;
         process_open_file_table_[fd].current_offset = 0;
+        process_open_file_table_[fd].readahead = ReadaheadState();
+        free_fds_.push(fd);
     }
 }
 
@@ -442,15 +599,16 @@ std::string FileSystem::getPathFromInodeId(int targetInodeId) const
             return "/<corrupted_parent_inode>";
         }
 
-        std::vector<DirectoryEntry> parent_entries = dir_manager_.listEntries(parent_inode);
         std::string found_name = "";
-        for (const auto &entry : parent_entries)
+        DirectoryIterator it = dir_manager_.openDirectory(parent_inode);
+        const DirectoryEntry *entry = nullptr;
+        while (it.next(entry))
         {
-            if (entry.inode_id == current_inode_id)
+            if (entry->inode_id == current_inode_id)
             {
-                found_name = entry.filename;
                 // Avoid ".." and "." entries themselves if they are the target
-                if (found_name == "." || found_name == "..") continue; 
+                if (std::strcmp(entry->filename, ".") == 0 || std::strcmp(entry->filename, "..") == 0) continue;
+                found_name = entry->filename;
                 break;
             }
         }
@@ -485,6 +643,8 @@ std::string FileSystem::getPathFromInodeId(int targetInodeId) const
 
 int FileSystem::open(const std::string &path, OpenMode mode)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
     User *currentUser = user_manager_.getCurrentUser();
     if (!currentUser)
     {
@@ -618,6 +778,8 @@ int FileSystem::open(const std::string &path, OpenMode mode)
 
 bool FileSystem::close(int fd)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
     if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
     {
         std::cerr << "Error: Invalid file descriptor " << fd << "." << std::endl;
@@ -627,6 +789,12 @@ bool FileSystem::close(int fd)
     if (file_manager_.closeFile(fd, process_open_file_table_, system_open_file_table_))
     {
         releaseFd(fd);
+        if (reclaim_deferred_ > 0)
+        {
+            // The last close of a removed file lets the reclaimer free it
+            reclaim_pending_ = true;
+            reclaim_cv_.notify_one();
+        }
         return true;
     }
     std::cerr << "Error: Failed to close file with fd " << fd << "." << std::endl;
@@ -635,6 +803,8 @@ bool FileSystem::close(int fd)
 
 int FileSystem::read(int fd, char *buffer, int length)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
     if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
     {
         std::cerr << "Error: Invalid file descriptor " << fd << " for read." << std::endl;
@@ -648,7 +818,7 @@ int FileSystem::read(int fd, char *buffer, int length)
         process_open_file_table_[fd].current_offset += bytes_read;
 
         int sys_idx = process_open_file_table_[fd].system_table_idx;
-        SystemOpenFileEntry &sys_entry = system_open_file_table_[sys_idx];
+        SystemOpenFileEntry &sys_entry = system_open_file_table_.entries[sys_idx];
         auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
         sys_entry.inode_cache.access_time = now;
         inode_manager_.writeInode(sys_entry.inode_id, sys_entry.inode_cache);
@@ -658,20 +828,81 @@ int FileSystem::read(int fd, char *buffer, int length)
 
 int FileSystem::write(int fd, const char *buffer, int length)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
     if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
     {
         std::cerr << "Error: Invalid file descriptor " << fd << " for write." << std::endl;
         return -1;
     }
 
+    // Small writes may only land in the file's write buffer; size, timestamps and the inode
+    // are written back by the data layer when the buffer is flushed.
+    int systemIdx = process_open_file_table_[fd].system_table_idx;
+    bool wasBuffered = !system_open_file_table_.entries[systemIdx].write_buffer.data.empty();
     int bytes_written = file_manager_.writeFile(fd, buffer, length, process_open_file_table_, system_open_file_table_);
+    if (!wasBuffered && !system_open_file_table_.entries[systemIdx].write_buffer.data.empty())
+    {
+        write_buffer_started_ = true; // the reclaimer flushes it if the writer goes idle
+        reclaim_cv_.notify_one();
+    }
 
     if (bytes_written > 0)
     {
         process_open_file_table_[fd].current_offset += bytes_written;
+    }
+    return bytes_written;
+}
+
+int FileSystem::pread(int fd, char *buffer, int length, long long offset)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
+    if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
+    {
+        std::cerr << "Error: Invalid file descriptor " << fd << " for pread." << std::endl;
+        return -1;
+    }
+    if (offset < 0)
+    {
+        std::cerr << "Error: Invalid offset " << offset << " for pread." << std::endl;
+        return -1;
+    }
+
+    int bytes_read = file_manager_.readFileAt(fd, buffer, length, offset, process_open_file_table_, system_open_file_table_);
+
+    if (bytes_read > 0)
+    {
+        int sys_idx = process_open_file_table_[fd].system_table_idx;
+        SystemOpenFileEntry &sys_entry = system_open_file_table_.entries[sys_idx];
+        auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        sys_entry.inode_cache.access_time = now;
+        inode_manager_.writeInode(sys_entry.inode_id, sys_entry.inode_cache);
+    }
+    return bytes_read;
+}
+
+int FileSystem::pwrite(int fd, const char *buffer, int length, long long offset)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
+    if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
+    {
+        std::cerr << "Error: Invalid file descriptor " << fd << " for pwrite." << std::endl;
+        return -1;
+    }
+    if (offset < 0)
+    {
+        std::cerr << "Error: Invalid offset " << offset << " for pwrite." << std::endl;
+        return -1;
+    }
 
+    int bytes_written = file_manager_.writeFileAt(fd, buffer, length, offset, process_open_file_table_, system_open_file_table_);
+
+    if (bytes_written > 0)
+    {
         int sys_idx = process_open_file_table_[fd].system_table_idx;
-        SystemOpenFileEntry &sys_entry = system_open_file_table_[sys_idx];
+        SystemOpenFileEntry &sys_entry = system_open_file_table_.entries[sys_idx];
         auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
         sys_entry.inode_cache.modification_time = now;
         sys_entry.inode_cache.access_time = now;
@@ -681,43 +912,1135 @@ int FileSystem::write(int fd, const char *buffer, int length)
     return bytes_written;
 }
 
-bool FileSystem::rm(const std::string &path, bool recursive, bool force)
+int FileSystem::readv(int fd, const IoVec *iov, int iovcnt)
 {
-    return false;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
+    if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
+    {
+        std::cerr << "Error: Invalid file descriptor " << fd << " for readv." << std::endl;
+        return -1;
+    }
+
+    // One logical read: the data layer walks the block map once and writes the access time back once.
+    ProcessOpenFileEntry &proc_entry = process_open_file_table_[fd];
+    int bytes_read = file_manager_.readFileVecAt(fd, iov, iovcnt, proc_entry.current_offset, process_open_file_table_, system_open_file_table_);
+    if (bytes_read > 0)
+    {
+        proc_entry.current_offset += bytes_read;
+    }
+    return bytes_read;
 }
 
-bool FileSystem::cp(const std::string &sourcePath, const std::string &destPath, bool recursive)
+int FileSystem::writev(int fd, const IoVec *iov, int iovcnt)
 {
-    return false;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
+    if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
+    {
+        std::cerr << "Error: Invalid file descriptor " << fd << " for writev." << std::endl;
+        return -1;
+    }
+
+    // One logical write: blocks shared by several iovecs are read-modified-written once,
+    // and the inode (size and timestamps) is written back once by the data layer.
+    ProcessOpenFileEntry &proc_entry = process_open_file_table_[fd];
+    SystemOpenFileEntry &sys_entry = system_open_file_table_.entries[proc_entry.system_table_idx];
+    if (!file_manager_.flushWriteBuffer(sys_entry)) // EOF for append must include buffered data
+    {
+        return -1;
+    }
+    long long offset = (sys_entry.mode == OpenMode::MODE_APPEND) ? sys_entry.inode_cache.file_size : proc_entry.current_offset;
+    int bytes_written = file_manager_.writeFileVecAt(fd, iov, iovcnt, offset, process_open_file_table_, system_open_file_table_);
+    if (bytes_written > 0)
+    {
+        proc_entry.current_offset = offset + bytes_written;
+    }
+    return bytes_written;
 }
 
-bool FileSystem::mv(const std::string &sourcePath, const std::string &destPath)
+long long FileSystem::lseek(int fd, long long offset, int whence)
 {
-    return false;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
+    {
+        std::cerr << "Error: Invalid file descriptor " << fd << " for lseek." << std::endl;
+        return -1;
+    }
+
+    ProcessOpenFileEntry &proc_entry = process_open_file_table_[fd];
+    SystemOpenFileEntry &sys_entry = system_open_file_table_.entries[proc_entry.system_table_idx];
+    long long base;
+    switch (whence)
+    {
+    case SEEK_SET:
+        base = 0;
+        break;
+    case SEEK_CUR:
+        base = proc_entry.current_offset;
+        break;
+    case SEEK_END:
+        if (!file_manager_.flushWriteBuffer(sys_entry)) // file_size must include buffered data
+        {
+            return -1;
+        }
+        base = sys_entry.inode_cache.file_size;
+        break;
+    default:
+        std::cerr << "Error: Invalid whence " << whence << " for lseek." << std::endl;
+        return -1;
+    }
+
+    // Seeking past EOF is allowed; a later write leaves a hole that reads back as zeros.
+    long long new_offset = base + offset;
+    if (new_offset < 0)
+    {
+        std::cerr << "Error: lseek would move fd " << fd << " to negative offset " << new_offset << "." << std::endl;
+        return -1;
+    }
+    proc_entry.current_offset = new_offset;
+    return new_offset;
 }
 
-bool FileSystem::ln(const std::string &targetPath, const std::string &linkPath)
+bool FileSystem::fsync(int fd)
 {
-    return false;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (fd < 0 || fd >= process_open_file_table_.size() || process_open_file_table_[fd].system_table_idx == INVALID_FD)
+    {
+        std::cerr << "Error: Invalid file descriptor " << fd << " for fsync." << std::endl;
+        return false;
+    }
+    // The block cache does not track which blocks belong to which file, so the data reaches
+    // the disk through a full cache write-back; the sync also commits the journal.
+    {
+        JournalTransaction transaction(vdisk_);
+        if (!file_manager_.syncFile(fd, process_open_file_table_, system_open_file_table_))
+        {
+            return false;
+        }
+    }
+    return vdisk_.sync();
 }
 
-bool FileSystem::chmod(const std::string &path, short mode)
+bool FileSystem::sync()
 {
-    return false;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    bool ok = true;
+    {
+        JournalTransaction transaction(vdisk_);
+        for (SystemOpenFileEntry &sys_entry : system_open_file_table_.entries)
+        {
+            if (sys_entry.inode_id != INVALID_INODE_ID && !file_manager_.flushWriteBuffer(sys_entry))
+            {
+                ok = false;
+            }
+        }
+        if (!sb_manager_.saveSuperBlock())
+        {
+            ok = false;
+        }
+    }
+    return vdisk_.sync() && ok;
 }
 
-bool FileSystem::chown(const std::string &path, const std::string &newOwnerUsername)
+// Holding one transaction open across many operations keeps their metadata blocks pinned in the
+// block cache: a block touched by a thousand creates is written back once, and a batch reaches the
+// journal in as few commits as possible. Once the pinned blocks reach the journal's commit threshold,
+// what has accumulated is committed between two operations, so a bulk load of any size becomes a
+// sequence of consistent commits rather than one transaction too large for the journal. Without a
+// journal (very small disks) operations in a batch behave as they do outside one.
+bool FileSystem::beginBatch()
 {
-    return false;
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (batch_)
+    {
+        std::cerr << "Error: A batch is already open." << std::endl;
+        return false;
+    }
+    batch_.reset(new JournalTransaction(vdisk_));
+    return true;
 }
 
-std::vector<std::string> FileSystem::find(const std::string &startPath, const std::string &filename)
+bool FileSystem::commitBatch()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (!batch_)
+    {
+        std::cerr << "Error: No batch is open." << std::endl;
+        return false;
+    }
+    batch_.reset();
+    return vdisk_.commitJournal(); // false if any part of the batch missed the journal
+}
+
+// rm only unlinks: in one journal transaction the entry leaves its parent and the inode is moved
+// into the orphan directory, which the reclaimer thread drains in the background. Removing a large
+// tree therefore costs the same as removing an empty file, and an open file keeps working through
+// its descriptors until it is closed. The orphan directory is on disk, so a crash or unmount before
+// the reclaimer finishes only delays the freeing until the next mount.
+bool FileSystem::rm(const std::string &path, bool recursive, bool force)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
+    User *currentUser = user_manager_.getCurrentUser();
+    if (!currentUser)
+    {
+        std::cerr << "Error: No user logged in. Cannot remove." << std::endl;
+        return false;
+    }
+
+    int parentInodeId = INVALID_INODE_ID;
+    std::string name;
+    int targetInodeId = dir_manager_.resolvePathToInode(path, current_dir_inode_id_, root_dir_inode_id_, currentUser, &parentInodeId, &name, false);
+    if (targetInodeId == INVALID_INODE_ID)
+    {
+        if (force)
+        {
+            return true;
+        }
+        std::cerr << "Error: '" << path << "' not found." << std::endl;
+        return false;
+    }
+    if (targetInodeId == root_dir_inode_id_ || parentInodeId == INVALID_INODE_ID || name.empty() || name == "." || name == "..")
+    {
+        std::cerr << "Error: Cannot remove '" << path << "'." << std::endl;
+        return false;
+    }
+
+    Inode targetInode;
+    Inode parentDirInode;
+    if (!inode_manager_.readInode(targetInodeId, targetInode) || !inode_manager_.readInode(parentInodeId, parentDirInode))
+    {
+        std::cerr << "Error: Could not read inode for '" << path << "'." << std::endl;
+        return false;
+    }
+    bool isDirectory = targetInode.file_type == FileType::DIRECTORY;
+    if (isDirectory && !recursive)
+    {
+        std::cerr << "Error: '" << path << "' is a directory (use -r)." << std::endl;
+        return false;
+    }
+    if (isDirectory && isInTree(targetInodeId, current_dir_inode_id_))
+    {
+        std::cerr << "Error: Cannot remove '" << path << "': the current directory is inside it." << std::endl;
+        return false;
+    }
+    if (!user_manager_.checkAccessPermission(parentDirInode, PermissionAction::ACTION_WRITE))
+    {
+        std::cerr << "Error: Permission denied to remove '" << path << "'." << std::endl;
+        return false;
+    }
+
+    if (!dir_manager_.removeEntry(parentDirInode, name))
+    {
+        return false;
+    }
+    if (isDirectory)
+    {
+        parentDirInode.link_count--; // the ".." entry of the removed directory
+        inode_manager_.writeInode(parentInodeId, parentDirInode);
+    }
+    else if (!dropLink(targetInode))
+    {
+        return true; // still reachable through another link
+    }
+    return queueOrphans({orphanEntry(targetInodeId)});
+}
+
+// Removes one link to a file; the on-disk inode and the copy held by an open file agree afterwards.
+bool FileSystem::dropLink(Inode &inode)
+{
+    if (inode.link_count > 0)
+    {
+        inode.link_count--;
+    }
+    auto opened = system_open_file_table_.inode_index.find(inode.inode_id);
+    if (opened != system_open_file_table_.inode_index.end())
+    {
+        system_open_file_table_.entries[opened->second].inode_cache.link_count = inode.link_count;
+    }
+    inode_manager_.writeInode(inode.inode_id, inode);
+    return inode.link_count == 0;
+}
+
+bool FileSystem::queueOrphans(const std::vector<DirectoryEntry> &entries)
+{
+    Inode orphanDirInode;
+    if (!inode_manager_.readInode(orphan_dir_inode_id_, orphanDirInode) || !dir_manager_.appendEntries(orphanDirInode, entries))
+    {
+        std::cerr << "Error: Could not record removed inodes in the orphan directory." << std::endl;
+        return false;
+    }
+    reclaim_pending_ = true;
+    reclaim_cv_.notify_one();
+    return true;
+}
+
+// Runs one slice at a time and lets waiting operations in between, so a huge delete delays a
+// shell command by at most one slice.
+void FileSystem::reclaimerLoop()
+{
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+    while (true)
+    {
+        auto bufferDue = flushAgedWriteBuffers();
+        auto wake = [this]
+        { return stop_reclaimer_ || reclaim_pending_ || write_buffer_started_; };
+        if (bufferDue == std::chrono::steady_clock::time_point::max())
+        {
+            reclaim_cv_.wait(lock, wake);
+        }
+        else
+        {
+            reclaim_cv_.wait_until(lock, bufferDue, wake);
+        }
+        if (stop_reclaimer_)
+        {
+            break;
+        }
+        if (reclaim_pending_ && !reclaimSlice())
+        {
+            reclaim_pending_ = false;
+        }
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+    }
+}
+
+// The age limit of a write buffer is otherwise only checked by the next write, so a writer that goes
+// idle would keep its data out of the block cache (and away from the flusher) until close or fsync.
+// Buffers past WRITE_BUFFER_MAX_AGE_MS are written out in one transaction; a buffer that fails to
+// flush is retried one age period later.
+std::chrono::steady_clock::time_point FileSystem::flushAgedWriteBuffers()
 {
-    return std::vector<std::string>();
+    write_buffer_started_ = false;
+    auto now = std::chrono::steady_clock::now();
+    const auto maxAge = std::chrono::milliseconds(WRITE_BUFFER_MAX_AGE_MS);
+    auto nextDue = std::chrono::steady_clock::time_point::max();
+    std::unique_ptr<JournalTransaction> transaction; // opened only when something is due
+    for (SystemOpenFileEntry &sys_entry : system_open_file_table_.entries)
+    {
+        WriteBuffer &wb = sys_entry.write_buffer;
+        if (sys_entry.inode_id == INVALID_INODE_ID || wb.data.empty())
+        {
+            continue;
+        }
+        if (now - wb.first_write_time < maxAge)
+        {
+            nextDue = std::min(nextDue, wb.first_write_time + maxAge);
+            continue;
+        }
+        if (!transaction)
+        {
+            transaction.reset(new JournalTransaction(vdisk_));
+        }
+        if (!file_manager_.flushWriteBuffer(sys_entry))
+        {
+            nextDue = std::min(nextDue, now + maxAge);
+        }
+    }
+    return nextDue;
+}
+
+// One reclaimer step in its own journal transaction. Entries are taken from the end of the orphan
+// directory, so it works as a stack: a directory that still has children is put back above the
+// subdirectories it gave up and keeps being drained first, which bounds the orphan directory by the
+// depth of the tree rather than its size. Closed files and emptied directories are freed, and the
+// blocks of the whole slice go to one freeBlocks call (sorted, each free-list group written once).
+// Open files are put back and reclaimed after their last close.
+bool FileSystem::reclaimSlice()
+{
+    JournalTransaction transaction(vdisk_);
+    Inode orphanDirInode;
+    if (!inode_manager_.readInode(orphan_dir_inode_id_, orphanDirInode))
+    {
+        return false;
+    }
+    std::vector<DirectoryEntry> taken;
+    dir_manager_.takeEntries(orphanDirInode, RECLAIM_SLICE_INODES + reclaim_deferred_, taken);
+
+    int budget = RECLAIM_SLICE_INODES;
+    bool progress = false;
+    int deferred = 0;
+    std::vector<std::vector<DirectoryEntry>> putBack(taken.size()); // what goes back in place of each taken entry
+    std::vector<BlockId> blockIds;
+    auto reclaim = [&](Inode &inode)
+    {
+        db_manager_.releaseInodeDataBlocks(inode, blockIds);
+        sb_manager_.freeInode(inode.inode_id);
+        progress = true;
+    };
+    auto isOpen = [this](int inodeId)
+    {
+        return system_open_file_table_.inode_index.count(inodeId) != 0;
+    };
+
+    for (size_t i = 0; i < taken.size(); ++i)
+    {
+        const DirectoryEntry &entry = taken[i];
+        Inode inode;
+        if (budget <= 0 || !inode_manager_.readInode(entry.inode_id, inode))
+        {
+            putBack[i].push_back(entry);
+            continue;
+        }
+        if (inode.file_type != FileType::DIRECTORY)
+        {
+            if (isOpen(entry.inode_id))
+            {
+                putBack[i].push_back(entry);
+                deferred++;
+            }
+            else
+            {
+                reclaim(inode);
+                budget--;
+            }
+            continue;
+        }
+
+        std::vector<DirectoryEntry> children;
+        budget -= dir_manager_.takeEntries(inode, budget, children);
+        std::vector<int> ids;
+        for (const DirectoryEntry &child : children)
+        {
+            ids.push_back(child.inode_id);
+        }
+        inode_manager_.prefetchInodes(ids);
+        for (const DirectoryEntry &child : children)
+        {
+            Inode childInode;
+            progress = true;
+            if (!inode_manager_.readInode(child.inode_id, childInode))
+            {
+                std::cerr << "Error: Could not read orphaned inode " << child.inode_id << "." << std::endl;
+            }
+            else if (childInode.file_type == FileType::DIRECTORY)
+            {
+                putBack[i].push_back(orphanEntry(child.inode_id));
+            }
+            else if (dropLink(childInode))
+            {
+                if (isOpen(child.inode_id))
+                {
+                    putBack[i].push_back(orphanEntry(child.inode_id));
+                    deferred++;
+                }
+                else
+                {
+                    reclaim(childInode);
+                }
+            }
+        }
+        if (inode.file_size > 2 * static_cast<long long>(sizeof(DirectoryEntry)))
+        {
+            putBack[i].push_back(entry); // on top of the subdirectories it gave up
+        }
+        else
+        {
+            reclaim(inode);
+            budget--;
+        }
+    }
+
+    sb_manager_.freeBlocks(std::move(blockIds));
+    // taken[0] was the top entry, so the groups go back in reverse
+    std::vector<DirectoryEntry> requeue;
+    for (auto group = putBack.rbegin(); group != putBack.rend(); ++group)
+    {
+        requeue.insert(requeue.end(), group->begin(), group->end());
+    }
+    if (!dir_manager_.appendEntries(orphanDirInode, requeue))
+    {
+        std::cerr << "Error: Could not put orphaned inodes back; they are leaked." << std::endl;
+    }
+    reclaim_deferred_ = deferred;
+    return progress;
+}
+
+// Copies are reflinks: the new file shares the source's data blocks and a later write to either
+// file copies only the blocks it touches. Copying therefore costs the same for any file size.
+// With recursive set a directory source is copied by copyTree.
+bool FileSystem::cp(const std::string &sourcePath, const std::string &destPath, bool recursive)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    User *currentUser = user_manager_.getCurrentUser();
+    if (!currentUser)
+    {
+        std::cerr << "Error: No user logged in. Cannot copy." << std::endl;
+        return false;
+    }
+
+    std::string sourceName;
+    int sourceInodeId = dir_manager_.resolvePathToInode(sourcePath, current_dir_inode_id_, root_dir_inode_id_, currentUser, nullptr, &sourceName);
+    if (sourceInodeId == INVALID_INODE_ID)
+    {
+        std::cerr << "Error: Source '" << sourcePath << "' not found." << std::endl;
+        return false;
+    }
+    Inode sourceInode;
+    if (!inode_manager_.readInode(sourceInodeId, sourceInode))
+    {
+        std::cerr << "Error: Could not read inode for '" << sourcePath << "'." << std::endl;
+        return false;
+    }
+    bool isDirectory = sourceInode.file_type == FileType::DIRECTORY;
+    if (isDirectory && !recursive)
+    {
+        std::cerr << "Error: '" << sourcePath << "' is a directory (use -r)." << std::endl;
+        return false;
+    }
+
+    // An existing directory receives the copy under the source's name
+    int parentInodeId = INVALID_INODE_ID;
+    std::string destName;
+    int destInodeId = dir_manager_.resolvePathToInode(destPath, current_dir_inode_id_, root_dir_inode_id_, currentUser, &parentInodeId, &destName);
+    if (destInodeId != INVALID_INODE_ID)
+    {
+        Inode destInode;
+        if (!inode_manager_.readInode(destInodeId, destInode) || destInode.file_type != FileType::DIRECTORY)
+        {
+            std::cerr << "Error: Destination '" << destPath << "' already exists." << std::endl;
+            return false;
+        }
+        parentInodeId = destInodeId;
+        destName = sourceName;
+    }
+    if (parentInodeId == INVALID_INODE_ID || destName.empty())
+    {
+        std::cerr << "Error: Invalid path or cannot determine parent directory for '" << destPath << "'." << std::endl;
+        return false;
+    }
+    if (destName.length() >= MAX_FILENAME_LENGTH)
+    {
+        std::cerr << "Error: Filename '" << destName << "' is too long." << std::endl;
+        return false;
+    }
+    if (isDirectory && isInTree(sourceInodeId, parentInodeId))
+    {
+        std::cerr << "Error: Cannot copy directory '" << sourcePath << "' into itself." << std::endl;
+        return false;
+    }
+
+    Inode parentDirInode;
+    if (!inode_manager_.readInode(parentInodeId, parentDirInode))
+    {
+        std::cerr << "Error: Could not read parent directory inode." << std::endl;
+        return false;
+    }
+    if (dir_manager_.findEntry(parentDirInode, destName) != INVALID_INODE_ID)
+    {
+        std::cerr << "Error: Destination '" << destName << "' already exists." << std::endl;
+        return false;
+    }
+    if (!user_manager_.checkAccessPermission(sourceInode, PermissionAction::ACTION_READ))
+    {
+        std::cerr << "Error: Permission denied to read '" << sourcePath << "'." << std::endl;
+        return false;
+    }
+    if (!user_manager_.checkAccessPermission(parentDirInode, PermissionAction::ACTION_WRITE))
+    {
+        std::cerr << "Error: Permission denied to write in destination directory." << std::endl;
+        return false;
+    }
+
+    int newInodeId;
+    {
+        JournalTransaction transaction(vdisk_);
+        newInodeId = isDirectory ? makeEmptyDirectory(parentInodeId, sourceInode.permissions) : cloneFileInode(sourceInodeId);
+        if (newInodeId == INVALID_INODE_ID)
+        {
+            return false;
+        }
+        if (!dir_manager_.addEntry(parentDirInode, destName, newInodeId, sourceInode.file_type))
+        {
+            std::cerr << "Error: Failed to add entry to parent directory." << std::endl;
+            Inode newInode;
+            if (inode_manager_.readInode(newInodeId, newInode))
+            {
+                db_manager_.clearInodeDataBlocks(newInode);
+            }
+            sb_manager_.freeInode(newInodeId);
+            return false;
+        }
+        if (isDirectory)
+        {
+            parentDirInode.link_count++;
+            inode_manager_.writeInode(parentInodeId, parentDirInode);
+        }
+    }
+    return !isDirectory || copyTree(sourceInodeId, newInodeId);
+}
+
+// Creates a file inode that shares every data block of sourceInodeId; the caller links it.
+// An open source has its buffered writes flushed first so that the clone sees them.
+int FileSystem::cloneFileInode(int sourceInodeId)
+{
+    Inode sourceInode;
+    auto opened = system_open_file_table_.inode_index.find(sourceInodeId);
+    if (opened != system_open_file_table_.inode_index.end())
+    {
+        SystemOpenFileEntry &entry = system_open_file_table_.entries[opened->second];
+        if (!file_manager_.flushWriteBuffer(entry))
+        {
+            std::cerr << "Error: Could not flush buffered writes of the source file." << std::endl;
+            return INVALID_INODE_ID;
+        }
+        sourceInode = entry.inode_cache;
+    }
+    else if (!inode_manager_.readInode(sourceInodeId, sourceInode))
+    {
+        std::cerr << "Error: Could not read source inode " << sourceInodeId << "." << std::endl;
+        return INVALID_INODE_ID;
+    }
+
+    User *currentUser = user_manager_.getCurrentUser();
+    int newInodeId = file_manager_.createFileInode(currentUser->uid, sourceInode.permissions);
+    if (newInodeId == INVALID_INODE_ID)
+    {
+        std::cerr << "Error: Failed to create new file inode." << std::endl;
+        return INVALID_INODE_ID;
+    }
+    Inode newInode;
+    if (!inode_manager_.readInode(newInodeId, newInode) || !db_manager_.shareInodeDataBlocks(sourceInode, newInode))
+    {
+        std::cerr << "Error: Failed to share the data blocks of inode " << sourceInodeId << "." << std::endl;
+        sb_manager_.freeInode(newInodeId);
+        return INVALID_INODE_ID;
+    }
+    return newInodeId;
+}
+
+// Creates a directory inode holding only "." and ".."; the caller links it into parentInodeId
+// and accounts for the parent's extra link.
+int FileSystem::makeEmptyDirectory(int parentInodeId, short permissions)
+{
+    User *currentUser = user_manager_.getCurrentUser();
+    int newDirInodeId = dir_manager_.createDirectoryInode(currentUser->uid, permissions);
+    if (newDirInodeId == INVALID_INODE_ID)
+    {
+        std::cerr << "Error: Failed to create new directory inode." << std::endl;
+        return INVALID_INODE_ID;
+    }
+    Inode newDirInode;
+    std::vector<DirectoryEntry> dots(2);
+    std::strcpy(dots[0].filename, ".");
+    dots[0].inode_id = newDirInodeId;
+    std::strcpy(dots[1].filename, "..");
+    dots[1].inode_id = parentInodeId;
+    if (!inode_manager_.readInode(newDirInodeId, newDirInode))
+    {
+        std::cerr << "Error: Failed to read newly created directory inode." << std::endl;
+        sb_manager_.freeInode(newDirInodeId);
+        return INVALID_INODE_ID;
+    }
+    if (!dir_manager_.appendEntries(newDirInode, dots))
+    {
+        std::cerr << "Error: Failed to initialize new directory inode." << std::endl;
+        db_manager_.clearInodeDataBlocks(newDirInode);
+        sb_manager_.freeInode(newDirInodeId);
+        return INVALID_INODE_ID;
+    }
+    return newDirInodeId;
+}
+
+// True when inodeId is rootInodeId or lies below it, found by following ".." upwards.
+bool FileSystem::isInTree(int rootInodeId, int inodeId)
+{
+    int maxDepth = MAX_PATH_LENGTH; // guards against a corrupted ".." cycle
+    while (inodeId != INVALID_INODE_ID && maxDepth-- > 0)
+    {
+        if (inodeId == rootInodeId)
+        {
+            return true;
+        }
+        if (inodeId == root_dir_inode_id_)
+        {
+            return false;
+        }
+        Inode dirInode;
+        if (!inode_manager_.readInode(inodeId, dirInode))
+        {
+            return false;
+        }
+        inodeId = dir_manager_.findEntry(dirInode, "..");
+    }
+    return false;
+}
+
+// Recursive copy engine. The managers below FileSystem share one allocator, one inode table and
+// one journal without locking, so instead of walking the tree from several threads the copy
+// proceeds a whole directory level at a time and lets the I/O backend supply the parallelism:
+//   1. the inodes and entry blocks of every source directory in the level are read as one batch
+//      (prefetchInodes / prefetchDirectories queue all uncached blocks to the backend at once);
+//   2. the inodes of all their children are read as a second batch;
+//   3. each destination directory is filled in its own journal transaction: files are reflinked
+//      (no data is read or written), subdirectories are created for the next level, and the
+//      entries are written with one appendEntries call instead of a directory scan per name.
+// Entries the user may not read are reported and skipped; the rest of the tree is still copied.
+bool FileSystem::copyTree(int sourceDirInodeId, int destDirInodeId)
+{
+    struct CopyTask
+    {
+        int source_dir;
+        int dest_dir;
+    };
+    bool ok = true;
+    std::vector<CopyTask> level{{sourceDirInodeId, destDirInodeId}};
+    while (!level.empty())
+    {
+        std::vector<int> ids;
+        for (const CopyTask &task : level)
+        {
+            ids.push_back(task.source_dir);
+        }
+        inode_manager_.prefetchInodes(ids);
+        std::vector<Inode> sourceDirs(level.size());
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            if (!inode_manager_.readInode(level[i].source_dir, sourceDirs[i]))
+            {
+                std::cerr << "Error: Could not read directory inode " << level[i].source_dir << "." << std::endl;
+                sourceDirs[i].file_type = FileType::REGULAR_FILE; // skipped below
+                ok = false;
+            }
+        }
+        dir_manager_.prefetchDirectories(sourceDirs);
+
+        std::vector<std::vector<DirectoryEntry>> children(level.size());
+        ids.clear();
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            if (sourceDirs[i].file_type != FileType::DIRECTORY)
+            {
+                continue;
+            }
+            DirectoryIterator it = dir_manager_.openDirectory(sourceDirs[i]);
+            const DirectoryEntry *entry = nullptr;
+            while (it.next(entry))
+            {
+                if (std::strcmp(entry->filename, ".") != 0 && std::strcmp(entry->filename, "..") != 0)
+                {
+                    children[i].push_back(*entry);
+                    ids.push_back(entry->inode_id);
+                }
+            }
+            if (it.failed())
+            {
+                std::cerr << "Error: Could not read directory inode " << level[i].source_dir << "." << std::endl;
+                ok = false;
+            }
+        }
+        inode_manager_.prefetchInodes(ids);
+
+        std::vector<CopyTask> next;
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            JournalTransaction transaction(vdisk_);
+            std::vector<DirectoryEntry> entries;
+            int subdirectories = 0;
+            for (const DirectoryEntry &child : children[i])
+            {
+                Inode childInode;
+                if (!inode_manager_.readInode(child.inode_id, childInode))
+                {
+                    std::cerr << "Error: Could not read inode for '" << child.filename << "'." << std::endl;
+                    ok = false;
+                    continue;
+                }
+                if (!user_manager_.checkAccessPermission(childInode, PermissionAction::ACTION_READ))
+                {
+                    std::cerr << "Error: Permission denied to read '" << child.filename << "'." << std::endl;
+                    ok = false;
+                    continue;
+                }
+                bool isDirectory = childInode.file_type == FileType::DIRECTORY;
+                int newInodeId = isDirectory ? makeEmptyDirectory(level[i].dest_dir, childInode.permissions) : cloneFileInode(child.inode_id);
+                if (newInodeId == INVALID_INODE_ID)
+                {
+                    ok = false;
+                    continue;
+                }
+                if (isDirectory)
+                {
+                    next.push_back({child.inode_id, newInodeId});
+                    subdirectories++;
+                }
+                entries.push_back(child);
+                entries.back().inode_id = newInodeId;
+            }
+
+            Inode destDir;
+            if (!inode_manager_.readInode(level[i].dest_dir, destDir) || !dir_manager_.appendEntries(destDir, entries))
+            {
+                std::cerr << "Error: Failed to fill directory inode " << level[i].dest_dir << "." << std::endl;
+                return false;
+            }
+            destDir.link_count += subdirectories;
+            inode_manager_.writeInode(level[i].dest_dir, destDir);
+        }
+        level.swap(next);
+    }
+    return ok;
+}
+
+// A rename only edits directory entries: the destination gains the name (or an existing file's
+// entry is repointed in place), the source loses it, and a moved directory gets its ".." rewritten.
+// No data is copied and the subtree is not visited, and the whole change is one journal transaction,
+// so writing a temporary file and renaming it over the real one publishes it atomically.
+// Paths are always resolved through ".." entries, so nothing else needs to be updated.
+bool FileSystem::mv(const std::string &sourcePath, const std::string &destPath)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
+    User *currentUser = user_manager_.getCurrentUser();
+    if (!currentUser)
+    {
+        std::cerr << "Error: No user logged in. Cannot move." << std::endl;
+        return false;
+    }
+
+    int sourceParentId = INVALID_INODE_ID;
+    std::string sourceName;
+    int sourceInodeId = dir_manager_.resolvePathToInode(sourcePath, current_dir_inode_id_, root_dir_inode_id_, currentUser, &sourceParentId, &sourceName, false);
+    if (sourceInodeId == INVALID_INODE_ID)
+    {
+        std::cerr << "Error: Source '" << sourcePath << "' not found." << std::endl;
+        return false;
+    }
+    if (sourceInodeId == root_dir_inode_id_ || sourceParentId == INVALID_INODE_ID || sourceName.empty() || sourceName == "." || sourceName == "..")
+    {
+        std::cerr << "Error: Cannot move '" << sourcePath << "'." << std::endl;
+        return false;
+    }
+    Inode sourceInode;
+    if (!inode_manager_.readInode(sourceInodeId, sourceInode))
+    {
+        std::cerr << "Error: Could not read inode for '" << sourcePath << "'." << std::endl;
+        return false;
+    }
+    bool isDirectory = sourceInode.file_type == FileType::DIRECTORY;
+
+    // An existing directory receives the source under its own name
+    int destParentId = INVALID_INODE_ID;
+    std::string destName;
+    int destInodeId = dir_manager_.resolvePathToInode(destPath, current_dir_inode_id_, root_dir_inode_id_, currentUser, &destParentId, &destName);
+    if (destInodeId != INVALID_INODE_ID)
+    {
+        Inode destInode;
+        if (inode_manager_.readInode(destInodeId, destInode) && destInode.file_type == FileType::DIRECTORY && destInodeId != sourceInodeId)
+        {
+            destParentId = destInodeId;
+            destName = sourceName;
+            destInodeId = dir_manager_.findEntry(destInode, destName);
+        }
+    }
+    if (destParentId == INVALID_INODE_ID || destName.empty() || destName == "." || destName == "..")
+    {
+        std::cerr << "Error: Invalid path or cannot determine parent directory for '" << destPath << "'." << std::endl;
+        return false;
+    }
+    if (destName.length() >= MAX_FILENAME_LENGTH)
+    {
+        std::cerr << "Error: Filename '" << destName << "' is too long." << std::endl;
+        return false;
+    }
+    if (destInodeId == sourceInodeId)
+    {
+        return true; // renamed onto itself
+    }
+    if (isDirectory && isInTree(sourceInodeId, destParentId))
+    {
+        std::cerr << "Error: Cannot move directory '" << sourcePath << "' into itself." << std::endl;
+        return false;
+    }
+
+    Inode replacedInode;
+    if (destInodeId != INVALID_INODE_ID)
+    {
+        if (!inode_manager_.readInode(destInodeId, replacedInode))
+        {
+            std::cerr << "Error: Could not read inode for '" << destPath << "'." << std::endl;
+            return false;
+        }
+        if (isDirectory || replacedInode.file_type == FileType::DIRECTORY)
+        {
+            std::cerr << "Error: Destination '" << destName << "' already exists." << std::endl;
+            return false;
+        }
+    }
+
+    // With one parent both entry changes must go through the same inode copy
+    bool sameParent = sourceParentId == destParentId;
+    Inode sourceParentInode;
+    Inode destParentStorage;
+    Inode &destParentInode = sameParent ? sourceParentInode : destParentStorage;
+    if (!inode_manager_.readInode(sourceParentId, sourceParentInode) || (!sameParent && !inode_manager_.readInode(destParentId, destParentStorage)))
+    {
+        std::cerr << "Error: Could not read parent directory inode." << std::endl;
+        return false;
+    }
+    if (!user_manager_.checkAccessPermission(sourceParentInode, PermissionAction::ACTION_WRITE) ||
+        !user_manager_.checkAccessPermission(destParentInode, PermissionAction::ACTION_WRITE))
+    {
+        std::cerr << "Error: Permission denied to move '" << sourcePath << "'." << std::endl;
+        return false;
+    }
+
+    if (destInodeId != INVALID_INODE_ID)
+    {
+        if (!dir_manager_.replaceEntry(destParentInode, destName, sourceInodeId))
+        {
+            return false;
+        }
+        if (dropLink(replacedInode) && !queueOrphans({orphanEntry(destInodeId)}))
+        {
+            return false;
+        }
+    }
+    else if (!dir_manager_.addEntry(destParentInode, destName, sourceInodeId, sourceInode.file_type))
+    {
+        std::cerr << "Error: Failed to add entry to destination directory." << std::endl;
+        return false;
+    }
+    if (!dir_manager_.removeEntry(sourceParentInode, sourceName))
+    {
+        return false;
+    }
+
+    if (isDirectory && !sameParent)
+    {
+        if (!dir_manager_.replaceEntry(sourceInode, "..", destParentId))
+        {
+            return false;
+        }
+        sourceParentInode.link_count--;
+        destParentInode.link_count++;
+        inode_manager_.writeInode(sourceParentId, sourceParentInode);
+        inode_manager_.writeInode(destParentId, destParentInode);
+    }
+    return true;
+}
+
+bool FileSystem::ln(const std::string &targetPath, const std::string &linkPath)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return false;
+}
+
+bool FileSystem::chmod(const std::string &path, short mode)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return false;
+}
+
+bool FileSystem::chown(const std::string &path, const std::string &newOwnerUsername)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return false;
+}
+
+// Finds entries named filename below startPath; a filename containing "*", "?" or "[" is a glob
+// pattern (fnmatch). With the filename index built (buildNameIndex) the matches come from memory
+// (patterns through its trigram index) and only their parent chains are checked; otherwise the
+// tree is walked. Either way only directories the user may read are searched.
+std::vector<std::string> FileSystem::find(const std::string &startPath, const std::string &filename)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::vector<std::string> results;
+    User *currentUser = user_manager_.getCurrentUser();
+    if (!currentUser)
+    {
+        std::cerr << "Error: No user logged in." << std::endl;
+        return results;
+    }
+    int startInodeId = dir_manager_.resolvePathToInode(startPath, current_dir_inode_id_, root_dir_inode_id_, currentUser);
+    Inode startInode;
+    if (startInodeId == INVALID_INODE_ID || !inode_manager_.readInode(startInodeId, startInode) || startInode.file_type != FileType::DIRECTORY)
+    {
+        std::cerr << "Error: '" << startPath << "' is not a directory." << std::endl;
+        return results;
+    }
+
+    if (name_index_.enabled())
+    {
+        results = findIndexed(startInodeId, filename);
+    }
+    else
+    {
+        bool pattern = filename.find_first_of("*?[") != std::string::npos;
+        walkTree(startInodeId, true, [&](const std::string &dirPath, int, const DirectoryEntry &entry, const Inode &)
+                 {
+                     if (pattern ? fnmatch(filename.c_str(), entry.filename, 0) == 0 : filename == entry.filename)
+                     {
+                         results.push_back(dirPath == "/" ? dirPath + entry.filename : dirPath + "/" + entry.filename);
+                     } });
+    }
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+// Each match is turned into a path by following the index from its directory up to the root. A
+// directory whose entry is gone (removed, waiting for the reclaimer) breaks the chain, so entries
+// still listed under it are dropped.
+std::vector<std::string> FileSystem::findIndexed(int startDirInodeId, const std::string &filename)
+{
+    std::vector<std::string> results;
+    std::vector<NameIndexSlot> matches;
+    if (filename.find_first_of("*?[") != std::string::npos)
+    {
+        name_index_.match(filename, matches);
+    }
+    else
+    {
+        name_index_.lookup(filename, matches);
+    }
+    for (const NameIndexSlot &match : matches)
+    {
+        std::vector<int> chain; // directories from the match's parent up to the root
+        std::string path = std::string("/") + match.entry.filename;
+        int dirInodeId = match.parent_inode_id;
+        bool reachable = true;
+        while (dirInodeId != root_dir_inode_id_ && reachable && chain.size() < static_cast<size_t>(MAX_PATH_LENGTH))
+        {
+            chain.push_back(dirInodeId);
+            std::string name;
+            reachable = name_index_.entryOf(dirInodeId, dirInodeId, name);
+            path = "/" + name + path;
+        }
+        if (!reachable || dirInodeId != root_dir_inode_id_)
+        {
+            continue;
+        }
+        chain.push_back(root_dir_inode_id_);
+
+        // The directories from the start down to the match must all be readable
+        auto start = std::find(chain.begin(), chain.end(), startDirInodeId);
+        if (start == chain.end())
+        {
+            continue;
+        }
+        bool readable = true;
+        for (auto dir = chain.begin(); dir != start + 1 && readable; ++dir)
+        {
+            Inode dirInode;
+            readable = inode_manager_.readInode(*dir, dirInode) && user_manager_.checkAccessPermission(dirInode, PermissionAction::ACTION_READ);
+        }
+        if (readable)
+        {
+            results.push_back(path);
+        }
+    }
+    return results;
+}
+
+// Tree walk used by find without an index and to build the index. Like copyTree it proceeds one
+// directory level at a time: the inodes and entry blocks of all directories in the level are read
+// as one batch, then the inodes of all their entries as a second batch (readdir-plus), so the I/O
+// backend sees many requests at once while the unlocked managers are used from a single thread.
+void FileSystem::walkTree(int startDirInodeId, bool checkPermissions, const TreeVisitor &visit)
+{
+    struct WalkTask
+    {
+        int dir_inode_id;
+        std::string path;
+    };
+    std::vector<WalkTask> level{{startDirInodeId, getPathFromInodeId(startDirInodeId)}};
+    while (!level.empty())
+    {
+        std::vector<int> ids;
+        for (const WalkTask &task : level)
+        {
+            ids.push_back(task.dir_inode_id);
+        }
+        inode_manager_.prefetchInodes(ids);
+        std::vector<Inode> dirs(level.size());
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            if (!inode_manager_.readInode(level[i].dir_inode_id, dirs[i]) ||
+                (checkPermissions && !user_manager_.checkAccessPermission(dirs[i], PermissionAction::ACTION_READ)))
+            {
+                dirs[i].file_type = FileType::REGULAR_FILE; // skipped below
+            }
+        }
+        dir_manager_.prefetchDirectories(dirs);
+
+        std::vector<std::vector<DirectoryEntry>> children(level.size());
+        ids.clear();
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            if (dirs[i].file_type != FileType::DIRECTORY)
+            {
+                continue;
+            }
+            DirectoryIterator it = dir_manager_.openDirectory(dirs[i]);
+            const DirectoryEntry *entry = nullptr;
+            while (it.next(entry))
+            {
+                if (std::strcmp(entry->filename, ".") != 0 && std::strcmp(entry->filename, "..") != 0)
+                {
+                    children[i].push_back(*entry);
+                    ids.push_back(entry->inode_id);
+                }
+            }
+        }
+        inode_manager_.prefetchInodes(ids);
+
+        std::vector<WalkTask> next;
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            for (const DirectoryEntry &child : children[i])
+            {
+                Inode childInode;
+                if (!inode_manager_.readInode(child.inode_id, childInode))
+                {
+                    continue;
+                }
+                visit(level[i].path, level[i].dir_inode_id, child, childInode);
+                if (childInode.file_type == FileType::DIRECTORY)
+                {
+                    next.push_back({child.inode_id, level[i].path == "/" ? level[i].path + child.filename : level[i].path + "/" + child.filename});
+                }
+            }
+        }
+        level.swap(next);
+    }
+}
+
+// The filename index lives in a hidden file that no directory links to; its inode is recorded in the
+// superblock. Building it walks the whole tree once, after which directory changes keep it current.
+bool FileSystem::buildNameIndex()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
+    int indexInodeId = sb_manager_.getSuperBlockInfo().name_index_inode_idx;
+    if (indexInodeId == INVALID_INODE_ID)
+    {
+        indexInodeId = file_manager_.createFileInode(ROOT_UID, 0);
+        if (indexInodeId == INVALID_INODE_ID || !sb_manager_.setNameIndexInode(indexInodeId))
+        {
+            std::cerr << "Error: Could not create the filename index file." << std::endl;
+            return false;
+        }
+    }
+    return fillNameIndex(indexInodeId);
+}
+
+bool FileSystem::fillNameIndex(int indexInodeId)
+{
+    if (!name_index_.reset(indexInodeId))
+    {
+        return false;
+    }
+    walkTree(root_dir_inode_id_, false, [this](const std::string &, int dirInodeId, const DirectoryEntry &entry, const Inode &)
+             { name_index_.add(dirInodeId, entry); });
+    return true;
 }
 
 std::string FileSystem::getCurrentPathPrompt() const
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     User *currentUser = user_manager_.getCurrentUser();
     std::string username = currentUser ? currentUser->username : "guest";
 
@@ -728,6 +2051,8 @@ std::string FileSystem::getCurrentPathPrompt() const
 
 bool FileSystem::create(const std::string &path)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    JournalTransaction transaction(vdisk_);
     User *currentUser = user_manager_.getCurrentUser();
     if (!currentUser)
     {
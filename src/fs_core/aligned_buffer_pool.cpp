@@ -0,0 +1,133 @@
+#include "fs_core/aligned_buffer_pool.h"
+#include <cstdlib> // For std::aligned_alloc and std::free
+#include <cstring> // For std::memset
+#include <new>     // For std::bad_alloc
+
+AlignedBuffer::AlignedBuffer(AlignedBufferPool *pool, char *data, size_t size, size_t capacity)
+    : pool_(pool), data_(data), size_(size), capacity_(capacity)
+{
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer &&other) noexcept
+    : pool_(other.pool_), data_(other.data_), size_(other.size_), capacity_(other.capacity_)
+{
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = other.capacity_ = 0;
+}
+
+AlignedBuffer &AlignedBuffer::operator=(AlignedBuffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.size_ = other.capacity_ = 0;
+    }
+    return *this;
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+    reset();
+}
+
+void AlignedBuffer::reset()
+{
+    if (pool_ && data_)
+    {
+        pool_->release(data_, capacity_);
+    }
+    pool_ = nullptr;
+    data_ = nullptr;
+    size_ = capacity_ = 0;
+}
+
+// AlignedBufferPool 构造函数
+// bufferSize: 池中缓冲区的大小 (通常为一个块)。
+// alignment: 对齐粒度，必须是 2 的幂。
+// maxFree: 空闲表中最多保留的缓冲区数。
+AlignedBufferPool::AlignedBufferPool(size_t bufferSize, size_t alignment, size_t maxFree)
+    : buffer_size_(bufferSize), alignment_(alignment), max_free_(maxFree)
+{
+}
+
+AlignedBufferPool::~AlignedBufferPool()
+{
+    for (char *data : free_)
+    {
+        std::free(data);
+    }
+}
+
+// 已借出的旧大小缓冲区归还时按"其他大小"直接释放
+void AlignedBufferPool::setBufferSize(size_t bufferSize)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (char *data : free_)
+    {
+        std::free(data);
+    }
+    free_.clear();
+    buffer_size_ = bufferSize;
+}
+
+size_t AlignedBufferPool::roundUp(size_t size) const
+{
+    return (size + alignment_ - 1) / alignment_ * alignment_;
+}
+
+AlignedBuffer AlignedBufferPool::acquire()
+{
+    size_t size;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size = buffer_size_;
+    }
+    return acquire(size);
+}
+
+AlignedBuffer AlignedBufferPool::acquire(size_t size, bool zeroFill)
+{
+    size_t capacity = roundUp(size == 0 ? 1 : size);
+    char *data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (capacity == roundUp(buffer_size_) && !free_.empty())
+        {
+            data = free_.back();
+            free_.pop_back();
+        }
+    }
+    if (!data)
+    {
+        data = static_cast<char *>(std::aligned_alloc(alignment_, capacity));
+        if (!data)
+        {
+            throw std::bad_alloc();
+        }
+    }
+    if (zeroFill)
+    {
+        std::memset(data, 0, capacity);
+    }
+    return AlignedBuffer(this, data, size, capacity);
+}
+
+void AlignedBufferPool::release(char *data, size_t capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (capacity == roundUp(buffer_size_) && free_.size() < max_free_)
+        {
+            free_.push_back(data);
+            return;
+        }
+    }
+    std::free(data);
+}
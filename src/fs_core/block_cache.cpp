@@ -0,0 +1,262 @@
+#include "fs_core/block_cache.h"
+#include <cstring>   // For std::memcpy
+#include <algorithm> // For std::sort
+
+// BlockCache 构造函数
+// blockSize: 每块字节数。
+// capacityBlocks: 最多缓存的块数，0 表示不缓存。
+BlockCache::BlockCache(int blockSize, size_t capacityBlocks)
+    : block_size_(blockSize), capacity_blocks_(capacityBlocks), dirty_count_(0), pinned_dirty_count_(0)
+{
+}
+
+void BlockCache::setWritebackHandler(WritebackHandler handler)
+{
+    writeback_ = std::move(handler);
+}
+
+// 查找块；命中时复制到 buffer 并移到 LRU 表头
+bool BlockCache::lookup(BlockId blockId, char *buffer)
+{
+    auto it = index_.find(blockId);
+    if (it == index_.end())
+    {
+        return false;
+    }
+    if (!it->second->pinned)
+    {
+        lru_.splice(lru_.begin(), lru_, it->second);
+    }
+    std::memcpy(buffer, it->second->data.data(), block_size_);
+    return true;
+}
+
+// 插入或覆盖一个块；超出容量时淘汰表尾（最久未用）的块，并复用其缓冲区。
+// dirty 为 false 表示 data 与磁盘一致；此时不会覆盖缓存中尚未写回的脏数据。
+void BlockCache::insert(BlockId blockId, const char *data, bool dirty)
+{
+    if (capacity_blocks_ == 0)
+    {
+        if (dirty && writeback_)
+        {
+            writeback_(blockId, data); // 不缓存时退化为写直达
+        }
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto it = index_.find(blockId);
+    if (it != index_.end())
+    {
+        CachedBlock &cached = *it->second;
+        if (!cached.pinned)
+        {
+            lru_.splice(lru_.begin(), lru_, it->second);
+        }
+        if (!dirty && cached.dirty)
+        {
+            return; // 缓存中的脏数据比磁盘上的新
+        }
+        std::memcpy(cached.data.data(), data, block_size_);
+        if (dirty && !cached.dirty)
+        {
+            cached.dirty = true;
+            cached.dirtied_at = now;
+            ++dirty_count_;
+            if (cached.pinned)
+            {
+                ++pinned_dirty_count_;
+            }
+        }
+        return;
+    }
+
+    // 钉住的块解除后缓存可能仍超出容量: 先淘汰多出的块
+    while (size() > capacity_blocks_ && evictUnpinned())
+    {
+    }
+
+    // 淘汰 lru_ 表尾 (最久未用) 的块；全部被钉住时暂时超出容量
+    auto victim = lru_.end();
+    if (size() >= capacity_blocks_ && !lru_.empty())
+    {
+        victim = std::prev(lru_.end());
+    }
+    if (victim != lru_.end())
+    {
+        // 复用被淘汰块的节点和缓冲区，避免反复分配；脏块先写回
+        if (victim->dirty)
+        {
+            if (writeback_)
+            {
+                writeback_(victim->block_id, victim->data.data());
+            }
+            --dirty_count_;
+        }
+        index_.erase(victim->block_id);
+        victim->block_id = blockId;
+        victim->dirty = dirty;
+        victim->pinned = false;
+        victim->dirtied_at = now;
+        std::memcpy(victim->data.data(), data, block_size_);
+        lru_.splice(lru_.begin(), lru_, victim);
+    }
+    else
+    {
+        lru_.push_front({blockId, dirty, false, now, std::vector<char>(data, data + block_size_)});
+    }
+    if (dirty)
+    {
+        ++dirty_count_;
+    }
+    index_[blockId] = lru_.begin();
+}
+
+// 淘汰最久未用且未钉住的一个块 (脏块先写回)，没有可淘汰的块时返回 false
+bool BlockCache::evictUnpinned()
+{
+    if (lru_.empty())
+    {
+        return false;
+    }
+    auto victim = std::prev(lru_.end());
+    if (victim->dirty)
+    {
+        if (writeback_)
+        {
+            writeback_(victim->block_id, victim->data.data());
+        }
+        --dirty_count_;
+    }
+    index_.erase(victim->block_id);
+    lru_.erase(victim);
+    return true;
+}
+
+bool BlockCache::contains(BlockId blockId) const
+{
+    return index_.count(blockId) != 0;
+}
+
+void BlockCache::invalidate(BlockId blockId)
+{
+    auto it = index_.find(blockId);
+    if (it != index_.end())
+    {
+        if (it->second->dirty)
+        {
+            --dirty_count_;
+            if (it->second->pinned)
+            {
+                --pinned_dirty_count_;
+            }
+        }
+        (it->second->pinned ? pinned_ : lru_).erase(it->second);
+        index_.erase(it);
+    }
+}
+
+void BlockCache::clear()
+{
+    lru_.clear();
+    pinned_.clear();
+    index_.clear();
+    dirty_count_ = 0;
+    pinned_dirty_count_ = 0;
+}
+
+// 块大小改变后旧块全部作废 (调用者应先写回脏块)
+void BlockCache::reset(int blockSize, size_t capacityBlocks)
+{
+    clear();
+    block_size_ = blockSize;
+    capacity_blocks_ = capacityBlocks;
+}
+
+size_t BlockCache::size() const
+{
+    return lru_.size() + pinned_.size();
+}
+
+size_t BlockCache::capacity() const
+{
+    return capacity_blocks_;
+}
+
+size_t BlockCache::dirtyCount() const
+{
+    return dirty_count_;
+}
+
+size_t BlockCache::unpinnedDirtyCount() const
+{
+    return dirty_count_ - pinned_dirty_count_;
+}
+
+// 收集在 dirtiedBefore 之前变脏且未钉住的块号，按块号升序 (电梯顺序) 返回
+std::vector<BlockId> BlockCache::collectDirty(std::chrono::steady_clock::time_point dirtiedBefore) const
+{
+    std::vector<BlockId> block_ids;
+    if (unpinnedDirtyCount() == 0)
+    {
+        return block_ids;
+    }
+    for (const CachedBlock &cached : lru_)
+    {
+        if (cached.dirty && cached.dirtied_at < dirtiedBefore)
+        {
+            block_ids.push_back(cached.block_id);
+        }
+    }
+    std::sort(block_ids.begin(), block_ids.end());
+    return block_ids;
+}
+
+// 取出一个脏块准备写回: 复制数据并标记为干净 (之后再写入会重新变脏)
+bool BlockCache::takeDirty(BlockId blockId, char *buffer)
+{
+    auto it = index_.find(blockId);
+    if (it == index_.end() || !it->second->dirty || it->second->pinned)
+    {
+        return false;
+    }
+    std::memcpy(buffer, it->second->data.data(), block_size_);
+    it->second->dirty = false;
+    --dirty_count_;
+    return true;
+}
+
+bool BlockCache::pin(BlockId blockId)
+{
+    auto it = index_.find(blockId);
+    if (it == index_.end())
+    {
+        return false;
+    }
+    if (it->second->pinned)
+    {
+        return true;
+    }
+    if (it->second->dirty)
+    {
+        ++pinned_dirty_count_;
+    }
+    it->second->pinned = true;
+    pinned_.splice(pinned_.end(), lru_, it->second);
+    return true;
+}
+
+void BlockCache::unpin(BlockId blockId)
+{
+    auto it = index_.find(blockId);
+    if (it == index_.end() || !it->second->pinned)
+    {
+        return;
+    }
+    if (it->second->dirty)
+    {
+        --pinned_dirty_count_;
+    }
+    it->second->pinned = false;
+    lru_.splice(lru_.begin(), pinned_, it->second);
+}
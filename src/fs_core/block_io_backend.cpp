@@ -0,0 +1,307 @@
+#include "fs_core/block_io_backend.h"
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace
+{
+    // 同步完成一段 (或剩余的一段) 传输；读到文件末尾时用 0 填充
+    bool transferSync(int fd, BlockIoRequest &request, int blockSize, long long done)
+    {
+        long long total = static_cast<long long>(request.block_count) * blockSize;
+        long long offset = static_cast<long long>(request.start_block_id) * blockSize;
+        while (done < total)
+        {
+            ssize_t n = request.is_write
+                            ? ::pwrite(fd, request.buffer + done, total - done, offset + done)
+                            : ::pread(fd, request.buffer + done, total - done, offset + done);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0 || (n == 0 && request.is_write))
+            {
+                return false;
+            }
+            if (n == 0)
+            {
+                std::memset(request.buffer + done, 0, total - done);
+                break;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    // 同步后端: 每个请求直接 pread/pwrite，submit 返回时已全部完成
+    class PosixBlockIoBackend : public BlockIoBackend
+    {
+    public:
+        PosixBlockIoBackend(int fd, int blockSize) : fd_(fd), block_size_(blockSize) {}
+        const char *name() const override { return "pread/pwrite"; }
+        bool submit(BlockIoRequest *requests, int count) override
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                requests[i].ok = transferSync(fd_, requests[i], block_size_, 0);
+                requests[i].completed = true;
+            }
+            return true;
+        }
+        int reap(int) override { return 0; }
+        int inFlight() const override { return 0; }
+
+    private:
+        int fd_;
+        int block_size_;
+    };
+
+    // io_uring 后端: 通过 io_uring_setup / io_uring_enter 系统调用直接操作提交队列和完成队列
+    class IoUringBlockIoBackend : public BlockIoBackend
+    {
+    public:
+        IoUringBlockIoBackend(int fd, int blockSize) : fd_(fd), block_size_(blockSize) {}
+        ~IoUringBlockIoBackend() override
+        {
+            while (in_flight_ > 0 && reap(in_flight_) > 0)
+            {
+            }
+            if (sqes_ != MAP_FAILED)
+                ::munmap(sqes_, sqes_size_);
+            if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+                ::munmap(cq_ptr_, cq_ring_size_);
+            if (sq_ptr_ != MAP_FAILED)
+                ::munmap(sq_ptr_, sq_ring_size_);
+            if (ring_fd_ >= 0)
+                ::close(ring_fd_);
+        }
+
+        bool init(int queueDepth)
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, queueDepth, &params));
+            if (ring_fd_ < 0)
+            {
+                return false;
+            }
+            sq_entries_ = params.sq_entries;
+
+            sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single_mmap)
+            {
+                sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+            }
+            sq_ptr_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+            if (sq_ptr_ == MAP_FAILED)
+            {
+                return false;
+            }
+            cq_ptr_ = single_mmap ? sq_ptr_
+                                  : ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED)
+            {
+                return false;
+            }
+            sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+            sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+            if (sqes_ == MAP_FAILED)
+            {
+                return false;
+            }
+
+            char *sq = static_cast<char *>(sq_ptr_);
+            char *cq = static_cast<char *>(cq_ptr_);
+            sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+            slots_.assign(sq_entries_, Slot{nullptr, 0});
+            for (unsigned i = 0; i < sq_entries_; ++i)
+            {
+                free_slots_.push_back(i);
+            }
+            return true;
+        }
+
+        const char *name() const override { return "io_uring"; }
+
+        bool submit(BlockIoRequest *requests, int count) override
+        {
+            int pending = 0; // 已写入提交队列、尚未交给内核的条目数
+            for (int i = 0; i < count; ++i)
+            {
+                if (free_slots_.empty())
+                {
+                    if (!enter(pending, 0))
+                        return false;
+                    pending = 0;
+                    reap(1);
+                }
+                requests[i].completed = false;
+                queue(requests[i], 0);
+                ++pending;
+            }
+            return enter(pending, 0);
+        }
+
+        int reap(int minCompletions) override
+        {
+            int reaped = 0;
+            while (in_flight_ > 0)
+            {
+                unsigned head = *cq_head_;
+                unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+                while (head != tail)
+                {
+                    const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+                    complete(static_cast<unsigned>(cqe.user_data), cqe.res);
+                    ++head;
+                    ++reaped;
+                }
+                __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+                if (reaped >= minCompletions)
+                {
+                    break;
+                }
+                if (::syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+                {
+                    std::cerr << "错误: io_uring_enter 等待完成事件失败: " << std::strerror(errno) << std::endl;
+                    break;
+                }
+            }
+            return reaped;
+        }
+
+        int inFlight() const override { return in_flight_; }
+
+    private:
+        struct Slot
+        {
+            BlockIoRequest *request;
+            long long done; // 已传输的字节数 (短读写时从这里继续)
+        };
+
+        void queue(BlockIoRequest &request, long long done)
+        {
+            unsigned slot = free_slots_.back();
+            free_slots_.pop_back();
+            slots_[slot] = Slot{&request, done};
+
+            unsigned tail = *sq_tail_;
+            unsigned index = tail & sq_mask_;
+            io_uring_sqe &sqe = static_cast<io_uring_sqe *>(sqes_)[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = request.is_write ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe.fd = fd_;
+            sqe.addr = reinterpret_cast<unsigned long long>(request.buffer + done);
+            sqe.len = static_cast<unsigned>(static_cast<long long>(request.block_count) * block_size_ - done);
+            sqe.off = static_cast<unsigned long long>(request.start_block_id) * block_size_ + done;
+            sqe.user_data = slot;
+            sq_array_[index] = index;
+            __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+            ++in_flight_;
+        }
+
+        bool enter(int toSubmit, int minComplete)
+        {
+            while (toSubmit > 0)
+            {
+                long submitted = ::syscall(__NR_io_uring_enter, ring_fd_, toSubmit, minComplete,
+                                           minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if (submitted < 0)
+                {
+                    if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                    {
+                        reap(1);
+                        continue;
+                    }
+                    std::cerr << "错误: io_uring_enter 提交失败: " << std::strerror(errno) << std::endl;
+                    return false;
+                }
+                toSubmit -= static_cast<int>(submitted);
+            }
+            return true;
+        }
+
+        void complete(unsigned slot, int res)
+        {
+            Slot entry = slots_[slot];
+            free_slots_.push_back(slot);
+            --in_flight_;
+            BlockIoRequest &request = *entry.request;
+            long long total = static_cast<long long>(request.block_count) * block_size_;
+            if (res < 0)
+            {
+                // 旧内核不支持 IORING_OP_READ/WRITE 等情况: 退回同步路径完成这个请求
+                request.ok = transferSync(fd_, request, block_size_, entry.done);
+            }
+            else if (entry.done + res < total)
+            {
+                // 短读写: 剩余部分同步完成 (读到文件末尾时补 0)
+                request.ok = (res == 0 && request.is_write) ? false : transferSync(fd_, request, block_size_, entry.done + res);
+            }
+            else
+            {
+                request.ok = true;
+            }
+            request.completed = true;
+        }
+
+        int fd_;
+        int block_size_;
+        int ring_fd_ = -1;
+        unsigned sq_entries_ = 0;
+        size_t sq_ring_size_ = 0;
+        size_t cq_ring_size_ = 0;
+        size_t sqes_size_ = 0;
+        void *sq_ptr_ = MAP_FAILED;
+        void *cq_ptr_ = MAP_FAILED;
+        void *sqes_ = MAP_FAILED;
+        unsigned *sq_tail_ = nullptr;
+        unsigned sq_mask_ = 0;
+        unsigned *sq_array_ = nullptr;
+        unsigned *cq_head_ = nullptr;
+        unsigned *cq_tail_ = nullptr;
+        unsigned cq_mask_ = 0;
+        io_uring_cqe *cqes_ = nullptr;
+        std::vector<Slot> slots_;
+        std::vector<unsigned> free_slots_;
+        int in_flight_ = 0;
+    };
+}
+
+bool BlockIoBackend::submitAndWait(BlockIoRequest *requests, int count)
+{
+    bool ok = submit(requests, count);
+    while (inFlight() > 0 && reap(inFlight()) > 0)
+    {
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        ok = ok && requests[i].completed && requests[i].ok;
+    }
+    return ok;
+}
+
+// 创建块 I/O 后端: 优先 io_uring，失败 (内核不支持、被禁用或受 seccomp 限制) 时使用 pread/pwrite
+std::unique_ptr<BlockIoBackend> BlockIoBackend::create(int fd, int blockSize, int queueDepth)
+{
+    std::unique_ptr<IoUringBlockIoBackend> uring(new IoUringBlockIoBackend(fd, blockSize));
+    if (uring->init(queueDepth))
+    {
+        return std::unique_ptr<BlockIoBackend>(uring.release());
+    }
+    return std::unique_ptr<BlockIoBackend>(new PosixBlockIoBackend(fd, blockSize));
+}
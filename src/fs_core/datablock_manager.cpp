@@ -10,6 +10,7 @@
 #include <algorithm> // For std::min, std::max
 #include <chrono>    // For std::chrono::system_clock
 #include <ctime>     // For std::time_t and std::chrono::system_clock::to_time_t
+#include <climits>   // For INT_MAX
 
 // DataBlockManager 构造函数
 DataBlockManager::DataBlockManager(VirtualDisk *vdisk, InodeManager *inodeManager, SuperBlockManager *sbManager)
@@ -20,10 +21,131 @@ DataBlockManager::DataBlockManager(VirtualDisk *vdisk, InodeManager *inodeManage
     }
 }
 
+namespace {
+// 在 IoVec 数组上顺序推进的游标: 把多个调用者缓冲区视为一条连续字节流
+class IoVecCursor {
+public:
+    IoVecCursor(const IoVec *iov, int iovcnt) : iov_(iov), iovcnt_(iovcnt), index_(0), offset_in_vec_(0) {}
+
+    // 从字节流取出 n 字节到 dst (写路径)
+    void copyOut(char *dst, int n) {
+        while (n > 0) {
+            skipEmpty();
+            int chunk = std::min(n, iov_[index_].length - offset_in_vec_);
+            std::memcpy(dst, iov_[index_].base + offset_in_vec_, chunk);
+            advance(chunk);
+            dst += chunk;
+            n -= chunk;
+        }
+    }
+
+    // 把 src 的 n 字节放入字节流 (读路径); src 为 nullptr 时填零 (文件空洞)
+    void copyIn(const char *src, int n) {
+        while (n > 0) {
+            skipEmpty();
+            int chunk = std::min(n, iov_[index_].length - offset_in_vec_);
+            if (src) {
+                std::memcpy(iov_[index_].base + offset_in_vec_, src, chunk);
+                src += chunk;
+            } else {
+                std::memset(iov_[index_].base + offset_in_vec_, 0, chunk);
+            }
+            advance(chunk);
+            n -= chunk;
+        }
+    }
+
+    // 若接下来的 n 字节完整落在当前这一个 iovec 内，返回其起始地址并前进 n 字节，否则返回 nullptr。
+    // 用于整块直接读写调用者缓冲区，省去块缓冲区中转。
+    char *takeContiguous(int n) {
+        skipEmpty();
+        if (index_ >= iovcnt_ || iov_[index_].length - offset_in_vec_ < n) return nullptr;
+        char *p = iov_[index_].base + offset_in_vec_;
+        advance(n);
+        return p;
+    }
+
+private:
+    void skipEmpty() {
+        while (index_ < iovcnt_ && offset_in_vec_ >= iov_[index_].length) {
+            ++index_;
+            offset_in_vec_ = 0;
+        }
+    }
+    void advance(int n) { offset_in_vec_ += n; }
+
+    const IoVec *iov_;
+    int iovcnt_;
+    int index_;
+    int offset_in_vec_;
+};
+
+// 所有 iovec 的总长度; 任一长度非法或总长度超出 int 范围时返回 -1
+long long totalIoVecLength(const IoVec *iov, int iovcnt) {
+    if (iovcnt < 0 || (iovcnt > 0 && !iov)) return -1;
+    long long total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].length < 0 || (iov[i].length > 0 && !iov[i].base)) return -1;
+        total += iov[i].length;
+    }
+    return total > INT_MAX ? -1 : total;
+}
+} // namespace
+
 // 从文件的指定偏移量读取数据
-int DataBlockManager::readFileData(Inode &inode, long long offset, char *buffer, int length) {
+int DataBlockManager::readFileData(Inode &inode, long long offset, char *buffer, int length, ReadaheadState *readahead) {
+    IoVec single = {buffer, length};
+    return readFileDataV(inode, offset, &single, 1, readahead);
+}
+
+// 顺序预读: 读取从上次结束处继续时视为顺序访问，按窗口把后续块批量读入块缓存，
+// 每发起一轮预读窗口翻倍 (上限 READAHEAD_MAX_BLOCKS)；随机访问时窗口清零。
+void DataBlockManager::readahead(Inode &inode, long long offset, int length, ReadaheadState &state) {
+    int block_size = sb_manager_->getSuperBlockInfo().block_size;
+    long long first_block = offset / block_size;
+    long long last_block = (offset + length - 1) / block_size;
+    bool sequential = (offset == state.next_offset);
+    state.next_offset = offset + length;
+
+    if (!sequential) {
+        state.window_blocks = 0;
+        state.readahead_end_block = 0;
+        return;
+    }
+
+    // 已预读区域还剩一半以上时无需发起新一轮
+    if (state.window_blocks > 0 && last_block + 1 + state.window_blocks / 2 < state.readahead_end_block) {
+        return;
+    }
+    state.window_blocks = (state.window_blocks == 0) ? READAHEAD_INITIAL_BLOCKS
+                                                     : std::min(state.window_blocks * 2, READAHEAD_MAX_BLOCKS);
+
+    // 本次读取本身需要的块也一并批量读取，再加上后续一个窗口
+    long long file_blocks = (inode.file_size + block_size - 1) / block_size;
+    long long start = std::max(first_block, state.readahead_end_block);
+    long long end = std::min(last_block + 1 + state.window_blocks, file_blocks);
+    std::vector<BlockId> block_ids;
+    for (long long lb = start; lb < end; ++lb) {
+        BlockId block_id = inode_manager_->getBlockIdForFileOffset(inode, lb * block_size, false);
+        if (block_id != INVALID_BLOCK_ID) {
+            block_ids.push_back(block_id);
+        }
+    }
+    if (end > state.readahead_end_block) {
+        state.readahead_end_block = end;
+    }
+    vdisk_->prefetchBlocks(block_ids);
+}
+
+// 从文件的指定偏移量读取数据到多个缓冲区 (分散读): 一次遍历块映射, 一次inode写回
+int DataBlockManager::readFileDataV(Inode &inode, long long offset, const IoVec *iov, int iovcnt, ReadaheadState *readahead) {
     if (!vdisk_ || !inode_manager_ || !sb_manager_) return -1;
-    if (length <= 0) return 0;
+    long long total_length = totalIoVecLength(iov, iovcnt);
+    if (total_length < 0) {
+        std::cerr << "错误 (readFileData): 无效的 iovec 参数。" << std::endl;
+        return -1;
+    }
+    if (total_length == 0) return 0;
     if (offset < 0) {
         std::cerr << "错误 (readFileData): 无效的偏移量 " << offset << std::endl;
         return -1;
@@ -37,19 +159,37 @@ int DataBlockManager::readFileData(Inode &inode, long long offset, char *buffer,
     if (current_offset >= inode.file_size) {
         return 0; 
     }
-    length = static_cast<int>(std::min(static_cast<long long>(length), inode.file_size - current_offset));
+    int length = static_cast<int>(std::min(total_length, inode.file_size - current_offset));
     if (length <= 0) return 0;
 
-    std::vector<char> temp_block_buffer_vec(block_size);
+    if (readahead) {
+        this->readahead(inode, offset, length, *readahead);
+    }
+
+    AlignedBuffer temp_block_buffer_vec = vdisk_->bufferPool().acquire(block_size);
+    IoVecCursor cursor(iov, iovcnt);
 
     while (bytes_read < length) {
-        int physical_block_id = inode_manager_->getBlockIdForFileOffset(inode, current_offset, false); 
+        int offset_in_block = static_cast<int>(current_offset % block_size);
+        int bytes_to_read_from_block = std::min(block_size - offset_in_block, length - bytes_read);
+
+        BlockId physical_block_id = inode_manager_->getBlockIdForFileOffset(inode, current_offset, false); 
         if (physical_block_id == INVALID_BLOCK_ID) {
-            std::cerr << "警告 (readFileData): 在偏移量 " << current_offset << " 处未找到数据块 (inode " << inode.inode_id << ")。" << std::endl;
-            break; 
+            // 文件内的空洞 (lseek 越过文件末尾后写入产生)，按全零返回
+            cursor.copyIn(nullptr, bytes_to_read_from_block);
+            bytes_read += bytes_to_read_from_block;
+            current_offset += bytes_to_read_from_block;
+            continue;
+        }
+
+        // 对齐的整块且落在单个调用者缓冲区内: 直接读入调用者缓冲区；只有首尾的部分块经过中转缓冲区
+        char *direct_target = nullptr;
+        if (offset_in_block == 0 && bytes_to_read_from_block == block_size) {
+            direct_target = cursor.takeContiguous(block_size);
         }
+        char *read_target = direct_target ? direct_target : temp_block_buffer_vec.data();
 
-        if (!vdisk_->readBlock(physical_block_id, temp_block_buffer_vec.data(), block_size)) {
+        if (!vdisk_->readBlock(physical_block_id, read_target, block_size)) {
             std::cerr << "错误 (readFileData): 无法从物理块 " << physical_block_id << " 读取数据。" << std::endl;
             // 如果已经读取了部分数据，仍然尝试更新访问时间并写回inode
             if (bytes_read > 0 && inode.inode_id != INVALID_INODE_ID) {
@@ -62,10 +202,9 @@ int DataBlockManager::readFileData(Inode &inode, long long offset, char *buffer,
             return (bytes_read > 0) ? bytes_read : -1; 
         }
 
-        int offset_in_block = static_cast<int>(current_offset % block_size);
-        int bytes_to_read_from_block = std::min(block_size - offset_in_block, length - bytes_read);
-
-        std::memcpy(buffer + bytes_read, temp_block_buffer_vec.data() + offset_in_block, bytes_to_read_from_block);
+        if (!direct_target) {
+            cursor.copyIn(temp_block_buffer_vec.data() + offset_in_block, bytes_to_read_from_block);
+        }
 
         bytes_read += bytes_to_read_from_block;
         current_offset += bytes_to_read_from_block;
@@ -89,25 +228,37 @@ int DataBlockManager::readFileData(Inode &inode, long long offset, char *buffer,
 
 //向文件的指定偏移量写入数据
 int DataBlockManager::writeFileData(Inode &inode, long long offset, const char *buffer, int length, bool &sizeChanged) {
+    IoVec single = {const_cast<char *>(buffer), length};
+    return writeFileDataV(inode, offset, &single, 1, sizeChanged);
+}
+
+// 把多个缓冲区的内容依次写到文件的指定偏移量 (聚集写):
+// 一次遍历块映射, 落在同一块内的多个 iovec 片段合并为一次读-改-写, 最后只写回一次inode
+int DataBlockManager::writeFileDataV(Inode &inode, long long offset, const IoVec *iov, int iovcnt, bool &sizeChanged) {
+    sizeChanged = false;
     if (!vdisk_ || !inode_manager_ || !sb_manager_) return -1;
-    if (length <= 0) {
-        sizeChanged = false;
+    long long total_length = totalIoVecLength(iov, iovcnt);
+    if (total_length < 0) {
+        std::cerr << "错误 (writeFileData): 无效的 iovec 参数。" << std::endl;
+        return -1;
+    }
+    if (total_length == 0) {
         return 0;
     }
      if (offset < 0) {
         std::cerr << "错误 (writeFileData): 无效的偏移量 " << offset << std::endl;
-        sizeChanged = false;
         return -1;
     }
 
     const SuperBlock& sb = sb_manager_->getSuperBlockInfo();
     int block_size = sb.block_size;
+    int length = static_cast<int>(total_length);
     int bytes_written = 0;
     long long current_offset = offset;
-    sizeChanged = false;
     bool inode_modified_by_block_alloc = false; // 标记inode的块指针是否因分配而改变
 
-    std::vector<char> temp_block_buffer_vec(block_size);
+    AlignedBuffer temp_block_buffer_vec = vdisk_->bufferPool().acquire(block_size);
+    IoVecCursor cursor(iov, iovcnt);
 
     while (bytes_written < length) {
         long long original_single_indirect = inode.single_indirect_block; // 记录分配前的间接块指针
@@ -115,7 +266,13 @@ int DataBlockManager::writeFileData(Inode &inode, long long offset, const char *
         // 可以进一步记录 direct_blocks 的原始状态，但这会更复杂
         // 主要目的是检测 getBlockIdForFileOffset 是否分配了新的 *顶层* 间接块指针
 
-        int physical_block_id = inode_manager_->getBlockIdForFileOffset(inode, current_offset, true); 
+        int offset_in_block = static_cast<int>(current_offset % block_size);
+        int bytes_to_write_to_block = std::min(block_size - offset_in_block, length - bytes_written);
+
+        // 写满整块时，共享块的副本不必先拷贝旧内容
+        bool whole_block = offset_in_block == 0 && bytes_to_write_to_block == block_size;
+        bool fresh_block = false;
+        BlockId physical_block_id = inode_manager_->getBlockIdForFileOffset(inode, current_offset, true, whole_block, &fresh_block);
         
         if (physical_block_id == INVALID_BLOCK_ID) {
             std::cerr << "错误 (writeFileData): 无法在偏移量 " << current_offset << " 处获取或分配数据块 (inode " << inode.inode_id << ")。" << std::endl;
@@ -130,20 +287,28 @@ int DataBlockManager::writeFileData(Inode &inode, long long offset, const char *
         // 更精细的检查可以比较所有 direct_blocks，但这可能过于频繁
         // 简单假设如果 getBlockIdForFileOffset 被调用且 allocateIfMissing=true，inode 可能已改动
 
+        // 对齐的整块且来自单个调用者缓冲区: 直接从调用者缓冲区写出，不经过中转缓冲区
+        const char *write_source = nullptr;
+        if (whole_block) {
+            write_source = cursor.takeContiguous(block_size);
+        }
 
-        int offset_in_block = static_cast<int>(current_offset % block_size);
-        int bytes_to_write_to_block = std::min(block_size - offset_in_block, length - bytes_written);
-
-        if (offset_in_block != 0 || bytes_to_write_to_block < block_size) {
-            if (!vdisk_->readBlock(physical_block_id, temp_block_buffer_vec.data(), block_size)) {
-                 std::cerr << "错误 (writeFileData): 无法从物理块 " << physical_block_id << " 读取数据以进行部分写入。" << std::endl;
-                 break;
+        if (!write_source) {
+            if (fresh_block) {
+                // 新分配的块里是之前释放者的旧数据: 未写到的部分 (空洞、旧文件末尾之后) 必须读出为 0
+                std::memset(temp_block_buffer_vec.data(), 0, block_size);
+            } else if (offset_in_block != 0 || bytes_to_write_to_block < block_size) {
+                if (!vdisk_->readBlock(physical_block_id, temp_block_buffer_vec.data(), block_size)) {
+                     std::cerr << "错误 (writeFileData): 无法从物理块 " << physical_block_id << " 读取数据以进行部分写入。" << std::endl;
+                     break;
+                }
             }
+            cursor.copyOut(temp_block_buffer_vec.data() + offset_in_block, bytes_to_write_to_block);
+            write_source = temp_block_buffer_vec.data();
         }
 
-        std::memcpy(temp_block_buffer_vec.data() + offset_in_block, buffer + bytes_written, bytes_to_write_to_block);
-
-        if (!vdisk_->writeBlock(physical_block_id, temp_block_buffer_vec.data(), block_size)) {
+        // 文件内容不经元数据日志，只有块指针、大小等 i-node 变化进入事务
+        if (!vdisk_->writeDataBlock(physical_block_id, write_source, block_size)) {
             std::cerr << "错误 (writeFileData): 无法向物理块 " << physical_block_id << " 写入数据。" << std::endl;
             break; 
         }
@@ -177,78 +342,103 @@ int DataBlockManager::writeFileData(Inode &inode, long long offset, const char *
     return bytes_written;
 }
 
-// 清除一个i-node所占用的所有数据块
-void DataBlockManager::clearInodeDataBlocks(Inode &inode) {
-    if (!vdisk_ || !inode_manager_ || !sb_manager_) return;
-
-    const SuperBlock& sb = sb_manager_->getSuperBlockInfo();
-    int block_size = sb.block_size;
-    int pointers_per_block = block_size / sizeof(int);
-     if (pointers_per_block == 0) {
-         std::cerr << "错误 (clearInodeDataBlocks): block_size " << block_size << " 太小，无法容纳任何块指针。" << std::endl;
-         return;
+// 收集一棵间接块树中要释放的块 (最后是 blockId 本身): depth 为 1 时 blockId 中的指针直接指向数据块，
+// 否则指向下一级间接块。被其他文件共享的块当场减少一个引用，既不收集也不深入: 其下的块仍归共享者所有。
+void DataBlockManager::collectIndirectTree(BlockId blockId, int depth, std::vector<BlockId> &blockIds) {
+    if (sb_manager_->blockReferences(blockId) > 1) {
+        sb_manager_->freeBlock(blockId);
+        return;
     }
+    int block_size = sb_manager_->getSuperBlockInfo().block_size;
+    int pointers_per_block = block_size / BLOCK_ID_TYPE_SIZE;
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(block_size, false);
+    if (vdisk_->readBlock(blockId, buffer.data(), block_size)) {
+        const BlockId* pointers = reinterpret_cast<const BlockId*>(buffer.data());
+        for (int i = 0; i < pointers_per_block; ++i) {
+            if (pointers[i] == INVALID_BLOCK_ID) continue;
+            if (depth > 1) {
+                collectIndirectTree(pointers[i], depth - 1, blockIds);
+            } else if (sb_manager_->blockReferences(pointers[i]) > 1) {
+                sb_manager_->freeBlock(pointers[i]);
+            } else {
+                blockIds.push_back(pointers[i]);
+            }
+        }
+    } else {
+        std::cerr << "警告 (clearInodeDataBlocks): 无法读取 " << depth << " 级间接块 "
+                  << blockId << " 来释放其指向的块。" << std::endl;
+    }
+    blockIds.push_back(blockId);
+}
 
-    bool inode_changed = false; // 标记inode是否有实质性改变（除了file_size）
-
+// 收集一个 i-node 的全部数据块和间接块到 blockIds，交给 SuperBlockManager::freeBlocks 批量释放；
+// inode 中的块指针和大小随之清空，由调用者写回 (或连同 i-node 一起释放)。
+void DataBlockManager::releaseInodeDataBlocks(Inode &inode, std::vector<BlockId> &blockIds) {
     for (int i = 0; i < NUM_DIRECT_BLOCKS; ++i) {
-        if (inode.direct_blocks[i] != INVALID_BLOCK_ID) {
-            sb_manager_->freeBlock(inode.direct_blocks[i]);
-            inode.direct_blocks[i] = INVALID_BLOCK_ID;
-            inode_changed = true;
+        BlockId &block = inode.direct_blocks[i];
+        if (block == INVALID_BLOCK_ID) continue;
+        if (sb_manager_->blockReferences(block) > 1) {
+            sb_manager_->freeBlock(block);
+        } else {
+            blockIds.push_back(block);
         }
+        block = INVALID_BLOCK_ID;
     }
+    BlockId *indirect_tops[] = {&inode.single_indirect_block, &inode.double_indirect_block, &inode.triple_indirect_block};
+    for (int depth = 1; depth <= 3; ++depth) {
+        BlockId &top = *indirect_tops[depth - 1];
+        if (top != INVALID_BLOCK_ID) {
+            collectIndirectTree(top, depth, blockIds);
+            top = INVALID_BLOCK_ID;
+        }
+    }
+    inode.file_size = 0;
+}
 
-    if (inode.single_indirect_block != INVALID_BLOCK_ID) {
-        std::vector<char> indirect_block_buffer_vec(block_size);
-        if (vdisk_->readBlock(inode.single_indirect_block, indirect_block_buffer_vec.data(), block_size)) {
-            int* indirect_pointers = reinterpret_cast<int*>(indirect_block_buffer_vec.data());
-            for (int i = 0; i < pointers_per_block; ++i) {
-                if (indirect_pointers[i] != INVALID_BLOCK_ID) {
-                    sb_manager_->freeBlock(indirect_pointers[i]);
-                }
+// reflink 克隆: destination (尚无数据块) 复制 source 的块指针和大小，与之共享全部数据块。
+// 只为直接块和三个顶层间接块各增加一个引用，与文件大小无关；间接块之下的引用计数在写入时
+// 才随 copy-on-write 逐级下推 (见 InodeManager::unshareBlock)。
+bool DataBlockManager::shareInodeDataBlocks(const Inode &source, Inode &destination) {
+    if (!vdisk_ || !inode_manager_ || !sb_manager_) return false;
+
+    std::vector<BlockId> roots(source.direct_blocks, source.direct_blocks + NUM_DIRECT_BLOCKS);
+    roots.push_back(source.single_indirect_block);
+    roots.push_back(source.double_indirect_block);
+    roots.push_back(source.triple_indirect_block);
+    for (size_t i = 0; i < roots.size(); ++i) {
+        if (roots[i] != INVALID_BLOCK_ID && !sb_manager_->addBlockReference(roots[i])) {
+            for (size_t j = 0; j < i; ++j) { // 回滚已增加的引用
+                if (roots[j] != INVALID_BLOCK_ID) sb_manager_->freeBlock(roots[j]);
             }
-        } else {
-            std::cerr << "警告 (clearInodeDataBlocks): 无法读取一级间接块 "
-                      << inode.single_indirect_block << " 来释放其指向的数据块。" << std::endl;
+            return false;
         }
-        sb_manager_->freeBlock(inode.single_indirect_block);
-        inode.single_indirect_block = INVALID_BLOCK_ID;
-        inode_changed = true;
     }
 
-    if (inode.double_indirect_block != INVALID_BLOCK_ID) {
-        std::vector<char> l1_indirect_buffer_vec(block_size);
-        if (vdisk_->readBlock(inode.double_indirect_block, l1_indirect_buffer_vec.data(), block_size)) {
-            int* l1_pointers = reinterpret_cast<int*>(l1_indirect_buffer_vec.data());
-            for (int i = 0; i < pointers_per_block; ++i) {
-                if (l1_pointers[i] != INVALID_BLOCK_ID) { 
-                    std::vector<char> l2_indirect_buffer_vec(block_size);
-                    if (vdisk_->readBlock(l1_pointers[i], l2_indirect_buffer_vec.data(), block_size)) {
-                        int* l2_pointers = reinterpret_cast<int*>(l2_indirect_buffer_vec.data());
-                        for (int j = 0; j < pointers_per_block; ++j) {
-                            if (l2_pointers[j] != INVALID_BLOCK_ID) {
-                                sb_manager_->freeBlock(l2_pointers[j]);
-                            }
-                        }
-                    } else {
-                         std::cerr << "警告 (clearInodeDataBlocks): 无法读取二级间接L2块 "
-                                   << l1_pointers[i] << " 来释放其指向的数据块。" << std::endl;
-                    }
-                    sb_manager_->freeBlock(l1_pointers[i]); 
-                }
-            }
-        } else {
-             std::cerr << "警告 (clearInodeDataBlocks): 无法读取二级间接L1块 "
-                       << inode.double_indirect_block << " 来释放其指向的L2块。" << std::endl;
+    std::copy(source.direct_blocks, source.direct_blocks + NUM_DIRECT_BLOCKS, destination.direct_blocks);
+    destination.single_indirect_block = source.single_indirect_block;
+    destination.double_indirect_block = source.double_indirect_block;
+    destination.triple_indirect_block = source.triple_indirect_block;
+    destination.file_size = source.file_size;
+    destination.modification_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (!inode_manager_->writeInode(destination.inode_id, destination)) {
+        std::cerr << "错误 (shareInodeDataBlocks): 无法写回 inode " << destination.inode_id << "。" << std::endl;
+        for (BlockId root : roots) {
+            if (root != INVALID_BLOCK_ID) sb_manager_->freeBlock(root);
         }
-        sb_manager_->freeBlock(inode.double_indirect_block); 
-        inode.double_indirect_block = INVALID_BLOCK_ID;
-        inode_changed = true;
+        return false;
     }
-    
+    return true;
+}
+
+// 清除一个i-node所占用的所有数据块 (一次批量释放)
+void DataBlockManager::clearInodeDataBlocks(Inode &inode) {
+    if (!vdisk_ || !inode_manager_ || !sb_manager_) return;
+
     bool size_was_non_zero = (inode.file_size > 0);
-    inode.file_size = 0;
+    std::vector<BlockId> block_ids;
+    releaseInodeDataBlocks(inode, block_ids);
+    bool inode_changed = !block_ids.empty(); // 标记inode是否有实质性改变（除了file_size）
+    sb_manager_->freeBlocks(std::move(block_ids));
 
     // 如果inode的块指针或文件大小（从非零变为零）发生了改变，则更新时间戳并写回
     if (inode_changed || size_was_non_zero) {
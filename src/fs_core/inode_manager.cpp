@@ -1,5 +1,6 @@
 #include "fs_core/inode_manager.h"
 #include "common_defs.h"
+#include "fs_core/block_geometry.h"
 #include <iostream>
 #include <vector>
 #include <cstring>   // For std::memcpy, std::memset
@@ -7,7 +8,10 @@
 
 // InodeManager 构造函数
 InodeManager::InodeManager(VirtualDisk *vdisk, SuperBlockManager *sbManager)
-    : vdisk_(vdisk), sb_manager_(sbManager)
+    : vdisk_(vdisk), sb_manager_(sbManager),
+      read_inode_(&InodeManager::readInodeFor<DEFAULT_BLOCK_SIZE>),
+      write_inode_(&InodeManager::writeInodeFor<DEFAULT_BLOCK_SIZE>),
+      block_id_for_offset_(&InodeManager::getBlockIdForFileOffsetFor<DEFAULT_BLOCK_SIZE>)
 {
     if (!vdisk_ || !sb_manager_)
     {
@@ -15,8 +19,54 @@ InodeManager::InodeManager(VirtualDisk *vdisk, SuperBlockManager *sbManager)
     }
 }
 
-// 从磁盘读取指定的i-node
+// 按块大小选择编译期实例: 之后的块号换算、i-node 定位都使用常量几何
+bool InodeManager::selectGeometry(int blockSize)
+{
+    return selectBlockGeometry(blockSize, [this](auto geometry)
+                               {
+                                   constexpr int block_size = decltype(geometry)::kBlockSize;
+                                   read_inode_ = &InodeManager::readInodeFor<block_size>;
+                                   write_inode_ = &InodeManager::writeInodeFor<block_size>;
+                                   block_id_for_offset_ = &InodeManager::getBlockIdForFileOffsetFor<block_size>;
+                               });
+}
+
 bool InodeManager::readInode(int inodeId, Inode &inode) const
+{
+    return (this->*read_inode_)(inodeId, inode);
+}
+
+bool InodeManager::writeInode(int inodeId, const Inode &inode)
+{
+    return (this->*write_inode_)(inodeId, inode);
+}
+
+BlockId InodeManager::getBlockIdForFileOffset(Inode &inode, long long offset, bool allocateIfMissing, bool overwriteWholeBlock,
+                                              bool *newlyAllocated)
+{
+    return (this->*block_id_for_offset_)(inode, offset, allocateIfMissing, overwriteWholeBlock, newlyAllocated);
+}
+
+// 遍历目录树前预读: 各 i-node 块去重后交给 VirtualDisk::prefetchBlocks，缺失的块以一批并行读请求读入
+void InodeManager::prefetchInodes(const std::vector<int> &inodeIds)
+{
+    const SuperBlock &sb = sb_manager_->getSuperBlockInfo();
+    int inodes_per_block = sb.block_size / INODE_SIZE_BYTES;
+    std::vector<BlockId> block_ids;
+    block_ids.reserve(inodeIds.size());
+    for (int inode_id : inodeIds)
+    {
+        if (inode_id >= 0 && inode_id < sb.total_inodes)
+        {
+            block_ids.push_back(sb_manager_->inodeChunkBlock(inode_id / inodes_per_block));
+        }
+    }
+    vdisk_->prefetchBlocks(block_ids);
+}
+
+// 从磁盘读取指定的i-node
+template <int BlockSize>
+bool InodeManager::readInodeFor(int inodeId, Inode &inode) const
 {
     if (!vdisk_ || !sb_manager_)
         return false;
@@ -28,34 +78,22 @@ bool InodeManager::readInode(int inodeId, Inode &inode) const
         return false;
     }
 
-    int inode_table_actual_start_block = sb.inode_table_start_block_idx;
-    int inode_size = sb.inode_size;
-    int inodes_per_block = sb.block_size / inode_size;
-
-    if (inodes_per_block == 0)
-    {
-        std::cerr << "错误 (readInode): block_size " << sb.block_size << " 对于 inode_size " << inode_size << " 太小。" << std::endl;
-        return false;
-    }
+    constexpr int inode_size = INODE_SIZE_BYTES; // 超级块中的 inode_size 在加载时已校验
+    constexpr int inodes_per_block = BlockGeometry<BlockSize>::kInodesPerBlock;
 
-    int block_num_for_inode = inode_table_actual_start_block + (inodeId / inodes_per_block);
+    // 每个 i-node 块 (chunk) 占一个磁盘块，块号从超级块管理器的内存索引中取得
+    BlockId block_num_for_inode = sb_manager_->inodeChunkBlock(inodeId / inodes_per_block);
     int offset_in_block = (inodeId % inodes_per_block) * inode_size;
-
-    int inode_table_blocks_count = (sb.total_inodes + inodes_per_block - 1) / inodes_per_block;
-    if (block_num_for_inode >= inode_table_actual_start_block + inode_table_blocks_count ||
-        block_num_for_inode >= sb.first_data_block_idx)
+    if (block_num_for_inode == INVALID_BLOCK_ID)
     {
-        std::cerr << "错误 (readInode): 计算得到的i-node块 " << block_num_for_inode
-                  << " 超出i-node表范围或侵入数据块区域。" << std::endl;
-        std::cerr << "  i-node表起始: " << inode_table_actual_start_block << ", 占用: " << inode_table_blocks_count << " 块." << std::endl;
-        std::cerr << "  第一个数据块: " << sb.first_data_block_idx << std::endl;
+        std::cerr << "错误 (readInode): i-node " << inodeId << " 所在的 i-node 块尚未分配。" << std::endl;
         return false;
     }
 
     // char block_buffer[sb.block_size]; // 原来的问题行
-    std::vector<char> block_buffer_vec(sb.block_size); // 修改后的行
+    AlignedBuffer block_buffer_vec = vdisk_->bufferPool().acquire(BlockSize); // 修改后的行
 
-    if (!vdisk_->readBlock(block_num_for_inode, block_buffer_vec.data(), sb.block_size))
+    if (!vdisk_->readBlock(block_num_for_inode, block_buffer_vec.data(), BlockSize))
     {
         std::cerr << "错误 (readInode): 无法从磁盘读取包含i-node " << inodeId << " 的块 " << block_num_for_inode << "。" << std::endl;
         return false;
@@ -66,7 +104,8 @@ bool InodeManager::readInode(int inodeId, Inode &inode) const
 }
 
 // 将指定的i-node写回磁盘
-bool InodeManager::writeInode(int inodeId, const Inode &inode)
+template <int BlockSize>
+bool InodeManager::writeInodeFor(int inodeId, const Inode &inode)
 {
     if (!vdisk_ || !sb_manager_)
         return false;
@@ -78,33 +117,23 @@ bool InodeManager::writeInode(int inodeId, const Inode &inode)
         return false;
     }
 
-    int inode_table_actual_start_block = sb.inode_table_start_block_idx;
-    int inode_size = sb.inode_size;
-    int inodes_per_block = sb.block_size / inode_size;
-
-    if (inodes_per_block == 0)
-    {
-        std::cerr << "错误 (writeInode): block_size " << sb.block_size << " 对于 inode_size " << inode_size << " 太小。" << std::endl;
-        return false;
-    }
+    constexpr int inode_size = INODE_SIZE_BYTES; // 超级块中的 inode_size 在加载时已校验
+    constexpr int inodes_per_block = BlockGeometry<BlockSize>::kInodesPerBlock;
 
-    int block_num_for_inode = inode_table_actual_start_block + (inodeId / inodes_per_block);
+    // 每个 i-node 块 (chunk) 占一个磁盘块，块号从超级块管理器的内存索引中取得
+    BlockId block_num_for_inode = sb_manager_->inodeChunkBlock(inodeId / inodes_per_block);
     int offset_in_block = (inodeId % inodes_per_block) * inode_size;
-
-    int inode_table_blocks_count = (sb.total_inodes + inodes_per_block - 1) / inodes_per_block;
-    if (block_num_for_inode >= inode_table_actual_start_block + inode_table_blocks_count ||
-        block_num_for_inode >= sb.first_data_block_idx)
+    if (block_num_for_inode == INVALID_BLOCK_ID)
     {
-        std::cerr << "错误 (writeInode): 计算得到的i-node块 " << block_num_for_inode
-                  << " 超出i-node表范围或侵入数据块区域。" << std::endl;
+        std::cerr << "错误 (writeInode): i-node " << inodeId << " 所在的 i-node 块尚未分配。" << std::endl;
         return false;
     }
 
     // char block_buffer[sb.block_size]; // 原来的问题行
-    std::vector<char> block_buffer_vec(sb.block_size); // 修改后的行
+    AlignedBuffer block_buffer_vec = vdisk_->bufferPool().acquire(BlockSize); // 修改后的行
 
     // 为了只修改目标i-node，需要先读取整个块，修改，再写回
-    if (!vdisk_->readBlock(block_num_for_inode, block_buffer_vec.data(), sb.block_size))
+    if (!vdisk_->readBlock(block_num_for_inode, block_buffer_vec.data(), BlockSize))
     {
         std::cerr << "错误 (writeInode): 写入i-node " << inodeId << " 前无法读取块 " << block_num_for_inode << "。" << std::endl;
         return false;
@@ -112,7 +141,7 @@ bool InodeManager::writeInode(int inodeId, const Inode &inode)
 
     std::memcpy(block_buffer_vec.data() + offset_in_block, &inode, sizeof(Inode));
 
-    if (!vdisk_->writeBlock(block_num_for_inode, block_buffer_vec.data(), sb.block_size))
+    if (!vdisk_->writeBlock(block_num_for_inode, block_buffer_vec.data(), BlockSize))
     {
         std::cerr << "错误 (writeInode): 无法将包含i-node " << inodeId << " 的块 " << block_num_for_inode << " 写回磁盘。" << std::endl;
         return false;
@@ -120,13 +149,97 @@ bool InodeManager::writeInode(int inodeId, const Inode &inode)
     return true;
 }
 
+// 分配一个间接块并把其中的指针全部初始化为 INVALID_BLOCK_ID
+// 返回值: 新块号；分配或写入失败时为 INVALID_BLOCK_ID (已回滚分配)
+template <int BlockSize>
+BlockId InodeManager::allocateIndirectBlock()
+{
+    BlockId block_id = sb_manager_->allocateBlock();
+    if (block_id == INVALID_BLOCK_ID)
+    {
+        std::cerr << "错误: 无法为间接块分配新的元数据块。" << std::endl;
+        return INVALID_BLOCK_ID;
+    }
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(BlockSize, false);
+    std::fill_n(reinterpret_cast<BlockId *>(buffer.data()), BlockGeometry<BlockSize>::kPointersPerBlock, INVALID_BLOCK_ID);
+    if (!vdisk_->writeBlock(block_id, buffer.data(), BlockSize))
+    {
+        std::cerr << "错误: 初始化新分配的间接块 " << block_id << " 失败。" << std::endl;
+        sb_manager_->freeBlock(block_id); // 回滚分配
+        return INVALID_BLOCK_ID;
+    }
+    return block_id;
+}
+
+// 写入路径上遇到被共享 (reflink) 的块时，为本文件复制一份并去掉本文件对原块的一个引用。
+// 间接块的副本与原块指向相同的下一级块，因此它的每个子块都多了一处引用: 引用计数由此逐级下推，
+// 克隆时只需在顶层计数。数据块在 copyContents 为 false 时不拷贝旧内容 (调用者会写满整块)。
+// 返回值: 副本的块号；失败时为 INVALID_BLOCK_ID (原块保持不变)
+template <int BlockSize>
+BlockId InodeManager::unshareBlock(BlockId blockId, bool isIndirect, bool copyContents)
+{
+    BlockId copy = sb_manager_->allocateBlock();
+    if (copy == INVALID_BLOCK_ID)
+    {
+        std::cerr << "错误: 无法为共享块 " << blockId << " 分配副本。" << std::endl;
+        return INVALID_BLOCK_ID;
+    }
+    if (isIndirect || copyContents)
+    {
+        AlignedBuffer buffer = vdisk_->bufferPool().acquire(BlockSize, false);
+        if (!vdisk_->readBlock(blockId, buffer.data(), BlockSize))
+        {
+            std::cerr << "错误: 无法读取共享块 " << blockId << "。" << std::endl;
+            sb_manager_->freeBlock(copy);
+            return INVALID_BLOCK_ID;
+        }
+        bool written = isIndirect ? vdisk_->writeBlock(copy, buffer.data(), BlockSize)
+                                  : vdisk_->writeDataBlock(copy, buffer.data(), BlockSize);
+        if (!written)
+        {
+            std::cerr << "错误: 无法写入共享块 " << blockId << " 的副本 " << copy << "。" << std::endl;
+            sb_manager_->freeBlock(copy);
+            return INVALID_BLOCK_ID;
+        }
+        if (isIndirect)
+        {
+            const BlockId *pointers = reinterpret_cast<const BlockId *>(buffer.data());
+            for (long long i = 0; i < BlockGeometry<BlockSize>::kPointersPerBlock; ++i)
+            {
+                if (pointers[i] != INVALID_BLOCK_ID && !sb_manager_->addBlockReference(pointers[i]))
+                {
+                    // 回滚已增加的引用
+                    for (long long j = 0; j < i; ++j)
+                    {
+                        if (pointers[j] != INVALID_BLOCK_ID)
+                        {
+                            sb_manager_->freeBlock(pointers[j]);
+                        }
+                    }
+                    sb_manager_->freeBlock(copy);
+                    return INVALID_BLOCK_ID;
+                }
+            }
+        }
+    }
+    sb_manager_->freeBlock(blockId); // 原块仍被其他文件引用，这里只减少引用数
+    return copy;
+}
+
 // 根据文件内的逻辑偏移量获取对应的数据块号
-int InodeManager::getBlockIdForFileOffset(Inode &inode, long long offset, bool allocateIfMissing)
+// 寻址层级: NUM_DIRECT_BLOCKS 个直接块，之后依次为一级、二级、三级间接块。
+// 间接层级内的下标按每块指针数 (2 的幂) 拆成各级槽位，只用移位和掩码。
+// 顶层间接块号的变化只改动内存中的 inode，由上层 DataBlockManager 或 FileManager 写回。
+// 为写入取块时路径上的共享块逐级复制，返回的数据块只属于本文件。
+template <int BlockSize>
+BlockId InodeManager::getBlockIdForFileOffsetFor(Inode &inode, long long offset, bool allocateIfMissing, bool overwriteWholeBlock,
+                                                 bool *newlyAllocated)
 {
+    using Geometry = BlockGeometry<BlockSize>;
+    if (newlyAllocated)
+        *newlyAllocated = false;
     if (!vdisk_ || !sb_manager_)
         return INVALID_BLOCK_ID;
-    const SuperBlock &sb = sb_manager_->getSuperBlockInfo();
-    int block_size = sb.block_size;
 
     if (offset < 0)
     {
@@ -134,253 +247,139 @@ int InodeManager::getBlockIdForFileOffset(Inode &inode, long long offset, bool a
         return INVALID_BLOCK_ID;
     }
 
-    int logical_block_index = static_cast<int>(offset / block_size);
+    long long logical_block_index = Geometry::blockIndex(offset);
 
     // 1. 处理直接块
     if (logical_block_index < NUM_DIRECT_BLOCKS)
     {
         if (inode.direct_blocks[logical_block_index] == INVALID_BLOCK_ID)
         {
-            if (allocateIfMissing)
+            if (!allocateIfMissing)
             {
-                int new_block_id = sb_manager_->allocateBlock();
-                if (new_block_id == INVALID_BLOCK_ID)
-                {
-                    std::cerr << "错误: 无法为直接块 " << logical_block_index << " 分配新的数据块。" << std::endl;
-                    return INVALID_BLOCK_ID;
-                }
-                inode.direct_blocks[logical_block_index] = new_block_id;
-                // 文件大小和inode的写回由上层DataBlockManager或FileManager处理
+                return INVALID_BLOCK_ID;
+            }
+            BlockId new_block_id = sb_manager_->allocateBlock();
+            if (new_block_id == INVALID_BLOCK_ID)
+            {
+                std::cerr << "错误: 无法为直接块 " << logical_block_index << " 分配新的数据块。" << std::endl;
+                return INVALID_BLOCK_ID;
             }
-            else
+            inode.direct_blocks[logical_block_index] = new_block_id;
+            if (newlyAllocated)
+                *newlyAllocated = true;
+        }
+        else if (allocateIfMissing && sb_manager_->blockReferences(inode.direct_blocks[logical_block_index]) > 1)
+        {
+            BlockId copy = unshareBlock<BlockSize>(inode.direct_blocks[logical_block_index], false, !overwriteWholeBlock);
+            if (copy == INVALID_BLOCK_ID)
             {
                 return INVALID_BLOCK_ID;
             }
+            inode.direct_blocks[logical_block_index] = copy;
         }
         return inode.direct_blocks[logical_block_index];
     }
 
-    int pointers_per_block = block_size / sizeof(int);
-    if (pointers_per_block == 0)
+    // 2. 确定间接层级 (depth = 1/2/3) 和层级内的下标
+    constexpr long long pointers_per_block = Geometry::kPointersPerBlock;
+    constexpr int pointer_shift = Geometry::kPointerShift;
+    long long index = logical_block_index - NUM_DIRECT_BLOCKS;
+    BlockId *top_block;
+    int depth;
+    if (index < pointers_per_block)
+    {
+        top_block = &inode.single_indirect_block;
+        depth = 1;
+    }
+    else if ((index -= pointers_per_block) < pointers_per_block * pointers_per_block)
+    {
+        top_block = &inode.double_indirect_block;
+        depth = 2;
+    }
+    else if ((index -= pointers_per_block * pointers_per_block) < pointers_per_block * pointers_per_block * pointers_per_block)
+    {
+        top_block = &inode.triple_indirect_block;
+        depth = 3;
+    }
+    else
     {
-        std::cerr << "错误 (getBlockIdForFileOffset): block_size " << block_size << " 太小，无法容纳任何块指针。" << std::endl;
+        std::cerr << "错误: 逻辑块索引 " << logical_block_index << " 超出文件系统支持的最大范围。" << std::endl;
         return INVALID_BLOCK_ID;
     }
 
-    // 2. 处理一级间接块
-    int single_indirect_start_idx = NUM_DIRECT_BLOCKS;
-    if (logical_block_index < single_indirect_start_idx + pointers_per_block)
+    if (*top_block == INVALID_BLOCK_ID)
     {
-        if (inode.single_indirect_block == INVALID_BLOCK_ID)
+        if (!allocateIfMissing)
         {
-            if (allocateIfMissing)
-            {
-                int new_indirect_block_id = sb_manager_->allocateBlock();
-                if (new_indirect_block_id == INVALID_BLOCK_ID)
-                {
-                    std::cerr << "错误: 无法为一级间接块本身分配新的元数据块。" << std::endl;
-                    return INVALID_BLOCK_ID;
-                }
-                inode.single_indirect_block = new_indirect_block_id;
-
-                // 初始化新分配的一级间接块 (所有指针设为INVALID_BLOCK_ID)
-                std::vector<char> indirect_block_buffer_vec(block_size);
-                std::vector<int> indirect_pointers_init_vec(pointers_per_block, INVALID_BLOCK_ID);
-                std::memcpy(indirect_block_buffer_vec.data(), indirect_pointers_init_vec.data(), pointers_per_block * sizeof(int));
-                // 如果块大小大于指针数组大小，用0填充剩余部分
-                if (static_cast<size_t>(block_size) > pointers_per_block * sizeof(int))
-                {
-                    std::memset(indirect_block_buffer_vec.data() + pointers_per_block * sizeof(int), 0,
-                                block_size - (pointers_per_block * sizeof(int)));
-                }
-
-                if (!vdisk_->writeBlock(inode.single_indirect_block, indirect_block_buffer_vec.data(), block_size))
-                {
-                    std::cerr << "错误: 初始化新分配的一级间接块 " << inode.single_indirect_block << " 失败。" << std::endl;
-                    sb_manager_->freeBlock(inode.single_indirect_block); // 回滚分配
-                    inode.single_indirect_block = INVALID_BLOCK_ID;
-                    return INVALID_BLOCK_ID;
-                }
-            }
-            else
-            {
-                return INVALID_BLOCK_ID; // 一级间接块不存在且不分配
-            }
-        }
-
-        // 读取一级间接块
-        std::vector<char> indirect_block_buffer_vec(block_size);
-        if (!vdisk_->readBlock(inode.single_indirect_block, indirect_block_buffer_vec.data(), block_size))
-        {
-            std::cerr << "错误: 无法读取一级间接块 " << inode.single_indirect_block << "。" << std::endl;
             return INVALID_BLOCK_ID;
         }
-
-        int *indirect_pointers = reinterpret_cast<int *>(indirect_block_buffer_vec.data());
-        int index_in_indirect_block = logical_block_index - single_indirect_start_idx;
-
-        if (indirect_pointers[index_in_indirect_block] == INVALID_BLOCK_ID)
+        BlockId new_top_block = allocateIndirectBlock<BlockSize>();
+        if (new_top_block == INVALID_BLOCK_ID)
         {
-            if (allocateIfMissing)
-            {
-                int new_data_block_id = sb_manager_->allocateBlock();
-                if (new_data_block_id == INVALID_BLOCK_ID)
-                {
-                    std::cerr << "错误: 无法为一级间接寻址的数据块分配新块 (逻辑块 " << logical_block_index << ")。" << std::endl;
-                    return INVALID_BLOCK_ID;
-                }
-                indirect_pointers[index_in_indirect_block] = new_data_block_id;
-                // 写回修改后的一级间接块
-                if (!vdisk_->writeBlock(inode.single_indirect_block, indirect_block_buffer_vec.data(), block_size))
-                {
-                    std::cerr << "错误: 更新一级间接块 " << inode.single_indirect_block << " 失败。" << std::endl;
-                    sb_manager_->freeBlock(new_data_block_id); // 回滚数据块分配
-                    // indirect_pointers[index_in_indirect_block] 已经在内存中，但磁盘未更新
-                    return INVALID_BLOCK_ID;
-                }
-            }
-            else
-            {
-                return INVALID_BLOCK_ID; // 数据块不存在且不分配
-            }
+            return INVALID_BLOCK_ID;
         }
-        return indirect_pointers[index_in_indirect_block];
+        *top_block = new_top_block;
     }
-
-    // 3. 处理二级间接块
-    int double_indirect_start_idx = single_indirect_start_idx + pointers_per_block;
-    if (logical_block_index < double_indirect_start_idx + pointers_per_block * pointers_per_block)
+    else if (allocateIfMissing && sb_manager_->blockReferences(*top_block) > 1)
     {
-        // 检查二级间接块本身（L1间接块）是否存在
-        if (inode.double_indirect_block == INVALID_BLOCK_ID)
+        BlockId copy = unshareBlock<BlockSize>(*top_block, true, true);
+        if (copy == INVALID_BLOCK_ID)
         {
-            if (allocateIfMissing)
-            {
-                int new_l1_indirect_id = sb_manager_->allocateBlock();
-                if (new_l1_indirect_id == INVALID_BLOCK_ID)
-                {
-                    std::cerr << "错误: 无法为二级间接块的L1元数据块分配新块。" << std::endl;
-                    return INVALID_BLOCK_ID;
-                }
-                inode.double_indirect_block = new_l1_indirect_id;
-
-                std::vector<char> l1_buffer_vec(block_size);
-                std::vector<int> l1_pointers_init_vec(pointers_per_block, INVALID_BLOCK_ID);
-                std::memcpy(l1_buffer_vec.data(), l1_pointers_init_vec.data(), pointers_per_block * sizeof(int));
-                if (static_cast<size_t>(block_size) > pointers_per_block * sizeof(int))
-                {
-                    std::memset(l1_buffer_vec.data() + pointers_per_block * sizeof(int), 0,
-                                block_size - (pointers_per_block * sizeof(int)));
-                }
-
-                if (!vdisk_->writeBlock(inode.double_indirect_block, l1_buffer_vec.data(), block_size))
-                {
-                    std::cerr << "错误: 初始化新分配的二级间接L1块 " << inode.double_indirect_block << " 失败。" << std::endl;
-                    sb_manager_->freeBlock(inode.double_indirect_block);
-                    inode.double_indirect_block = INVALID_BLOCK_ID;
-                    return INVALID_BLOCK_ID;
-                }
-            }
-            else
-            {
-                return INVALID_BLOCK_ID;
-            }
+            return INVALID_BLOCK_ID;
         }
+        *top_block = copy;
+    }
 
-        // 读取L1间接块
-        std::vector<char> l1_buffer_vec(block_size);
-        if (!vdisk_->readBlock(inode.double_indirect_block, l1_buffer_vec.data(), block_size))
+    // 3. 逐级向下: 每级读出间接块，取对应槽位；缺失时分配下一级 (最后一级为数据块)，
+    //    共享时复制下一级，然后写回本级
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(BlockSize, false);
+    BlockId *pointers = reinterpret_cast<BlockId *>(buffer.data());
+    BlockId current = *top_block;
+    for (int level = depth - 1; level >= 0; --level)
+    {
+        int slot = static_cast<int>((index >> (level * pointer_shift)) & (pointers_per_block - 1));
+        if (!vdisk_->readBlock(current, buffer.data(), BlockSize))
         {
-            std::cerr << "错误: 无法读取二级间接块的L1元数据块 " << inode.double_indirect_block << "。" << std::endl;
+            std::cerr << "错误: 无法读取间接块 " << current << "。" << std::endl;
             return INVALID_BLOCK_ID;
         }
-        int *l1_pointers = reinterpret_cast<int *>(l1_buffer_vec.data());
-        int index_in_l1 = (logical_block_index - double_indirect_start_idx) / pointers_per_block;
-
-        // 检查L2间接块是否存在
-        if (l1_pointers[index_in_l1] == INVALID_BLOCK_ID)
+        if (pointers[slot] == INVALID_BLOCK_ID)
         {
-            if (allocateIfMissing)
+            if (!allocateIfMissing)
             {
-                int new_l2_indirect_id = sb_manager_->allocateBlock();
-                if (new_l2_indirect_id == INVALID_BLOCK_ID)
-                {
-                    std::cerr << "错误: 无法为二级间接块的L2元数据块分配新块。" << std::endl;
-                    return INVALID_BLOCK_ID;
-                }
-                l1_pointers[index_in_l1] = new_l2_indirect_id;
-
-                std::vector<char> l2_buffer_vec(block_size);
-                std::vector<int> l2_pointers_init_vec(pointers_per_block, INVALID_BLOCK_ID);
-                std::memcpy(l2_buffer_vec.data(), l2_pointers_init_vec.data(), pointers_per_block * sizeof(int));
-                if (static_cast<size_t>(block_size) > pointers_per_block * sizeof(int))
-                {
-                    std::memset(l2_buffer_vec.data() + pointers_per_block * sizeof(int), 0,
-                                block_size - (pointers_per_block * sizeof(int)));
-                }
-
-                if (!vdisk_->writeBlock(l1_pointers[index_in_l1], l2_buffer_vec.data(), block_size))
-                { // Write L2 content
-                    std::cerr << "错误: 初始化新分配的二级间接L2块 " << l1_pointers[index_in_l1] << " 失败。" << std::endl;
-                    sb_manager_->freeBlock(l1_pointers[index_in_l1]); // Free L2 block
-                    l1_pointers[index_in_l1] = INVALID_BLOCK_ID;      // Rollback pointer in L1 (memory)
-                    // Note: L1 block on disk is not updated yet to reflect this rollback
-                    return INVALID_BLOCK_ID;
-                }
-                // 写回修改后的L1间接块 (now containing pointer to L2)
-                if (!vdisk_->writeBlock(inode.double_indirect_block, l1_buffer_vec.data(), block_size))
-                {
-                    std::cerr << "错误: 更新二级间接块的L1元数据块 " << inode.double_indirect_block << " 失败。" << std::endl;
-                    sb_manager_->freeBlock(new_l2_indirect_id);  // Rollback L2 allocation
-                    l1_pointers[index_in_l1] = INVALID_BLOCK_ID; // Rollback pointer in L1 (memory)
-                    return INVALID_BLOCK_ID;
-                }
+                return INVALID_BLOCK_ID;
+            }
+            BlockId child = (level == 0) ? sb_manager_->allocateBlock() : allocateIndirectBlock<BlockSize>();
+            if (child == INVALID_BLOCK_ID)
+            {
+                std::cerr << "错误: 无法为逻辑块 " << logical_block_index << " 分配新块。" << std::endl;
+                return INVALID_BLOCK_ID;
             }
-            else
+            pointers[slot] = child;
+            if (!vdisk_->writeBlock(current, buffer.data(), BlockSize))
             {
+                std::cerr << "错误: 更新间接块 " << current << " 失败。" << std::endl;
+                sb_manager_->freeBlock(child); // 回滚分配 (若为间接块，其内容尚无指针)
                 return INVALID_BLOCK_ID;
             }
+            if (level == 0 && newlyAllocated)
+                *newlyAllocated = true;
         }
-
-        // 读取L2间接块
-        int l2_block_id = l1_pointers[index_in_l1];
-        std::vector<char> l2_buffer_vec(block_size);
-        if (!vdisk_->readBlock(l2_block_id, l2_buffer_vec.data(), block_size))
+        else if (allocateIfMissing && sb_manager_->blockReferences(pointers[slot]) > 1)
         {
-            std::cerr << "错误: 无法读取二级间接块的L2元数据块 " << l2_block_id << "。" << std::endl;
-            return INVALID_BLOCK_ID;
-        }
-        int *l2_pointers = reinterpret_cast<int *>(l2_buffer_vec.data());
-        int index_in_l2 = (logical_block_index - double_indirect_start_idx) % pointers_per_block;
-
-        // 检查实际数据块是否存在
-        if (l2_pointers[index_in_l2] == INVALID_BLOCK_ID)
-        {
-            if (allocateIfMissing)
+            BlockId copy = unshareBlock<BlockSize>(pointers[slot], level > 0, level > 0 || !overwriteWholeBlock);
+            if (copy == INVALID_BLOCK_ID)
             {
-                int new_data_block_id = sb_manager_->allocateBlock();
-                if (new_data_block_id == INVALID_BLOCK_ID)
-                {
-                    std::cerr << "错误: 无法为二级间接寻址的数据块分配新块 (逻辑块 " << logical_block_index << ")。" << std::endl;
-                    return INVALID_BLOCK_ID;
-                }
-                l2_pointers[index_in_l2] = new_data_block_id;
-                // 写回修改后的L2间接块
-                if (!vdisk_->writeBlock(l2_block_id, l2_buffer_vec.data(), block_size))
-                {
-                    std::cerr << "错误: 更新二级间接块的L2元数据块 " << l2_block_id << " 失败。" << std::endl;
-                    sb_manager_->freeBlock(new_data_block_id); // Rollback data block allocation
-                    return INVALID_BLOCK_ID;
-                }
+                return INVALID_BLOCK_ID;
             }
-            else
+            pointers[slot] = copy;
+            if (!vdisk_->writeBlock(current, buffer.data(), BlockSize))
             {
+                std::cerr << "错误: 更新间接块 " << current << " 失败。" << std::endl;
                 return INVALID_BLOCK_ID;
             }
         }
-        return l2_pointers[index_in_l2];
+        current = pointers[slot];
     }
-
-    std::cerr << "错误: 逻辑块索引 " << logical_block_index << " 超出文件系统支持的最大范围。" << std::endl;
-    return INVALID_BLOCK_ID;
+    return current;
 }
@@ -0,0 +1,417 @@
+#include "fs_core/journal.h"
+#include "fs_core/virtual_disk.h"
+#include "data_structures.h"
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    const unsigned long long CHECKSUM_SEED = 14695981039346656037ULL; // FNV-1a 64 位初值
+
+    // FNV-1a: 依次累加事务中每个块的块号和块映像
+    unsigned long long checksumUpdate(unsigned long long hash, const void *data, size_t length)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    void fillHeader(JournalBlockHeader &header, JournalBlockType type, long long sequence)
+    {
+        header.magic = JOURNAL_MAGIC_NUMBER;
+        header.type = type;
+        header.sequence = sequence;
+    }
+
+    bool isHeader(const JournalBlockHeader &header, JournalBlockType type, long long sequence)
+    {
+        return header.magic == JOURNAL_MAGIC_NUMBER && header.type == type && header.sequence == sequence;
+    }
+}
+
+Journal::Journal(VirtualDisk *vdisk)
+    : vdisk_(vdisk), enabled_(false), start_block_(INVALID_BLOCK_ID), blocks_count_(0),
+      first_sequence_(1), next_sequence_(1), head_(INVALID_BLOCK_ID), open_handles_(0)
+{
+}
+
+bool Journal::enabled() const
+{
+    return enabled_;
+}
+
+int Journal::descriptorCapacity() const
+{
+    return static_cast<int>((vdisk_->blockSize_ - sizeof(JournalDescriptor)) / BLOCK_ID_TYPE_SIZE);
+}
+
+// 运行中的事务不超过日志的四分之一，也不钉住超过半个块缓存
+size_t Journal::commitThreshold() const
+{
+    size_t by_journal = static_cast<size_t>(blocks_count_ - 1) / 4;
+    size_t by_cache = vdisk_->cache_.capacity() / 2;
+    return std::max<size_t>(1, std::min(by_journal, by_cache));
+}
+
+// 写日志超级块并等待落盘: 日志从 first_sequence_ 号事务开始
+bool Journal::writeSuperBlock()
+{
+    AlignedBuffer buffer = vdisk_->buffer_pool_.acquire(vdisk_->blockSize_);
+    fillHeader(*reinterpret_cast<JournalBlockHeader *>(buffer.data()), JournalBlockType::SUPERBLOCK, first_sequence_);
+    if (!vdisk_->writeToDisk(start_block_, 1, buffer.data()) || !vdisk_->flushDeviceLocked())
+    {
+        std::cerr << "错误: 无法写入日志超级块 " << start_block_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 初始化空日志: 除日志超级块外还清零第一个日志块，旧文件系统残留的同序号事务不会被误认
+bool Journal::format(BlockId startBlockId, int blockCount)
+{
+    releaseRunning();
+    start_block_ = startBlockId;
+    blocks_count_ = blockCount;
+    first_sequence_ = next_sequence_ = 1;
+    head_ = start_block_ + 1;
+    logged_.clear();
+
+    AlignedBuffer zero = vdisk_->buffer_pool_.acquire(vdisk_->blockSize_);
+    if (!vdisk_->writeToDisk(head_, 1, zero.data()) || !writeSuperBlock())
+    {
+        enabled_ = false;
+        return false;
+    }
+    enabled_ = true;
+    return true;
+}
+
+// 挂载时重放日志: 从日志超级块记录的序号起依次读取事务，描述块、块映像和提交块齐全且校验和一致的
+// 事务写回原位置；遇到第一个不完整的事务 (或旧的、序号不连续的内容) 即停止。
+// 重放后日志被清空，新事务从下一个序号开始。
+bool Journal::recover(BlockId startBlockId, int blockCount)
+{
+    releaseRunning();
+    enabled_ = false;
+    start_block_ = startBlockId;
+    blocks_count_ = blockCount;
+    logged_.clear();
+
+    int block_size = vdisk_->blockSize_;
+    BlockId end = start_block_ + blocks_count_;
+    AlignedBuffer buffer = vdisk_->buffer_pool_.acquire(block_size);
+    const JournalBlockHeader *header = reinterpret_cast<const JournalBlockHeader *>(buffer.data());
+    if (!vdisk_->readFromDisk(start_block_, 1, buffer.data()) || header->magic != JOURNAL_MAGIC_NUMBER ||
+        header->type != JournalBlockType::SUPERBLOCK)
+    {
+        std::cerr << "错误: 块 " << start_block_ << " 处没有有效的日志超级块。" << std::endl;
+        return false;
+    }
+
+    long long sequence = header->sequence;
+    BlockId position = start_block_ + 1;
+    int replayed = 0;
+    int per_descriptor = descriptorCapacity();
+    AlignedBuffer image = vdisk_->buffer_pool_.acquire(block_size);
+    while (position < end)
+    {
+        // 收集一个事务的所有 (原位置, 日志中位置)，直到遇到它的提交块
+        std::vector<std::pair<BlockId, BlockId>> images;
+        BlockId cursor = position;
+        bool complete = false;
+        while (cursor < end && vdisk_->readFromDisk(cursor, 1, buffer.data()))
+        {
+            if (isHeader(*header, JournalBlockType::COMMIT, sequence) && !images.empty())
+            {
+                const JournalCommit *commit = reinterpret_cast<const JournalCommit *>(buffer.data());
+                unsigned long long expected = commit->checksum;
+                complete = commit->block_count == static_cast<long long>(images.size());
+                unsigned long long checksum = CHECKSUM_SEED;
+                for (size_t i = 0; complete && i < images.size(); ++i)
+                {
+                    complete = vdisk_->readFromDisk(images[i].second, 1, image.data());
+                    checksum = checksumUpdate(checksum, &images[i].first, sizeof(BlockId));
+                    checksum = checksumUpdate(checksum, image.data(), block_size);
+                }
+                complete = complete && checksum == expected;
+                break;
+            }
+            const JournalDescriptor *descriptor = reinterpret_cast<const JournalDescriptor *>(buffer.data());
+            if (!isHeader(*header, JournalBlockType::DESCRIPTOR, sequence) || descriptor->count <= 0 ||
+                descriptor->count > per_descriptor || cursor + 1 + descriptor->count >= end)
+            {
+                break;
+            }
+            for (long long i = 0; i < descriptor->count; ++i)
+            {
+                BlockId home = descriptor->block_ids[i];
+                if (home < 0 || home >= vdisk_->totalBlocks_ || (home >= start_block_ && home < end))
+                {
+                    images.clear();
+                    cursor = end; // 描述块损坏: 当作不完整的事务
+                    break;
+                }
+                images.push_back({home, cursor + 1 + i});
+            }
+            if (cursor != end)
+            {
+                cursor += 1 + descriptor->count;
+            }
+        }
+        if (!complete)
+        {
+            break;
+        }
+
+        for (const auto &entry : images)
+        {
+            if (!vdisk_->readFromDisk(entry.second, 1, image.data()) || !vdisk_->writeToDisk(entry.first, 1, image.data()))
+            {
+                std::cerr << "错误: 重放日志事务 " << sequence << " 时写回块 " << entry.first << " 失败。" << std::endl;
+                return false;
+            }
+            vdisk_->cache_.invalidate(entry.first);
+        }
+        ++replayed;
+        ++sequence;
+        position = cursor + 1;
+    }
+    if (replayed > 0)
+    {
+        std::cout << "信息: 已重放 " << replayed << " 个日志事务。" << std::endl;
+        if (!vdisk_->flushDeviceLocked())
+        {
+            return false;
+        }
+    }
+
+    first_sequence_ = next_sequence_ = sequence;
+    head_ = start_block_ + 1;
+    if (!writeSuperBlock())
+    {
+        return false;
+    }
+    enabled_ = true;
+    return true;
+}
+
+void Journal::disable()
+{
+    releaseRunning();
+    logged_.clear();
+    ordered_.clear();
+    enabled_ = false;
+}
+
+void Journal::releaseRunning()
+{
+    for (BlockId block_id : running_)
+    {
+        vdisk_->cache_.unpin(block_id);
+    }
+    running_.clear();
+}
+
+// 登记在打开的事务中写入的块。文件数据块 (isData) 不经日志，只记下来在提交前写回，
+// 除非该块在日志中还有旧的元数据映像: 否则重放时旧映像会覆盖后来写入的数据。
+void Journal::recordWrite(BlockId blockId, bool isData)
+{
+    if (!enabled_ || open_handles_ == 0)
+    {
+        return;
+    }
+    if (isData && logged_.count(blockId) == 0 && running_.count(blockId) == 0)
+    {
+        ordered_.insert(blockId);
+        return;
+    }
+    if (running_.empty())
+    {
+        running_since_ = std::chrono::steady_clock::now();
+    }
+    if (vdisk_->cache_.pin(blockId))
+    {
+        running_.insert(blockId);
+    }
+}
+
+bool Journal::runningFull() const
+{
+    return enabled_ && running_.size() >= commitThreshold();
+}
+
+bool Journal::commitDue(std::chrono::steady_clock::time_point now) const
+{
+    return enabled_ && open_handles_ == 0 && !running_.empty() &&
+           (runningFull() ||
+            now - running_since_ >= std::chrono::milliseconds(JOURNAL_COMMIT_INTERVAL_MS));
+}
+
+bool Journal::hasRunning() const
+{
+    return !running_.empty();
+}
+
+int Journal::openHandles() const
+{
+    return open_handles_;
+}
+
+void Journal::addHandle()
+{
+    ++open_handles_;
+}
+
+void Journal::dropHandle()
+{
+    --open_handles_;
+}
+
+// 写回运行中的事务写入的文件数据块并落盘。必须先于提交块持久: 否则崩溃后重放出的 i-node
+// 已有新的大小和块指针，块里却还是旧内容 (可能是其他已删除文件的数据)。
+// 已被淘汰或刷写线程写回的块不再是脏块，这里跳过，但仍由这次 fdatasync 落盘。
+bool Journal::writeOrderedData()
+{
+    if (ordered_.empty())
+    {
+        return true;
+    }
+    std::vector<BlockId> block_ids(ordered_.begin(), ordered_.end());
+    ordered_.clear();
+    if (!vdisk_->writeBackLocked(block_ids) || !vdisk_->flushDeviceLocked())
+    {
+        std::cerr << "错误: 提交日志事务前写回文件数据失败。" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 提交运行中的事务: 先写回事务写入的文件数据块 (ordered 模式)，再把描述块、块映像和提交块
+// 作为一个连续的写请求写到日志头部，fdatasync 后事务即持久。
+// 之后这些块解除钉住，成为普通脏块，由刷写线程写回原位置。
+// 调用者保证没有打开的事务，因此缓存中这些块的内容正好是本事务的结果。
+bool Journal::commit()
+{
+    if (!enabled_)
+    {
+        return true;
+    }
+    if (running_.empty())
+    {
+        ordered_.clear(); // 没有元数据要提交，数据块照常由刷写线程写回
+        return true;
+    }
+    if (!writeOrderedData())
+    {
+        return false;
+    }
+    int block_size = vdisk_->blockSize_;
+    long long count = static_cast<long long>(running_.size());
+    int per_descriptor = descriptorCapacity();
+    long long descriptors = (count + per_descriptor - 1) / per_descriptor;
+    long long needed = count + descriptors + 1;
+    BlockId end = start_block_ + blocks_count_;
+
+    bool overlaps_log = std::any_of(running_.begin(), running_.end(),
+                                    [this](BlockId block_id) { return logged_.count(block_id) != 0; });
+    if (needed > blocks_count_ - 1 || (head_ + needed > end && overlaps_log))
+    {
+        // 日志装不下这个事务，或者腾出空间会丢掉这些块已提交的旧版本: 只能直接写回原位置并落盘。
+        // 先做检查点清空日志，否则重放时这些块的旧映像会覆盖原位置的新内容。
+        // 这样写回不具备原子性 (崩溃时可能只留下一部分)，因此报告失败。
+        std::cerr << "错误: 日志事务包含 " << count << " 个块，超出日志剩余空间，已直接写回原位置 (不具备原子性)。" << std::endl;
+        std::vector<BlockId> block_ids(running_.begin(), running_.end());
+        bool written = checkpoint();
+        releaseRunning();
+        written = vdisk_->writeBackLocked(block_ids) && vdisk_->flushDeviceLocked() && written;
+        if (!written)
+        {
+            std::cerr << "错误: 日志事务 " << next_sequence_ << " 的块写回原位置失败。" << std::endl;
+        }
+        return false;
+    }
+    if (head_ + needed > end && !checkpoint())
+    {
+        return false;
+    }
+
+    AlignedBuffer buffer = vdisk_->buffer_pool_.acquire(static_cast<size_t>(needed) * block_size);
+    char *cursor = buffer.data();
+    unsigned long long checksum = CHECKSUM_SEED;
+    auto it = running_.begin();
+    for (long long done = 0; done < count;)
+    {
+        JournalDescriptor *descriptor = reinterpret_cast<JournalDescriptor *>(cursor);
+        fillHeader(descriptor->header, JournalBlockType::DESCRIPTOR, next_sequence_);
+        descriptor->count = std::min<long long>(per_descriptor, count - done);
+        cursor += block_size;
+        for (long long i = 0; i < descriptor->count; ++i, ++it, cursor += block_size)
+        {
+            descriptor->block_ids[i] = *it;
+            if (!vdisk_->cache_.lookup(*it, cursor))
+            {
+                std::cerr << "错误: 日志事务中的块 " << *it << " 不在块缓存中。" << std::endl;
+                return false;
+            }
+            checksum = checksumUpdate(checksum, &*it, sizeof(BlockId));
+            checksum = checksumUpdate(checksum, cursor, block_size);
+        }
+        done += descriptor->count;
+    }
+    JournalCommit *commit_block = reinterpret_cast<JournalCommit *>(cursor);
+    fillHeader(commit_block->header, JournalBlockType::COMMIT, next_sequence_);
+    commit_block->block_count = count;
+    commit_block->checksum = checksum;
+
+    if (!vdisk_->writeToDisk(head_, static_cast<int>(needed), buffer.data()) || !vdisk_->flushDeviceLocked())
+    {
+        std::cerr << "错误: 写入日志事务 " << next_sequence_ << " 失败。" << std::endl;
+        return false;
+    }
+    head_ += needed;
+    ++next_sequence_;
+    logged_.insert(running_.begin(), running_.end());
+    releaseRunning();
+
+    // 剩余空间不到一半时趁没有钉住的块做检查点，下一次提交不必在钉住块的情况下腾空间
+    if (end - head_ < (blocks_count_ - 1) / 2)
+    {
+        return checkpoint();
+    }
+    return true;
+}
+
+// 检查点: 把未钉住的脏块 (包括所有已提交事务的块) 写回原位置并落盘，之后日志中的事务都不再需要，
+// 日志从开头重新记录，序号继续递增，旧内容因序号不符不会被重放。
+bool Journal::checkpoint()
+{
+    if (!enabled_ || head_ == start_block_ + 1)
+    {
+        return true;
+    }
+    if (!vdisk_->writeBackAllLocked() || !vdisk_->flushDeviceLocked())
+    {
+        std::cerr << "错误: 日志检查点写回失败。" << std::endl;
+        return false;
+    }
+    first_sequence_ = next_sequence_;
+    head_ = start_block_ + 1;
+    logged_.clear();
+    ordered_.clear(); // 脏块已全部写回并落盘
+    return writeSuperBlock();
+}
+
+JournalTransaction::JournalTransaction(VirtualDisk &vdisk) : vdisk_(vdisk)
+{
+    vdisk_.beginTransaction();
+}
+
+JournalTransaction::~JournalTransaction()
+{
+    vdisk_.endTransaction();
+}
@@ -0,0 +1,690 @@
+#include "fs_core/log_structured_store.h"
+#include "fs_core/virtual_disk.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace
+{
+    const unsigned long long CHECKSUM_SEED = 14695981039346656037ULL; // FNV-1a 64 位初值
+
+    unsigned long long checksumUpdate(unsigned long long hash, const void *data, size_t length)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // 前滚时收集的部分段
+    struct RolledPartial
+    {
+        long long sequence;
+        BlockId first_block;
+        std::vector<BlockId> block_ids;
+    };
+}
+
+LogStructuredStore::LogStructuredStore(VirtualDisk *vdisk)
+    : vdisk_(vdisk), header_(), current_segment_(-1), current_offset_(0), next_sequence_(1),
+      segments_since_checkpoint_(0), cleaning_(false)
+{
+}
+
+long long LogStructuredStore::logicalBlocks() const
+{
+    return header_.logical_blocks;
+}
+
+int LogStructuredStore::summaryCapacity() const
+{
+    return static_cast<int>((vdisk_->blockSize_ - sizeof(LogSummary)) / BLOCK_ID_TYPE_SIZE);
+}
+
+// 一个部分段最多登记的块数: 受摘要块容量限制，且要能放进一个空段
+size_t LogStructuredStore::pendingCapacity() const
+{
+    return static_cast<size_t>(std::min<long long>(summaryCapacity(), header_.segment_blocks - 1));
+}
+
+int LogStructuredStore::mapEntriesPerBlock() const
+{
+    return static_cast<int>(vdisk_->blockSize_ / BLOCK_ID_TYPE_SIZE);
+}
+
+BlockId LogStructuredStore::segmentStart(long long segment) const
+{
+    return header_.segments_start_block + segment * header_.segment_blocks;
+}
+
+long long LogStructuredStore::segmentOf(BlockId physicalBlock) const
+{
+    return (physicalBlock - header_.segments_start_block) / header_.segment_blocks;
+}
+
+unsigned long long LogStructuredStore::summaryChecksum(const LogSummary &summary) const
+{
+    unsigned long long checksum = checksumUpdate(CHECKSUM_SEED, &header_.log_id, sizeof(header_.log_id));
+    checksum = checksumUpdate(checksum, &summary.sequence, sizeof(summary.sequence));
+    checksum = checksumUpdate(checksum, &summary.count, sizeof(summary.count));
+    return checksumUpdate(checksum, summary.block_ids, static_cast<size_t>(summary.count) * BLOCK_ID_TYPE_SIZE);
+}
+
+size_t LogStructuredStore::freeSegmentCount() const
+{
+    return free_segments_.size() + recently_freed_.size();
+}
+
+// 按日志头建立空的内存状态: 全部逻辑块未映射，全部段空闲
+void LogStructuredStore::reset()
+{
+    map_.assign(header_.logical_blocks, INVALID_BLOCK_ID);
+    live_.assign(header_.segment_count, 0);
+    free_.assign(header_.segment_count, 1);
+    free_segments_.clear();
+    recently_freed_.clear();
+    for (long long segment = header_.segment_count - 1; segment >= 0; --segment)
+    {
+        free_segments_.push_back(segment); // 从低地址的段开始使用
+    }
+    dirty_map_blocks_.clear();
+    current_segment_ = -1;
+    current_offset_ = 0;
+    next_sequence_ = 1;
+    segments_since_checkpoint_ = 0;
+    cleaning_ = false;
+    pending_ids_.clear();
+    pending_slots_.clear();
+    pending_data_ = vdisk_->buffer_pool_.acquire(pendingCapacity() * vdisk_->blockSize_, false);
+}
+
+// 格式化: 只写日志头。映射区和段中旧映像的内容不清零 (映射区按 map_initialized_blocks 只读写过的部分，
+// 旧摘要的校验和因 log_id 不同而不成立)，工作量与磁盘大小无关。
+// 逻辑块数按段空间扣除保留段、当前段和 LOG_OVERPROVISION_PERCENT 的余量计算，保证清理总能腾出空间。
+bool LogStructuredStore::format(long long physicalBlocks)
+{
+    long long block_size = vdisk_->blockSize_;
+    long long segment_blocks = std::max<long long>(LOG_MIN_SEGMENT_BLOCKS, LOG_SEGMENT_BYTES / block_size);
+    long long segments = (physicalBlocks - 1) / segment_blocks;
+    long long logical = 0;
+    long long map_blocks = 0;
+    // 映射区的大小取决于逻辑块数: 第一轮按全部空间估算映射区并扣掉它占用的段，第二轮只会更小
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        long long usable = std::max<long long>(0, segments - LOG_RESERVED_SEGMENTS - 1);
+        logical = std::min(LOG_MAX_LOGICAL_BLOCKS, usable * (segment_blocks - 1) * (100 - LOG_OVERPROVISION_PERCENT) / 100);
+        map_blocks = (logical * BLOCK_ID_TYPE_SIZE + block_size - 1) / block_size;
+        segments = std::min(segments, (physicalBlocks - 1 - map_blocks) / segment_blocks);
+    }
+    if (logical <= 0 || segments <= LOG_RESERVED_SEGMENTS + 1)
+    {
+        std::cerr << "错误: 磁盘太小，无法使用日志结构布局 (需要至少 " << LOG_RESERVED_SEGMENTS + 2 << " 个 "
+                  << segment_blocks * block_size << " 字节的段)。" << std::endl;
+        return false;
+    }
+    if (logical == LOG_MAX_LOGICAL_BLOCKS)
+    {
+        std::cout << "警告: 日志结构布局的块映射常驻内存，逻辑块数限制为 " << LOG_MAX_LOGICAL_BLOCKS
+                  << "；使用更大的块大小可以利用整个磁盘。" << std::endl;
+    }
+
+    header_ = {};
+    header_.magic = LOG_MAGIC_NUMBER;
+    header_.block_size = static_cast<int>(block_size);
+    header_.logical_blocks = logical;
+    header_.map_start_block = 1;
+    header_.map_blocks = map_blocks;
+    header_.segments_start_block = header_.map_start_block + map_blocks;
+    header_.segment_count = segments;
+    header_.segment_blocks = segment_blocks;
+    header_.checkpoint_sequence = 0;
+    header_.map_initialized_blocks = 0;
+    header_.log_id = (static_cast<unsigned long long>(std::random_device()()) << 32) ^
+                     static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count());
+    reset();
+    if (!writeHeader())
+    {
+        return false;
+    }
+    std::cout << "信息: 日志结构布局: " << logical << " 个逻辑块, " << segments << " 个段 (每段 " << segment_blocks
+              << " 块), 块映射 " << map_blocks << " 块。" << std::endl;
+    return true;
+}
+
+// 挂载: 读入检查点映射，然后沿每个段的摘要链收集检查点之后写入的部分段，按序号依次重放它们的映射。
+// 各段的存活块数由最终的映射统计，没有存活块的段即为空闲段。
+bool LogStructuredStore::load(const LogHeader &header)
+{
+    long long physical_blocks = vdisk_->diskSize_ / vdisk_->blockSize_;
+    if (header.magic != LOG_MAGIC_NUMBER || header.block_size != vdisk_->blockSize_ || header.segment_blocks < 2 ||
+        header.segment_count <= 0 || header.logical_blocks <= 0 || header.logical_blocks > LOG_MAX_LOGICAL_BLOCKS ||
+        header.map_start_block < 1 || header.map_start_block + header.map_blocks > header.segments_start_block ||
+        header.segments_start_block + header.segment_count * header.segment_blocks > physical_blocks)
+    {
+        std::cerr << "错误: 日志结构布局的日志头无效。" << std::endl;
+        return false;
+    }
+    header_ = header;
+    reset();
+    if (!readMap())
+    {
+        return false;
+    }
+
+    std::vector<RolledPartial> partials;
+    long long max_sequence = header_.checkpoint_sequence;
+    for (long long segment = 0; segment < header_.segment_count; ++segment)
+    {
+        bool ok = walkSegment(segment, nullptr, [&](const LogSummary &summary, BlockId firstBlock)
+                              {
+                                  max_sequence = std::max(max_sequence, summary.sequence);
+                                  if (summary.sequence > header_.checkpoint_sequence)
+                                  {
+                                      partials.push_back({summary.sequence, firstBlock,
+                                                          std::vector<BlockId>(summary.block_ids, summary.block_ids + summary.count)});
+                                  }
+                              });
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    std::sort(partials.begin(), partials.end(), [](const RolledPartial &a, const RolledPartial &b)
+              { return a.sequence < b.sequence; });
+    int per_map_block = mapEntriesPerBlock();
+    for (const RolledPartial &partial : partials)
+    {
+        for (size_t i = 0; i < partial.block_ids.size(); ++i)
+        {
+            BlockId block_id = partial.block_ids[i];
+            if (block_id >= 0 && block_id < header_.logical_blocks)
+            {
+                map_[block_id] = partial.first_block + static_cast<BlockId>(i);
+                dirty_map_blocks_.insert(block_id / per_map_block);
+            }
+        }
+    }
+    next_sequence_ = max_sequence + 1;
+
+    free_segments_.clear();
+    for (BlockId physical : map_)
+    {
+        if (physical != INVALID_BLOCK_ID)
+        {
+            ++live_[segmentOf(physical)];
+        }
+    }
+    for (long long segment = header_.segment_count - 1; segment >= 0; --segment)
+    {
+        free_[segment] = live_[segment] == 0;
+        if (free_[segment])
+        {
+            free_segments_.push_back(segment);
+        }
+    }
+
+    if (!partials.empty())
+    {
+        std::cout << "信息: 日志结构布局: 前滚了检查点之后的 " << partials.size() << " 个部分段。" << std::endl;
+        return checkpoint(); // 下次挂载无需再前滚
+    }
+    return true;
+}
+
+// 读入检查点映射。映射区中 0 表示未映射 (物理块 0 是日志头，不会是数据的位置)，超出段范围的项同样视为未映射。
+bool LogStructuredStore::readMap()
+{
+    long long block_size = vdisk_->blockSize_;
+    int per_map_block = mapEntriesPerBlock();
+    long long chunk_blocks = std::max<long long>(1, IO_MAX_RUN_BYTES / block_size);
+    long long count = std::min(header_.map_initialized_blocks, header_.map_blocks);
+    BlockId segments_end = segmentStart(header_.segment_count);
+    AlignedBuffer buffer = vdisk_->buffer_pool_.acquire(chunk_blocks * block_size, false);
+    const BlockId *entries = reinterpret_cast<const BlockId *>(buffer.data());
+    for (long long m = 0; m < count; m += chunk_blocks)
+    {
+        int n = static_cast<int>(std::min(chunk_blocks, count - m));
+        std::vector<BlockIoRequest> requests = {{false, header_.map_start_block + m, n, buffer.data(), false, false}};
+        if (!vdisk_->submitPhysical(requests))
+        {
+            std::cerr << "错误: 无法读取日志结构布局的块映射。" << std::endl;
+            return false;
+        }
+        long long first = m * per_map_block;
+        long long last = std::min(header_.logical_blocks, first + static_cast<long long>(n) * per_map_block);
+        for (long long block_id = first; block_id < last; ++block_id)
+        {
+            BlockId physical = entries[block_id - first];
+            map_[block_id] = physical >= header_.segments_start_block && physical < segments_end ? physical : INVALID_BLOCK_ID;
+        }
+    }
+    return true;
+}
+
+// 写出自上次检查点以来变化的映射块。第一次写到映射区某处时，它与已写过部分之间的块一并按内存中的映射写出，
+// 使 map_initialized_blocks 之前的映射区都有效。
+bool LogStructuredStore::writeMapBlocks()
+{
+    std::vector<long long> blocks(dirty_map_blocks_.begin(), dirty_map_blocks_.end());
+    if (!blocks.empty() && blocks.back() >= header_.map_initialized_blocks)
+    {
+        for (long long m = header_.map_initialized_blocks; m < blocks.back(); ++m)
+        {
+            blocks.push_back(m);
+        }
+        std::sort(blocks.begin(), blocks.end());
+        blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+    }
+
+    long long block_size = vdisk_->blockSize_;
+    int per_map_block = mapEntriesPerBlock();
+    long long chunk_blocks = std::max<long long>(1, IO_MAX_RUN_BYTES / block_size);
+    AlignedBuffer buffer = vdisk_->buffer_pool_.acquire(chunk_blocks * block_size, false);
+    BlockId *entries = reinterpret_cast<BlockId *>(buffer.data());
+    size_t i = 0;
+    while (i < blocks.size())
+    {
+        long long start = blocks[i];
+        int n = 0;
+        while (i < blocks.size() && blocks[i] == start + n && n < chunk_blocks)
+        {
+            ++n;
+            ++i;
+        }
+        long long first = start * per_map_block;
+        for (long long k = 0; k < static_cast<long long>(n) * per_map_block; ++k)
+        {
+            BlockId physical = first + k < header_.logical_blocks ? map_[first + k] : INVALID_BLOCK_ID;
+            entries[k] = physical == INVALID_BLOCK_ID ? 0 : physical;
+        }
+        std::vector<BlockIoRequest> requests = {{true, header_.map_start_block + start, n, buffer.data(), false, false}};
+        if (!vdisk_->submitPhysical(requests))
+        {
+            std::cerr << "错误: 无法写入日志结构布局的块映射。" << std::endl;
+            return false;
+        }
+    }
+    if (!blocks.empty())
+    {
+        header_.map_initialized_blocks = std::max(header_.map_initialized_blocks, blocks.back() + 1);
+    }
+    return true;
+}
+
+bool LogStructuredStore::writeHeader()
+{
+    AlignedBuffer buffer = vdisk_->buffer_pool_.acquire(vdisk_->blockSize_);
+    std::memcpy(buffer.data(), &header_, sizeof(LogHeader));
+    std::vector<BlockIoRequest> requests = {{true, 0, 1, buffer.data(), false, false}};
+    if (!vdisk_->submitPhysical(requests) || !vdisk_->fdatasyncLocked())
+    {
+        std::cerr << "错误: 无法写入日志结构布局的日志头。" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool LogStructuredStore::syncImage()
+{
+    if (!vdisk_->fdatasyncLocked())
+    {
+        return false;
+    }
+    free_segments_.insert(free_segments_.end(), recently_freed_.begin(), recently_freed_.end());
+    recently_freed_.clear();
+    return true;
+}
+
+// 检查点: 部分段先落盘，再写映射块，最后写记录了新检查点序号的日志头。
+// 中途崩溃时日志头仍是旧的，挂载时从旧检查点前滚，写了一半的映射块被前滚的结果覆盖。
+bool LogStructuredStore::checkpoint()
+{
+    if (!flush() || !syncImage())
+    {
+        return false;
+    }
+    if (!writeMapBlocks() || !vdisk_->fdatasyncLocked())
+    {
+        return false;
+    }
+    header_.checkpoint_sequence = next_sequence_ - 1;
+    if (!writeHeader())
+    {
+        return false;
+    }
+    dirty_map_blocks_.clear();
+    segments_since_checkpoint_ = 0;
+    return true;
+}
+
+bool LogStructuredStore::flush()
+{
+    if (pending_ids_.empty())
+    {
+        return true;
+    }
+    bool ok = appendBlocks(pending_ids_.data(), pending_data_.data(), pending_ids_.size());
+    pending_ids_.clear();
+    pending_slots_.clear();
+    return ok;
+}
+
+bool LogStructuredStore::sync()
+{
+    return flush() && syncImage();
+}
+
+// 空闲段偏少时清理一个存活块不超过一半的段，块映射的检查点也在这里按段数到期
+bool LogStructuredStore::backgroundWork()
+{
+    if (freeSegmentCount() < static_cast<size_t>(LOG_BACKGROUND_CLEAN_SEGMENTS))
+    {
+        cleaning_ = true;
+        cleanSegment(header_.segment_blocks / 2);
+        cleaning_ = false;
+    }
+    if (segments_since_checkpoint_ >= LOG_CHECKPOINT_SEGMENTS)
+    {
+        return checkpoint();
+    }
+    return true;
+}
+
+// 按逻辑块号完成一批请求。写请求只进入待写部分段；读请求先查待写部分段，
+// 其余按映射翻译成物理请求 (物理上连续的块合并为一个请求)，从未写过的块读出为 0。
+bool LogStructuredStore::submit(std::vector<BlockIoRequest> &requests)
+{
+    long long block_size = vdisk_->blockSize_;
+    const int max_run_blocks = std::max(1, IO_MAX_RUN_BYTES / static_cast<int>(block_size));
+    bool ok = true;
+    std::vector<BlockIoRequest> physical;
+    for (BlockIoRequest &request : requests)
+    {
+        if (request.start_block_id < 0 || request.start_block_id + request.block_count > header_.logical_blocks)
+        {
+            std::cerr << "错误: 块 " << request.start_block_id << " 起的 " << request.block_count << " 个块超出日志结构布局的范围。" << std::endl;
+            ok = false;
+            continue;
+        }
+        if (request.is_write)
+        {
+            for (int i = 0; i < request.block_count; ++i)
+            {
+                ok = bufferWrite(request.start_block_id + i, request.buffer + i * block_size) && ok;
+            }
+            continue;
+        }
+        int i = 0;
+        while (i < request.block_count)
+        {
+            BlockId block_id = request.start_block_id + i;
+            char *destination = request.buffer + i * block_size;
+            auto pending = pending_slots_.find(block_id);
+            if (pending != pending_slots_.end())
+            {
+                std::memcpy(destination, pending_data_.data() + pending->second * block_size, block_size);
+                ++i;
+                continue;
+            }
+            BlockId start = map_[block_id];
+            if (start == INVALID_BLOCK_ID)
+            {
+                std::memset(destination, 0, block_size);
+                ++i;
+                continue;
+            }
+            int run = 1;
+            while (i + run < request.block_count && run < max_run_blocks && map_[block_id + run] == start + run &&
+                   pending_slots_.count(block_id + run) == 0)
+            {
+                ++run;
+            }
+            physical.push_back({false, start, run, destination, false, false});
+            i += run;
+        }
+    }
+    return vdisk_->submitPhysical(physical) && ok;
+}
+
+// 写入待写部分段: 同一块再次写入时原地覆盖，攒满时追加到日志
+bool LogStructuredStore::bufferWrite(BlockId blockId, const char *data)
+{
+    long long block_size = vdisk_->blockSize_;
+    auto slot = pending_slots_.find(blockId);
+    if (slot != pending_slots_.end())
+    {
+        std::memcpy(pending_data_.data() + slot->second * block_size, data, block_size);
+        return true;
+    }
+    if (pending_ids_.size() >= pendingCapacity() && !flush())
+    {
+        return false;
+    }
+    size_t index = pending_ids_.size();
+    pending_ids_.push_back(blockId);
+    pending_slots_[blockId] = index;
+    std::memcpy(pending_data_.data() + index * block_size, data, block_size);
+    return true;
+}
+
+// 把 count 个块顺序追加到日志: 每个部分段是一个摘要块加上它登记的块，一次写入；当前段放不下时换段
+bool LogStructuredStore::appendBlocks(const BlockId *blockIds, const char *data, size_t count)
+{
+    long long block_size = vdisk_->blockSize_;
+    size_t capacity = static_cast<size_t>(summaryCapacity());
+    AlignedBuffer buffer;
+    size_t done = 0;
+    while (done < count)
+    {
+        if ((current_segment_ < 0 || current_offset_ + 2 > header_.segment_blocks) && !openSegment())
+        {
+            return false;
+        }
+        size_t n = std::min({count - done, static_cast<size_t>(header_.segment_blocks - current_offset_ - 1), capacity});
+        size_t bytes = (n + 1) * block_size;
+        if (buffer.size() < bytes)
+        {
+            buffer = vdisk_->buffer_pool_.acquire(bytes, false);
+        }
+        std::memset(buffer.data(), 0, block_size);
+        LogSummary *summary = reinterpret_cast<LogSummary *>(buffer.data());
+        summary->magic = LOG_MAGIC_NUMBER;
+        summary->count = static_cast<int>(n);
+        summary->sequence = next_sequence_;
+        std::memcpy(summary->block_ids, blockIds + done, n * BLOCK_ID_TYPE_SIZE);
+        summary->checksum = summaryChecksum(*summary);
+        std::memcpy(buffer.data() + block_size, data + done * block_size, n * block_size);
+
+        BlockId first = segmentStart(current_segment_) + current_offset_;
+        std::vector<BlockIoRequest> requests = {{true, first, static_cast<int>(n + 1), buffer.data(), false, false}};
+        if (!vdisk_->submitPhysical(requests))
+        {
+            return false;
+        }
+        ++next_sequence_;
+        current_offset_ += static_cast<long long>(n) + 1;
+        for (size_t k = 0; k < n; ++k)
+        {
+            remap(blockIds[done + k], first + 1 + static_cast<BlockId>(k));
+        }
+        done += n;
+    }
+    return true;
+}
+
+// 换一个空闲段作为当前段。普通写入不使用最后 LOG_RESERVED_SEGMENTS 个空闲段: 空闲段降到这里时先清理，
+// 清理搬迁存活块时才可以写进保留段。
+bool LogStructuredStore::openSegment()
+{
+    if (!cleaning_ && freeSegmentCount() <= static_cast<size_t>(LOG_RESERVED_SEGMENTS))
+    {
+        cleaning_ = true;
+        while (freeSegmentCount() <= static_cast<size_t>(LOG_RESERVED_SEGMENTS) && cleanSegment(header_.segment_blocks))
+        {
+        }
+        cleaning_ = false;
+        if (current_segment_ >= 0 && current_offset_ + 2 <= header_.segment_blocks)
+        {
+            return true; // 清理时换上的段还有空位
+        }
+    }
+    if (freeSegmentCount() == 0 || (!cleaning_ && freeSegmentCount() <= static_cast<size_t>(LOG_RESERVED_SEGMENTS)))
+    {
+        std::cerr << "错误: 日志结构布局没有空闲段，清理也无法腾出空间。" << std::endl;
+        return false;
+    }
+    // 刚作废的段里可能还有最近一次落盘时有效的内容，等新位置落盘后才能覆盖
+    if (free_segments_.empty() && !syncImage())
+    {
+        return false;
+    }
+    long long previous = current_segment_;
+    current_segment_ = free_segments_.back();
+    free_segments_.pop_back();
+    free_[current_segment_] = 0;
+    current_offset_ = 0;
+    if (previous >= 0)
+    {
+        retireSegment(previous);
+    }
+    ++segments_since_checkpoint_;
+    return true;
+}
+
+void LogStructuredStore::retireSegment(long long segment)
+{
+    if (live_[segment] == 0 && !free_[segment])
+    {
+        releaseSegment(segment);
+    }
+}
+
+void LogStructuredStore::releaseSegment(long long segment)
+{
+    free_[segment] = 1;
+    recently_freed_.push_back(segment);
+}
+
+// 逻辑块改到新位置: 旧位置所在的段少一个存活块，减到 0 且不是当前段时回收
+void LogStructuredStore::remap(BlockId blockId, BlockId physicalBlock)
+{
+    BlockId old = map_[blockId];
+    if (old != INVALID_BLOCK_ID)
+    {
+        long long segment = segmentOf(old);
+        if (--live_[segment] == 0 && segment != current_segment_)
+        {
+            releaseSegment(segment);
+        }
+    }
+    map_[blockId] = physicalBlock;
+    ++live_[segmentOf(physicalBlock)];
+    dirty_map_blocks_.insert(blockId / mapEntriesPerBlock());
+}
+
+// 清理一个段: 选存活块最少的段 (贪心)，整段读入，依摘要找出映射仍指向这里的块，追加到日志末尾。
+// 搬迁需要的空间 (存活块加摘要块) 不少于一个段时没有收益，不清理。
+bool LogStructuredStore::cleanSegment(long long maxLive)
+{
+    const long long segment_blocks = header_.segment_blocks;
+    long long block_size = vdisk_->blockSize_;
+    long long victim = -1;
+    for (long long segment = 0; segment < header_.segment_count; ++segment)
+    {
+        if (!free_[segment] && segment != current_segment_ && (victim < 0 || live_[segment] < live_[victim]))
+        {
+            victim = segment;
+        }
+    }
+    if (victim < 0)
+    {
+        return false;
+    }
+    long long live = live_[victim];
+    long long capacity = summaryCapacity();
+    if (live > maxLive || live + (live + capacity - 1) / capacity >= segment_blocks)
+    {
+        return false;
+    }
+
+    AlignedBuffer image = vdisk_->buffer_pool_.acquire(segment_blocks * block_size, false);
+    std::vector<BlockIoRequest> requests = {{false, segmentStart(victim), static_cast<int>(segment_blocks), image.data(), false, false}};
+    if (!vdisk_->submitPhysical(requests))
+    {
+        return false;
+    }
+    BlockId segment_start = segmentStart(victim);
+    std::vector<BlockId> block_ids;
+    AlignedBuffer data = vdisk_->buffer_pool_.acquire(std::max<long long>(1, live) * block_size, false);
+    walkSegment(victim, image.data(), [&](const LogSummary &summary, BlockId firstBlock)
+                {
+                    for (int i = 0; i < summary.count; ++i)
+                    {
+                        BlockId block_id = summary.block_ids[i];
+                        BlockId physical = firstBlock + i;
+                        if (block_id >= 0 && block_id < header_.logical_blocks && map_[block_id] == physical &&
+                            static_cast<long long>(block_ids.size()) < live)
+                        {
+                            std::memcpy(data.data() + block_ids.size() * block_size,
+                                        image.data() + (physical - segment_start) * block_size, block_size);
+                            block_ids.push_back(block_id);
+                        }
+                    }
+                });
+    if (static_cast<long long>(block_ids.size()) != live)
+    {
+        std::cerr << "错误: 段 " << victim << " 的摘要与块映射不一致 (存活 " << live << " 块，摘要中找到 "
+                  << block_ids.size() << " 块)，跳过清理。" << std::endl;
+        return false;
+    }
+    if (live == 0)
+    {
+        retireSegment(victim);
+        return true;
+    }
+    return appendBlocks(block_ids.data(), data.data(), block_ids.size()); // 存活块减到 0 时段被回收
+}
+
+// 沿段中的部分段链依次访问摘要。摘要的魔数、校验和不对，或序号不大于前一个部分段时，
+// 说明到了段中尚未写过的位置 (或是段被重新使用前的旧内容)，停止。
+bool LogStructuredStore::walkSegment(long long segment, const char *image, const PartialVisitor &visit)
+{
+    const long long segment_blocks = header_.segment_blocks;
+    long long block_size = vdisk_->blockSize_;
+    int capacity = summaryCapacity();
+    BlockId segment_start = segmentStart(segment);
+    AlignedBuffer block;
+    if (!image)
+    {
+        block = vdisk_->buffer_pool_.acquire(block_size, false);
+    }
+    long long offset = 0;
+    long long last_sequence = 0;
+    while (offset + 1 < segment_blocks)
+    {
+        const char *raw = image ? image + offset * block_size : block.data();
+        if (!image)
+        {
+            std::vector<BlockIoRequest> requests = {{false, segment_start + offset, 1, block.data(), false, false}};
+            if (!vdisk_->submitPhysical(requests))
+            {
+                return false;
+            }
+        }
+        const LogSummary *summary = reinterpret_cast<const LogSummary *>(raw);
+        if (summary->magic != LOG_MAGIC_NUMBER || summary->count <= 0 || summary->count > capacity ||
+            offset + 1 + summary->count > segment_blocks || summary->sequence <= last_sequence ||
+            summaryChecksum(*summary) != summary->checksum)
+        {
+            break;
+        }
+        visit(*summary, segment_start + offset + 1);
+        last_sequence = summary->sequence;
+        offset += 1 + summary->count;
+    }
+    return true;
+}
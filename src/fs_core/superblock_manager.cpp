@@ -1,14 +1,20 @@
 #include "fs_core/superblock_manager.h"
 #include "common_defs.h"
+#include "fs_core/block_geometry.h"
 #include <iostream>
 #include <vector>
 #include <cstring>   // For std::memcpy and std::memset
 #include <algorithm> // For std::min
+#include <limits>    // For std::numeric_limits
+#include <functional> // For std::greater
 
 // SuperBlockManager 构造函数
 // vdisk: 指向 VirtualDisk 对象的指针。
 SuperBlockManager::SuperBlockManager(VirtualDisk *vdisk)
-    : vdisk_(vdisk), superblock_({})
+    : vdisk_(vdisk), superblock_({}),
+      get_inode_bit_(&SuperBlockManager::getInodeBitFor<DEFAULT_BLOCK_SIZE>),
+      set_inode_bit_(&SuperBlockManager::setInodeBitFor<DEFAULT_BLOCK_SIZE>),
+      inode_alloc_hint_(0)
 {
     if (!vdisk_)
     {
@@ -16,18 +22,37 @@ SuperBlockManager::SuperBlockManager(VirtualDisk *vdisk)
     }
 }
 
+// 每个空闲块组块能容纳的块号数 (第一个为链接指针)，由格式化时的块大小决定
+int SuperBlockManager::freeBlocksPerGroup() const
+{
+    return superblock_.block_size / BLOCK_ID_TYPE_SIZE - 1;
+}
+
 // 从虚拟磁盘加载超级块
 bool SuperBlockManager::loadSuperBlock()
 {
     if (!vdisk_)
         return false;
-    char buffer[DEFAULT_BLOCK_SIZE];
-    if (!vdisk_->readBlock(0, buffer, vdisk_->getBlockSize()))
+
+    // 块大小记录在超级块中: 先读块 0 开头的原始字节取得 block_size，让虚拟磁盘按它划分块
+    SuperBlock header = {};
+    if (vdisk_->readHeader(reinterpret_cast<char *>(&header), sizeof(SuperBlock)) &&
+        header.magic_number == FILESYSTEM_MAGIC_NUMBER && header.block_size != vdisk_->getBlockSize())
+    {
+        if (!vdisk_->setBlockSize(header.block_size))
+        {
+            std::cerr << "错误: 超级块中的块大小 " << header.block_size << " 无效。" << std::endl;
+            return false;
+        }
+    }
+
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(vdisk_->getBlockSize());
+    if (!vdisk_->readBlock(0, buffer.data(), vdisk_->getBlockSize()))
     {
         std::cerr << "错误: SuperBlockManager 无法从磁盘读取块 0 (超级块)。" << std::endl;
         return false;
     }
-    std::memcpy(&superblock_, buffer, sizeof(SuperBlock));
+    std::memcpy(&superblock_, buffer.data(), sizeof(SuperBlock));
 
     if (superblock_.magic_number != FILESYSTEM_MAGIC_NUMBER)
     {
@@ -35,6 +60,13 @@ bool SuperBlockManager::loadSuperBlock()
         superblock_ = {};
         return false;
     }
+    if (superblock_.format_version != FILESYSTEM_FORMAT_VERSION)
+    {
+        std::cerr << "错误: 磁盘布局版本 " << superblock_.format_version << " 不受支持 (当前版本 "
+                  << FILESYSTEM_FORMAT_VERSION << ")，请重新格式化。" << std::endl;
+        superblock_ = {};
+        return false;
+    }
     if (superblock_.block_size != vdisk_->getBlockSize())
     {
         std::cerr << "警告: 超级块中的 block_size (" << superblock_.block_size
@@ -42,6 +74,29 @@ bool SuperBlockManager::loadSuperBlock()
                   << ") 不匹配。这可能导致严重问题。" << std::endl;
         // 考虑返回 false 或采取纠正措施
     }
+    if (!selectGeometry(superblock_.block_size, superblock_.inode_size))
+    {
+        std::cerr << "错误: 不支持的块大小 " << superblock_.block_size << " 或 i-node 大小 " << superblock_.inode_size << "。" << std::endl;
+        superblock_ = {};
+        return false;
+    }
+    // 重放日志: 已提交但尚未写回原位置的事务可能包含更新的超级块，重放后重新读取
+    if (superblock_.journal_blocks_count > 0)
+    {
+        if (!vdisk_->openJournal(superblock_.journal_start_block_idx, superblock_.journal_blocks_count) ||
+            !vdisk_->readBlock(0, buffer.data(), vdisk_->getBlockSize()))
+        {
+            std::cerr << "错误: 无法打开元数据日志。" << std::endl;
+            superblock_ = {};
+            return false;
+        }
+        std::memcpy(&superblock_, buffer.data(), sizeof(SuperBlock));
+    }
+    if (!loadInodeChunkMap() || !loadBlockRefCounts())
+    {
+        superblock_ = {};
+        return false;
+    }
     std::cout << "信息: 超级块已成功加载。" << std::endl;
     return true;
 }
@@ -51,10 +106,9 @@ bool SuperBlockManager::saveSuperBlock()
 {
     if (!vdisk_)
         return false;
-    char buffer[DEFAULT_BLOCK_SIZE];
-    std::memset(buffer, 0, vdisk_->getBlockSize());
-    std::memcpy(buffer, &superblock_, sizeof(SuperBlock));
-    if (!vdisk_->writeBlock(0, buffer, vdisk_->getBlockSize()))
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(vdisk_->getBlockSize()); // 已清零
+    std::memcpy(buffer.data(), &superblock_, sizeof(SuperBlock));
+    if (!vdisk_->writeBlock(0, buffer.data(), vdisk_->getBlockSize()))
     {
         std::cerr << "错误: SuperBlockManager 无法将超级块写入磁盘块 0。" << std::endl;
         return false;
@@ -90,7 +144,8 @@ bool SuperBlockManager::writeInodeBitmapBlock(int bitmap_block_offset, const cha
 // inodeId: 要检查的 i-node ID。
 // isSet: 输出参数，如果 i-node 已使用则为 true，否则为 false。
 // 返回值: 操作是否成功。
-bool SuperBlockManager::getInodeBit(int inodeId, bool &isSet) const
+template <int BlockSize>
+bool SuperBlockManager::getInodeBitFor(int inodeId, bool &isSet) const
 {
     if (inodeId < 0 || inodeId >= superblock_.total_inodes)
     {
@@ -98,9 +153,10 @@ bool SuperBlockManager::getInodeBit(int inodeId, bool &isSet) const
         return false;
     }
 
+    using Geometry = BlockGeometry<BlockSize>;
     int bit_offset = inodeId;
-    int block_offset_in_bitmap = bit_offset / (superblock_.block_size * 8);
-    int byte_offset_in_block = (bit_offset / 8) % superblock_.block_size;
+    int block_offset_in_bitmap = bit_offset / Geometry::kBitsPerBlock;
+    int byte_offset_in_block = (bit_offset / 8) % BlockSize;
     int bit_offset_in_byte = bit_offset % 8;
 
     if (block_offset_in_bitmap >= superblock_.inode_bitmap_blocks_count)
@@ -109,7 +165,7 @@ bool SuperBlockManager::getInodeBit(int inodeId, bool &isSet) const
         return false;
     }
 
-    std::vector<char> bitmap_block_buffer(superblock_.block_size);
+    AlignedBuffer bitmap_block_buffer = vdisk_->bufferPool().acquire(BlockSize);
     if (!readInodeBitmapBlock(block_offset_in_bitmap, bitmap_block_buffer.data()))
     {
         return false;
@@ -123,7 +179,8 @@ bool SuperBlockManager::getInodeBit(int inodeId, bool &isSet) const
 // inodeId: 要设置的 i-node ID。
 // setToUsed: true 表示标记为已使用 (1)，false 表示标记为空闲 (0)。
 // 返回值: 操作是否成功。
-bool SuperBlockManager::setInodeBit(int inodeId, bool setToUsed)
+template <int BlockSize>
+bool SuperBlockManager::setInodeBitFor(int inodeId, bool setToUsed)
 {
     if (inodeId < 0 || inodeId >= superblock_.total_inodes)
     {
@@ -131,9 +188,10 @@ bool SuperBlockManager::setInodeBit(int inodeId, bool setToUsed)
         return false;
     }
 
+    using Geometry = BlockGeometry<BlockSize>;
     int bit_offset = inodeId;
-    int block_offset_in_bitmap = bit_offset / (superblock_.block_size * 8);
-    int byte_offset_in_block = (bit_offset / 8) % superblock_.block_size;
+    int block_offset_in_bitmap = bit_offset / Geometry::kBitsPerBlock;
+    int byte_offset_in_block = (bit_offset / 8) % BlockSize;
     int bit_offset_in_byte = bit_offset % 8;
 
     if (block_offset_in_bitmap >= superblock_.inode_bitmap_blocks_count)
@@ -143,7 +201,7 @@ bool SuperBlockManager::setInodeBit(int inodeId, bool setToUsed)
     }
 
     // char bitmap_block_buffer[superblock_.block_size]; // <--- 原来的问题行
-    std::vector<char> bitmap_block_buffer(superblock_.block_size); // <--- 修改后的行
+    AlignedBuffer bitmap_block_buffer = vdisk_->bufferPool().acquire(BlockSize); // <--- 修改后的行
 
     // 使用 .data() 获取指向vector内部数据的指针传递给C风格API
     if (!readInodeBitmapBlock(block_offset_in_bitmap, bitmap_block_buffer.data()))
@@ -169,76 +227,148 @@ bool SuperBlockManager::setInodeBit(int inodeId, bool setToUsed)
     return true;
 }
 
+bool SuperBlockManager::getInodeBit(int inodeId, bool &isSet) const
+{
+    return (this->*get_inode_bit_)(inodeId, isSet);
+}
+
+bool SuperBlockManager::setInodeBit(int inodeId, bool setToUsed)
+{
+    return (this->*set_inode_bit_)(inodeId, setToUsed);
+}
+
+// 按块大小选择 i-node 位图操作的编译期实例 (加载或格式化超级块时调用)
+bool SuperBlockManager::selectGeometry(int blockSize, int inodeSize)
+{
+    if (inodeSize != INODE_SIZE_BYTES)
+    {
+        return false;
+    }
+    return selectBlockGeometry(blockSize, [this](auto geometry)
+                               {
+                                   constexpr int block_size = decltype(geometry)::kBlockSize;
+                                   get_inode_bit_ = &SuperBlockManager::getInodeBitFor<block_size>;
+                                   set_inode_bit_ = &SuperBlockManager::setInodeBitFor<block_size>;
+                               });
+}
+
 // 格式化文件系统
-bool SuperBlockManager::formatFileSystem(int totalInodes, int blockSize)
+// 磁盘布局: 超级块 | i-node 位图 | 数据区。i-node 表不再预先划出，
+// 格式化时只分配容纳 initialInodes 个 i-node 的 i-node 块，之后由 allocateInode 按需增长。
+// 工作量与磁盘大小无关: 位图按需清零，数据区作为一整段未分配区间记录在超级块中。
+// layout 为日志结构布局时，以上布局都在虚拟磁盘提供的逻辑块上，块在映像中的位置由虚拟磁盘的块映射决定。
+bool SuperBlockManager::formatFileSystem(int initialInodes, int blockSize, DiskLayout layout)
 {
     if (!vdisk_)
         return false;
-    if (blockSize <= 0 || totalInodes <= 0)
+    if (blockSize <= 0 || initialInodes <= 0)
     {
-        std::cerr << "错误: 无效的块大小 (" << blockSize << ") 或 i-node 总数 (" << totalInodes << ")。" << std::endl;
+        std::cerr << "错误: 无效的块大小 (" << blockSize << ") 或初始 i-node 数 (" << initialInodes << ")。" << std::endl;
         return false;
     }
-    if (vdisk_->getBlockSize() != blockSize)
+    // 块大小在格式化时选定，虚拟磁盘随之切换 (总块数按新块大小重新计算)
+    if (vdisk_->getBlockSize() != blockSize && !vdisk_->setBlockSize(blockSize))
     {
-        std::cerr << "错误: 请求的块大小 (" << blockSize
-                  << ") 与虚拟磁盘的块大小 (" << vdisk_->getBlockSize()
-                  << ") 不匹配。" << std::endl;
+        std::cerr << "错误: 虚拟磁盘无法使用块大小 " << blockSize << "。" << std::endl;
+        return false;
+    }
+    if (!vdisk_->formatLayout(layout))
+    {
+        std::cerr << "错误: 无法在虚拟磁盘上建立" << (layout == DiskLayout::LOG_STRUCTURED ? "日志结构" : "原地") << "布局。" << std::endl;
         return false;
     }
 
     superblock_ = {}; // 清空现有超级块
 
     superblock_.magic_number = FILESYSTEM_MAGIC_NUMBER;
+    superblock_.format_version = FILESYSTEM_FORMAT_VERSION;
     superblock_.block_size = blockSize;
     superblock_.inode_size = INODE_SIZE_BYTES;
     superblock_.total_blocks = vdisk_->getTotalBlocks();
-    superblock_.total_inodes = totalInodes;
+    if (!selectGeometry(blockSize, superblock_.inode_size))
+    {
+        std::cerr << "错误: 不支持的块大小 " << blockSize << "。" << std::endl;
+        return false;
+    }
 
-    // 1. 计算 i-node 位图所需的空间
-    int bits_per_block = blockSize * 8;
-    superblock_.inode_bitmap_blocks_count = (totalInodes + bits_per_block - 1) / bits_per_block;
+    // 1. i-node 位图: 按"每个块都可能成为 i-node 块"估算上限，i-node 号受 int 范围限制
+    int inodes_per_block = inodesPerChunk();
+    long long max_inodes = std::min<long long>(superblock_.total_blocks * inodes_per_block,
+                                               std::numeric_limits<int>::max() / inodes_per_block * inodes_per_block);
+    long long bits_per_block = static_cast<long long>(blockSize) * 8;
+    superblock_.max_inodes = static_cast<int>(max_inodes);
+    superblock_.inode_bitmap_blocks_count = static_cast<int>((max_inodes + bits_per_block - 1) / bits_per_block);
     superblock_.inode_bitmap_start_block_idx = 1; // 位图紧随超级块之后
 
-    // 2. 计算 i-node 表所需的空间
-    int inodes_per_block = blockSize / superblock_.inode_size;
-    if (inodes_per_block == 0)
+    // 2. 元数据日志区紧随位图: 按磁盘大小取 1/JOURNAL_DISK_FRACTION，夹在 [JOURNAL_MIN_BLOCKS, JOURNAL_MAX_BYTES] 之间；
+    //    磁盘太小 (日志会超过四分之一) 时不设日志
+    long long journal_blocks = std::min(std::max<long long>(superblock_.total_blocks / JOURNAL_DISK_FRACTION, JOURNAL_MIN_BLOCKS),
+                                        JOURNAL_MAX_BYTES / blockSize);
+    if (journal_blocks > superblock_.total_blocks / 4)
     {
-        std::cerr << "错误: 块大小 " << blockSize << " 对于 i-node 大小 " << superblock_.inode_size << " 太小。" << std::endl;
-        return false;
+        journal_blocks = 0;
     }
-    int inode_table_blocks_count = (totalInodes + inodes_per_block - 1) / inodes_per_block;
-    superblock_.inode_table_start_block_idx = superblock_.inode_bitmap_start_block_idx + superblock_.inode_bitmap_blocks_count;
+    superblock_.journal_start_block_idx = superblock_.inode_bitmap_start_block_idx + superblock_.inode_bitmap_blocks_count;
+    superblock_.journal_blocks_count = static_cast<int>(journal_blocks);
 
     // 3. 计算第一个数据块的起始位置
-    superblock_.first_data_block_idx = superblock_.inode_table_start_block_idx + inode_table_blocks_count;
-
-    if (superblock_.first_data_block_idx >= superblock_.total_blocks)
+    superblock_.first_data_block_idx = superblock_.journal_start_block_idx + superblock_.journal_blocks_count;
+    long long initial_chunks = (initialInodes + inodes_per_block - 1) / inodes_per_block;
+    // 每个映射块登记 ppb - 1 个 i-node 块
+    long long initial_map_blocks = (initial_chunks + freeBlocksPerGroup() - 1) / freeBlocksPerGroup();
+    if (superblock_.first_data_block_idx + initial_chunks + initial_map_blocks >= superblock_.total_blocks)
     {
-        std::cerr << "错误: 磁盘空间不足以容纳超级块、i-node位图、i-node表和至少一个数据块。" << std::endl;
+        std::cerr << "错误: 磁盘空间不足以容纳超级块、i-node位图、初始i-node块和至少一个数据块。" << std::endl;
         std::cerr << "  总块数: " << superblock_.total_blocks << std::endl;
         std::cerr << "  超级块: 1 块" << std::endl;
         std::cerr << "  i-node位图: " << superblock_.inode_bitmap_blocks_count << " 块" << std::endl;
-        std::cerr << "  i-node表: " << inode_table_blocks_count << " 块" << std::endl;
-        std::cerr << "  所需最小块数 (元数据 + 1数据块): " << superblock_.first_data_block_idx + 1 << std::endl;
+        std::cerr << "  日志: " << superblock_.journal_blocks_count << " 块" << std::endl;
+        std::cerr << "  初始i-node块: " << initial_chunks << " 块" << std::endl;
         return false;
     }
 
     superblock_.free_blocks_count = superblock_.total_blocks - superblock_.first_data_block_idx;
-    // free_inodes_count 将在初始化位图后设置
+    superblock_.total_inodes = 0;
+    superblock_.free_inodes_count = 0;
+    superblock_.inode_chunk_map_head_idx = INVALID_BLOCK_ID;
+    superblock_.inode_chunk_count = 0;
+    inode_chunk_blocks_.clear();
+    inode_chunk_map_blocks_.clear();
+    inode_alloc_hint_ = 0;
+    superblock_.block_refcount_head_idx = INVALID_BLOCK_ID;
+    superblock_.shared_blocks_count = 0;
+    shared_blocks_.clear();
+    refcount_slots_.clear();
+    refcount_table_blocks_.clear();
 
     superblock_.root_dir_inode_idx = ROOT_DIRECTORY_INODE_ID;
+    superblock_.orphan_dir_inode_idx = ORPHAN_DIRECTORY_INODE_ID;
+    superblock_.name_index_inode_idx = INVALID_INODE_ID;
+    superblock_.state = VolumeState::CLEAN; // 刚格式化的卷计数准确，首次挂载无需恢复
     superblock_.max_filename_length = MAX_FILENAME_LENGTH;
     superblock_.max_path_length = MAX_PATH_LENGTH;
 
-    // 初始化 i-node 位图 (所有位清零)
-    std::vector<char> zero_buffer(blockSize);
-    std::memset(zero_buffer.data(), 0, blockSize);
-    for (int i = 0; i < superblock_.inode_bitmap_blocks_count; ++i)
+    // 建立空日志: 日志区中残留的旧事务不会在下次挂载时被重放
+    bool journal_ok = superblock_.journal_blocks_count > 0
+                          ? vdisk_->formatJournal(superblock_.journal_start_block_idx, superblock_.journal_blocks_count)
+                          : vdisk_->closeJournal();
+    if (!journal_ok)
+    {
+        std::cerr << "错误: 格式化期间初始化元数据日志失败。" << std::endl;
+        return false;
+    }
+
+    // i-node 位图不在这里清零: growInodeTable 在 i-node 表增长到某个位图块时才清零该块
+    superblock_.inode_bitmap_initialized_blocks = 0;
+
+    // 初始化空闲块结构，之后才能从数据区分配 i-node 块
+    initializeFreeBlockGroups();
+
+    for (long long i = 0; i < initial_chunks; ++i)
     {
-        if (!writeInodeBitmapBlock(i, zero_buffer.data()))
-        { // 使用相对位图块的偏移
-            std::cerr << "错误: 格式化期间初始化i-node位图块 " << i << " 失败。" << std::endl;
+        if (!growInodeTable())
+        {
+            std::cerr << "错误: 格式化期间分配初始i-node块失败。" << std::endl;
             return false;
         }
     }
@@ -249,114 +379,257 @@ bool SuperBlockManager::formatFileSystem(int totalInodes, int blockSize)
         std::cerr << "错误: 格式化期间无法标记根i-node " << ROOT_DIRECTORY_INODE_ID << " 为已使用。" << std::endl;
         return false;
     }
-    superblock_.free_inodes_count = superblock_.total_inodes - 1; // 减去根i-node
-
-    // 初始化成组链接法的空闲块堆栈
-    initializeFreeBlockGroups();
-
-    if (!saveSuperBlock())
+    superblock_.free_inodes_count--; // 减去根i-node
+    // 孤儿目录的 i-node 同样在格式化时保留
+    if (!setInodeBit(ORPHAN_DIRECTORY_INODE_ID, true))
     {
-        std::cerr << "错误: 格式化期间保存超级块失败。" << std::endl;
+        std::cerr << "错误: 格式化期间无法标记孤儿目录i-node " << ORPHAN_DIRECTORY_INODE_ID << " 为已使用。" << std::endl;
         return false;
     }
+    superblock_.free_inodes_count--;
+    inode_alloc_hint_ = ORPHAN_DIRECTORY_INODE_ID + 1;
 
-    // 清空i-node表区域 (可选，但推荐)
-    std::memset(zero_buffer.data(), 0, blockSize);
-    for (int i = 0; i < inode_table_blocks_count; ++i)
+    if (!saveSuperBlock())
     {
-        if (!vdisk_->writeBlock(superblock_.inode_table_start_block_idx + i, zero_buffer.data(), blockSize))
-        {
-            std::cerr << "警告: 格式化期间清空i-node表块 " << (superblock_.inode_table_start_block_idx + i) << " 失败。" << std::endl;
-        }
+        std::cerr << "错误: 格式化期间保存超级块失败。" << std::endl;
+        return false;
     }
 
-    std::cout << "信息: 文件系统已成功格式化 (使用i-node位图)。" << std::endl;
-    std::cout << "  i-node位图起始块: " << superblock_.inode_bitmap_start_block_idx << ", 占用: " << superblock_.inode_bitmap_blocks_count << " 块" << std::endl;
-    std::cout << "  i-node表起始块: " << superblock_.inode_table_start_block_idx << ", 占用: " << inode_table_blocks_count << " 块" << std::endl;
+    std::cout << "信息: 文件系统已成功格式化 (i-node按需分配)。" << std::endl;
+    std::cout << "  i-node位图起始块: " << superblock_.inode_bitmap_start_block_idx << ", 占用: " << superblock_.inode_bitmap_blocks_count
+              << " 块 (最多 " << superblock_.max_inodes << " 个i-node)" << std::endl;
+    std::cout << "  初始i-node块: " << superblock_.inode_chunk_count << " 个, 每块 " << inodes_per_block << " 个i-node" << std::endl;
+    std::cout << "  日志起始块: " << superblock_.journal_start_block_idx << ", 占用: " << superblock_.journal_blocks_count << " 块" << std::endl;
     std::cout << "  第一个数据块索引: " << superblock_.first_data_block_idx << std::endl;
     std::cout << "  空闲i-node数: " << superblock_.free_inodes_count << std::endl;
 
     return true;
 }
 
-// 初始化成组链接法的空闲块组 (与之前版本基本一致)
-void SuperBlockManager::initializeFreeBlockGroups()
+int SuperBlockManager::inodesPerChunk() const
 {
-    if (superblock_.free_blocks_count == 0)
+    return superblock_.block_size / superblock_.inode_size;
+}
+
+BlockId SuperBlockManager::inodeChunkBlock(int chunk) const
+{
+    if (chunk < 0 || static_cast<size_t>(chunk) >= inode_chunk_blocks_.size())
     {
-        superblock_.free_block_stack_top_idx = INVALID_BLOCK_ID;
-        return;
+        return INVALID_BLOCK_ID;
     }
+    return inode_chunk_blocks_[chunk];
+}
 
-    std::vector<int> available_blocks_for_groups_and_data;
-    for (long long i = superblock_.first_data_block_idx; i < superblock_.total_blocks; ++i)
+// 挂载时沿 chunk 映射块链建立 chunk 号到块号的内存索引
+bool SuperBlockManager::loadInodeChunkMap()
+{
+    inode_chunk_blocks_.clear();
+    inode_chunk_map_blocks_.clear();
+    inode_alloc_hint_ = 0;
+
+    int entries_per_map_block = freeBlocksPerGroup();
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size, false);
+    const BlockId *entries = reinterpret_cast<const BlockId *>(buffer.data());
+    BlockId map_block = superblock_.inode_chunk_map_head_idx;
+    int remaining = superblock_.inode_chunk_count;
+    inode_chunk_blocks_.reserve(remaining);
+    while (remaining > 0)
     {
-        available_blocks_for_groups_and_data.push_back(static_cast<int>(i));
+        if (map_block < superblock_.first_data_block_idx || map_block >= superblock_.total_blocks ||
+            !vdisk_->readBlock(map_block, buffer.data(), superblock_.block_size))
+        {
+            std::cerr << "错误: 无法读取 i-node 块映射块 " << map_block << "。" << std::endl;
+            return false;
+        }
+        inode_chunk_map_blocks_.push_back(map_block);
+        int count = std::min(remaining, entries_per_map_block);
+        inode_chunk_blocks_.insert(inode_chunk_blocks_.end(), entries + 1, entries + 1 + count);
+        remaining -= count;
+        map_block = entries[0];
     }
-    // superblock_.free_blocks_count 已经在 formatFileSystem 中正确设置了初始值
-
-    if (available_blocks_for_groups_and_data.empty())
+    if (superblock_.total_inodes != superblock_.inode_chunk_count * inodesPerChunk())
     {
-        superblock_.free_block_stack_top_idx = INVALID_BLOCK_ID;
-        return;
+        std::cerr << "错误: 超级块中的 i-node 数 " << superblock_.total_inodes << " 与 i-node 块数 "
+                  << superblock_.inode_chunk_count << " 不一致。" << std::endl;
+        return false;
     }
+    return true;
+}
 
-    const int ids_per_group_block = (superblock_.block_size / sizeof(int)) - 1;
-    if (ids_per_group_block <= 0)
+// 从数据区分配一个新的 i-node 块 (清零)，把块号追加到 chunk 映射块链末尾；
+// 末尾映射块已满时先分配新的映射块并链接到链尾。
+bool SuperBlockManager::growInodeTable()
+{
+    int inodes_per_chunk = inodesPerChunk();
+    if (static_cast<long long>(superblock_.total_inodes) + inodes_per_chunk > superblock_.max_inodes)
     {
-        std::cerr << "错误 (initializeFreeBlockGroups): block_size " << superblock_.block_size << " 太小。" << std::endl;
-        superblock_.free_block_stack_top_idx = INVALID_BLOCK_ID;
-        return;
+        std::cerr << "错误: i-node 数已达上限 " << superblock_.max_inodes << "。" << std::endl;
+        return false;
     }
 
-    std::vector<char> block_buffer(superblock_.block_size);
-    FreeBlockGroup *current_group_struct = reinterpret_cast<FreeBlockGroup *>(block_buffer.data());
-    int next_super_group_block_id = INVALID_BLOCK_ID;
-
-    // 从后向前取块作为组头，这样栈顶组的ID较高
-    while (!available_blocks_for_groups_and_data.empty())
+    int block_size = superblock_.block_size;
+    BlockId chunk_block = allocateBlock();
+    if (chunk_block == INVALID_BLOCK_ID)
     {
-        int current_s_group_block_id = available_blocks_for_groups_and_data.back();
-        available_blocks_for_groups_and_data.pop_back();
+        return false;
+    }
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(block_size); // 已清零
+    if (!vdisk_->writeBlock(chunk_block, buffer.data(), block_size))
+    {
+        freeBlock(chunk_block);
+        return false;
+    }
 
-        std::memset(block_buffer.data(), 0, superblock_.block_size);
-        current_group_struct->count = 0;
+    // 新 i-node 用到的位图块在第一次使用前清零
+    long long last_bitmap_block = (static_cast<long long>(superblock_.total_inodes) + inodes_per_chunk - 1) / (static_cast<long long>(block_size) * 8);
+    while (superblock_.inode_bitmap_initialized_blocks <= last_bitmap_block)
+    {
+        if (!writeInodeBitmapBlock(superblock_.inode_bitmap_initialized_blocks, buffer.data()))
+        {
+            freeBlock(chunk_block);
+            return false;
+        }
+        superblock_.inode_bitmap_initialized_blocks++;
+    }
 
-        if (next_super_group_block_id != INVALID_BLOCK_ID)
+    BlockId *entries = reinterpret_cast<BlockId *>(buffer.data());
+    int entries_per_map_block = freeBlocksPerGroup();
+    int slot = superblock_.inode_chunk_count % entries_per_map_block;
+    if (slot == 0)
+    {
+        BlockId map_block = allocateBlock();
+        if (map_block == INVALID_BLOCK_ID)
         {
-            if (current_group_struct->count < N_FREE_BLOCKS_PER_GROUP)
-            { // N_FREE_BLOCKS_PER_GROUP 是数组大小
-                current_group_struct->next_group_block_ids[current_group_struct->count++] = next_super_group_block_id;
+            freeBlock(chunk_block);
+            return false;
+        }
+        entries[0] = INVALID_BLOCK_ID; // buffer 仍为全零，只需设置链接指针
+        entries[1] = chunk_block;
+        if (!vdisk_->writeBlock(map_block, buffer.data(), block_size))
+        {
+            freeBlock(map_block);
+            freeBlock(chunk_block);
+            return false;
+        }
+        if (inode_chunk_map_blocks_.empty())
+        {
+            superblock_.inode_chunk_map_head_idx = map_block;
+        }
+        else
+        {
+            BlockId tail = inode_chunk_map_blocks_.back();
+            if (!vdisk_->readBlock(tail, buffer.data(), block_size))
+            {
+                return false;
             }
-            else
-            { // 这种情况不应该发生，因为我们刚取出一个块做组头，count 应该是0
-                std::cerr << "错误 (initializeFreeBlockGroups): 组已满，无法存储 next_super_group_block_id。" << std::endl;
-                available_blocks_for_groups_and_data.push_back(current_s_group_block_id); // 归还
-                break;
+            entries[0] = map_block;
+            if (!vdisk_->writeBlock(tail, buffer.data(), block_size))
+            {
+                return false;
             }
         }
+        inode_chunk_map_blocks_.push_back(map_block);
+    }
+    else
+    {
+        BlockId tail = inode_chunk_map_blocks_.back();
+        if (!vdisk_->readBlock(tail, buffer.data(), block_size))
+        {
+            freeBlock(chunk_block);
+            return false;
+        }
+        entries[1 + slot] = chunk_block;
+        if (!vdisk_->writeBlock(tail, buffer.data(), block_size))
+        {
+            freeBlock(chunk_block);
+            return false;
+        }
+    }
+
+    inode_chunk_blocks_.push_back(chunk_block);
+    superblock_.inode_chunk_count++;
+    superblock_.total_inodes += inodes_per_chunk;
+    superblock_.free_inodes_count += inodes_per_chunk;
+    if (!saveSuperBlock())
+    {
+        std::cerr << "警告: 分配 i-node 块后保存超级块失败。" << std::endl;
+    }
+    return true;
+}
 
-        while (current_group_struct->count < N_FREE_BLOCKS_PER_GROUP && !available_blocks_for_groups_and_data.empty())
+// 在位图中查找第一个空闲 i-node (从 inode_alloc_hint_ 起，只查已分配 i-node 块中的 i-node)，
+// 逐个位图块读取，整字节已满时一次跳过 8 个 i-node
+int SuperBlockManager::findFreeInode()
+{
+    int bits_per_block = superblock_.block_size * 8;
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size, false);
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(buffer.data());
+    int inode_id = std::max(inode_alloc_hint_, 0);
+    while (inode_id < superblock_.total_inodes)
+    {
+        int bitmap_block = inode_id / bits_per_block;
+        if (!readInodeBitmapBlock(bitmap_block, buffer.data()))
         {
-            current_group_struct->next_group_block_ids[current_group_struct->count++] = available_blocks_for_groups_and_data.back();
-            available_blocks_for_groups_and_data.pop_back();
+            return INVALID_INODE_ID;
+        }
+        int block_first = bitmap_block * bits_per_block;
+        int block_end = static_cast<int>(std::min<long long>(superblock_.total_inodes, static_cast<long long>(block_first) + bits_per_block));
+        while (inode_id < block_end)
+        {
+            unsigned char byte = bytes[(inode_id - block_first) / 8];
+            if ((inode_id & 7) == 0 && byte == 0xFF)
+            {
+                inode_id += 8;
+                continue;
+            }
+            if (((byte >> (inode_id & 7)) & 1) == 0)
+            {
+                return inode_id;
+            }
+            ++inode_id;
         }
-        vdisk_->writeBlock(current_s_group_block_id, block_buffer.data(), superblock_.block_size);
-        next_super_group_block_id = current_s_group_block_id;
     }
-    superblock_.free_block_stack_top_idx = next_super_group_block_id;
+    return INVALID_INODE_ID;
+}
+
+// 初始化空闲块结构 (O(1)，不写任何块)
+// 格式化后数据区整体是一段从未分配过的空闲区间 [free_extent_start_idx, total_blocks)，由 allocateBlock 顺序切分；
+// 成组链接的空闲块堆栈只由 freeBlock 释放的块逐步建立。
+// 每个组块的 next_group_block_ids[0] 固定存放下一组组块的块号 (栈底组为 INVALID_BLOCK_ID)，
+// next_group_block_ids[1..count-1] 为本组管理的空闲块；组块本身也计入 free_blocks_count。
+void SuperBlockManager::initializeFreeBlockGroups()
+{
+    superblock_.free_block_stack_top_idx = INVALID_BLOCK_ID;
+    superblock_.free_extent_start_idx = superblock_.first_data_block_idx;
 }
 
-// 分配一个空闲数据块 (与之前版本基本一致)
-int SuperBlockManager::allocateBlock()
+// 分配一个空闲数据块
+// 优先使用被释放过的块: 栈顶组还有空闲块时从组内取出最后一个；只剩链接指针时，把组块本身分配出去，
+// 其 next_group_block_ids[0] 指向的组成为新的栈顶。堆栈为空时从未分配区间的开头顺序取块。
+BlockId SuperBlockManager::allocateBlock()
 {
-    if (superblock_.free_blocks_count == 0 || superblock_.free_block_stack_top_idx == INVALID_BLOCK_ID)
+    if (superblock_.free_blocks_count == 0)
     {
         std::cerr << "错误: 没有空闲数据块可分配。" << std::endl;
         return INVALID_BLOCK_ID;
     }
+    if (superblock_.free_block_stack_top_idx == INVALID_BLOCK_ID)
+    {
+        if (superblock_.free_extent_start_idx >= superblock_.total_blocks)
+        {
+            std::cerr << "错误: 空闲块计数为 " << superblock_.free_blocks_count << "，但没有可分配的空闲块。" << std::endl;
+            return INVALID_BLOCK_ID;
+        }
+        BlockId block_id = superblock_.free_extent_start_idx++;
+        superblock_.free_blocks_count--;
+        if (!saveSuperBlock())
+        {
+            std::cerr << "警告: 分配块后保存超级块失败。" << std::endl;
+        }
+        return block_id;
+    }
 
-    std::vector<char> buffer(superblock_.block_size);
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size);
     FreeBlockGroup *group_block = reinterpret_cast<FreeBlockGroup *>(buffer.data());
 
     if (!vdisk_->readBlock(superblock_.free_block_stack_top_idx, buffer.data(), superblock_.block_size))
@@ -365,74 +638,31 @@ int SuperBlockManager::allocateBlock()
         return INVALID_BLOCK_ID;
     }
 
-    if (group_block->count == 0)
+    if (group_block->count <= 0 || group_block->count > freeBlocksPerGroup())
     {
-        std::cerr << "错误: 空闲块组 " << superblock_.free_block_stack_top_idx << " 为空 (count=0)。" << std::endl;
+        std::cerr << "错误: 空闲块组 " << superblock_.free_block_stack_top_idx << " 已损坏 (count="
+                  << group_block->count << ")。" << std::endl;
         return INVALID_BLOCK_ID;
     }
 
-    group_block->count--;
-    int allocated_block_id = group_block->next_group_block_ids[group_block->count];
-
-    if (group_block->count == 0)
-    { // 组内指针用完，切换到下一组
-        // 假设 next_group_block_ids[0] (当count减为0之前，它是最后一个有效指针的前一个)
-        // 或者说，当count最初是1时，next_group_block_ids[0]是最后一个数据块指针，
-        // 此时，这个组块本身需要变成下一个组（如果它之前链接了的话）。
-        // 经典成组链接：当一个组的count减到0，它所指向的下一个组（通常是它自己存储的第一个指针）成为新的栈顶
-        // 并且这个旧的组块被释放。
-        // 简化：如果count为0，我们假设这个组块已空，并且在初始化时，
-        // next_group_block_ids[0] (当count > 0时) 指向下一个“超级组”。
-        // 当分配到只剩一个指针（即count=1，这个指针是next_group_block_ids[0]），
-        // 分配它之后，count=0。此时，superblock_.free_block_stack_top_idx 应该更新为
-        // 之前存储在这个组块中的“下一组”的指针。
-        // 这个逻辑在 initializeFreeBlockGroups 和 freeBlock 中更为关键。
-        // 在 allocateBlock 中，如果 count 变为0，则意味着这个组块的最后一个“数据块指针”被分配了。
-        // 它内部应该有一个指针指向下一个组。
-        // 假设这个指针是 next_group_block_ids[0] （在 count 减为 0 之前，它被视为数据指针，
-        // 但如果它是最后一个，且这个组是“超级组”，它实际上是链接指针）。
-        // 这是一个复杂点。
-        // 按照《操作系统概念》的成组链接法：
-        // S.count 是组内空闲块数（不包括指向下一组的指针）
-        // S.free[0] 是下一组的指针
-        // S.free[1]...S.free[S.count] 是空闲块
-        // 分配 S.free[S.count]，然后 S.count--.
-        // 如果 S.count == 0，则 superblock_.free_block_stack_top_idx = S.free[0].
-        // 我们的 FreeBlockGroup 结构是：count, next_group_block_ids[N_FREE_BLOCKS_PER_GROUP]
-        // 分配：allocated_block_id = group_block->next_group_block_ids[group_block->count]; (count已经是减1后的)
-        // 如果 group_block->count == 0 (表示这个组的“数据块指针”用完了)
-        // 那么，这个组块本身（superblock_.free_block_stack_top_idx）需要被处理。
-        // 它应该包含指向下一个“超级组”的指针。
-        // 假设这个指针存储在 group_block->next_group_block_ids[0] 当 count 为特殊值时，
-        // 或者在初始化时，如果一个组满了，它的最后一个指针指向下一个组。
-
-        // 采用《操作系统概念》模型：
-        // allocated_block_id = group_block->next_group_block_ids[group_block->count]; (count已经是减1后的)
-        // 如果 group_block->count == 0 (表示这个组的“数据块指针”用完了)
-        // 此时，group_block->next_group_block_ids[0] （在count减为0之前，它是第一个数据指针）
-        // 应该被视为指向下一个组的指针。
-        // 这个逻辑在 `freeBlock` 中当栈顶组满时，新的块成为新的栈顶组，
-        // 它的 `next_group_block_ids[0]` 会存储旧的栈顶。
-        // 所以，当 `count` 变为0时，`next_group_block_ids[0]` 就是下一个栈顶。
-        int next_stack_top = group_block->next_group_block_ids[0]; // 假设这是链接
-        // 旧的组块 superblock_.free_block_stack_top_idx 现在是空闲的，但它不是一个“数据块”
-        // 在成组链接法中，当一个组被耗尽，它通常不会立即被“释放”为普通数据块，
-        // 而是链表指针更新。
-        superblock_.free_block_stack_top_idx = next_stack_top;
-        // 注意：这里没有写回 group_block 的修改（count=0），因为这个块即将不再是栈顶。
-    }
-    else
+    BlockId allocated_block_id;
+    if (group_block->count > 1)
     {
-        // 如果组未空，需要将修改后的组（count减少）写回磁盘
+        allocated_block_id = group_block->next_group_block_ids[--group_block->count];
         if (!vdisk_->writeBlock(superblock_.free_block_stack_top_idx, buffer.data(), superblock_.block_size))
         {
             std::cerr << "错误: 更新空闲块组 " << superblock_.free_block_stack_top_idx << " 失败。" << std::endl;
-            // 回滚操作？这很复杂。可能需要标记文件系统为不一致状态。
-            // superblock_.free_blocks_count++; // 尝试恢复计数，但不安全
             return INVALID_BLOCK_ID; // 分配失败
         }
     }
-    superblock_.free_blocks_count--; // 这个应该在分配成功后执行
+    else
+    {
+        // 组内只剩链接指针：组块本身作为数据块分配，下一组成为栈顶
+        allocated_block_id = superblock_.free_block_stack_top_idx;
+        superblock_.free_block_stack_top_idx = group_block->next_group_block_ids[0];
+    }
+
+    superblock_.free_blocks_count--;
     if (!saveSuperBlock())
     {
         std::cerr << "警告: 分配块后保存超级块失败。" << std::endl;
@@ -440,8 +670,9 @@ int SuperBlockManager::allocateBlock()
     return allocated_block_id;
 }
 
-// 释放一个数据块 (与之前版本基本一致，但适配了成组链接法模型)
-void SuperBlockManager::freeBlock(int blockId)
+// 释放一个数据块
+// 栈顶组未满时把块号加入栈顶组；否则被释放的块自身成为新的栈顶组，链接指向旧栈顶。
+void SuperBlockManager::freeBlock(BlockId blockId)
 {
     if (blockId < superblock_.first_data_block_idx || blockId >= superblock_.total_blocks)
     {
@@ -449,10 +680,23 @@ void SuperBlockManager::freeBlock(int blockId)
         return;
     }
 
-    std::vector<char> buffer(superblock_.block_size);
+    auto shared = shared_blocks_.find(blockId);
+    if (shared != shared_blocks_.end())
+    {
+        // 共享块: 只去掉一个引用，块仍被其他文件使用
+        if (--shared->second.references >= 2)
+        {
+            writeRefCountSlot(shared->second.slot);
+        }
+        else
+        {
+            dropRefCountSlot(blockId);
+        }
+        return;
+    }
+
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size);
     FreeBlockGroup *group_block_struct = reinterpret_cast<FreeBlockGroup *>(buffer.data());
-    // const int ids_per_group_block = (superblock_.block_size / sizeof(int)) - 1;
-    // N_FREE_BLOCKS_PER_GROUP 是数组大小，不是ids_per_group_block
 
     bool stack_top_is_full = false;
     if (superblock_.free_block_stack_top_idx != INVALID_BLOCK_ID)
@@ -462,7 +706,7 @@ void SuperBlockManager::freeBlock(int blockId)
             std::cerr << "错误: 释放块时无法读取栈顶空闲组 " << superblock_.free_block_stack_top_idx << std::endl;
             return;
         }
-        if (group_block_struct->count >= N_FREE_BLOCKS_PER_GROUP)
+        if (group_block_struct->count >= freeBlocksPerGroup())
         { // 组内指针数组已满
             stack_top_is_full = true;
         }
@@ -474,22 +718,16 @@ void SuperBlockManager::freeBlock(int blockId)
 
     if (stack_top_is_full)
     {
-        // 当前栈顶组已满，将要释放的 blockId 自身变成新的栈顶组。
-        // 新组的第一个指针指向旧的栈顶组。
+        // 将要释放的 blockId 自身变成新的栈顶组，链接指针指向旧的栈顶组 (可能为 INVALID_BLOCK_ID)
         std::memset(buffer.data(), 0, superblock_.block_size);
-        group_block_struct->count = 0; // 初始化计数
-        if (superblock_.free_block_stack_top_idx != INVALID_BLOCK_ID)
-        {
-            group_block_struct->next_group_block_ids[group_block_struct->count++] = superblock_.free_block_stack_top_idx;
-        }
-        // 新的栈顶是 blockId
-        superblock_.free_block_stack_top_idx = blockId;
-        if (!vdisk_->writeBlock(superblock_.free_block_stack_top_idx, buffer.data(), superblock_.block_size))
+        group_block_struct->next_group_block_ids[0] = superblock_.free_block_stack_top_idx;
+        group_block_struct->count = 1;
+        if (!vdisk_->writeBlock(blockId, buffer.data(), superblock_.block_size))
         {
             std::cerr << "错误: 无法将块 " << blockId << " 初始化为新的空闲组。" << std::endl;
-            // 回滚 superblock_.free_block_stack_top_idx ?
             return;
         }
+        superblock_.free_block_stack_top_idx = blockId;
     }
     else
     {
@@ -511,50 +749,35 @@ void SuperBlockManager::freeBlock(int blockId)
 }
 
 // 分配一个空闲i-node (使用i-node位图)
+// 已分配的 i-node 块都用完时先增长 i-node 表，再从新的 i-node 块中分配
 int SuperBlockManager::allocateInode()
 {
-    if (superblock_.free_inodes_count == 0)
-    {
-        std::cerr << "信息: 没有空闲i-node可分配。" << std::endl;
-        return INVALID_INODE_ID;
-    }
-
-    for (int i = 0; i < superblock_.total_inodes; ++i)
+    int inode_id = (superblock_.free_inodes_count > 0) ? findFreeInode() : INVALID_INODE_ID;
+    if (inode_id == INVALID_INODE_ID)
     {
-        bool is_used;
-        if (!getInodeBit(i, is_used))
+        int first_new_inode = superblock_.total_inodes;
+        if (!growInodeTable())
         {
-            std::cerr << "错误: 检查i-node " << i << " 状态失败。" << std::endl;
-            return INVALID_INODE_ID; // 严重错误，无法继续
-        }
-        if (!is_used)
-        {
-            // 找到一个空闲i-node
-            if (!setInodeBit(i, true))
-            {
-                std::cerr << "错误: 标记i-node " << i << " 为已使用失败。" << std::endl;
-                return INVALID_INODE_ID; // 严重错误
-            }
-            superblock_.free_inodes_count--;
-            if (!saveSuperBlock())
-            {
-                std::cerr << "警告: 分配i-node " << i << " 后保存超级块失败。" << std::endl;
-                // 应该回滚 setInodeBit 和 free_inodes_count 吗？复杂。
-                // 暂时不回滚，但标记文件系统可能不一致。
-            }
-            // 在这里可以进行新分配inode的初始化清零操作，或者由InodeManager负责
-            // Inode new_inode_content = {}; // 创建一个全零的inode
-            // new_inode_content.inode_id = i; // 如果inode结构体中存储id
-            // InodeManager temp_im(vdisk_, this); // 不推荐这样临时创建
-            // if (!temp_im.writeInode(i, new_inode_content)) {
-            //    std::cerr << "警告: 初始化新分配的inode " << i << " 失败。" << std::endl;
-            // }
-            return i;
+            std::cerr << "信息: 没有空闲i-node可分配。" << std::endl;
+            return INVALID_INODE_ID;
         }
+        inode_id = first_new_inode;
     }
 
-    std::cerr << "错误: free_inodes_count > 0 但未能在位图中找到空闲i-node。位图可能已损坏。" << std::endl;
-    return INVALID_INODE_ID; // 未找到 (理论上不应发生如果free_inodes_count正确)
+    if (!setInodeBit(inode_id, true))
+    {
+        std::cerr << "错误: 标记i-node " << inode_id << " 为已使用失败。" << std::endl;
+        return INVALID_INODE_ID; // 严重错误
+    }
+    superblock_.free_inodes_count--;
+    inode_alloc_hint_ = inode_id + 1;
+    if (!saveSuperBlock())
+    {
+        std::cerr << "警告: 分配i-node " << inode_id << " 后保存超级块失败。" << std::endl;
+        // 应该回滚 setInodeBit 和 free_inodes_count 吗？复杂。
+        // 暂时不回滚，但标记文件系统可能不一致。
+    }
+    return inode_id;
 }
 
 // 释放一个i-node (使用i-node位图)
@@ -586,6 +809,7 @@ void SuperBlockManager::freeInode(int inodeId)
     }
 
     superblock_.free_inodes_count++;
+    inode_alloc_hint_ = std::min(inode_alloc_hint_, inodeId);
     if (superblock_.free_inodes_count > superblock_.total_inodes)
     {
         std::cerr << "警告: free_inodes_count (" << superblock_.free_inodes_count
@@ -600,7 +824,379 @@ void SuperBlockManager::freeInode(int inodeId)
     }
 }
 
+// 批量释放数据块 (删除、截断时使用)。逐个调用 freeBlock 时每个块都要读改写一次栈顶组并保存一次超级块；
+// 这里先去掉共享块的引用，其余的块排序后依次装入栈顶组: 组在内存中填满后才写回，下一个块成为新的栈顶组。
+// 块号按降序压栈，之后 allocateBlock 从栈顶取块时得到升序、尽量连续的块号。
+void SuperBlockManager::freeBlocks(std::vector<BlockId> blockIds)
+{
+    std::vector<BlockId> unshared;
+    unshared.reserve(blockIds.size());
+    for (BlockId block_id : blockIds)
+    {
+        if (block_id < superblock_.first_data_block_idx || block_id >= superblock_.total_blocks)
+        {
+            std::cerr << "警告: 尝试释放一个无效的数据块ID " << block_id << "." << std::endl;
+        }
+        else if (shared_blocks_.count(block_id) != 0)
+        {
+            freeBlock(block_id); // 只减少引用数
+        }
+        else
+        {
+            unshared.push_back(block_id);
+        }
+    }
+    if (unshared.empty())
+    {
+        return;
+    }
+    std::sort(unshared.begin(), unshared.end(), std::greater<BlockId>());
+
+    int block_size = superblock_.block_size;
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(block_size);
+    FreeBlockGroup *group = reinterpret_cast<FreeBlockGroup *>(buffer.data());
+    BlockId group_block = superblock_.free_block_stack_top_idx;
+    bool group_dirty = false;
+    if (group_block != INVALID_BLOCK_ID && !vdisk_->readBlock(group_block, buffer.data(), block_size))
+    {
+        std::cerr << "错误: 释放块时无法读取栈顶空闲组 " << group_block << std::endl;
+        return;
+    }
+
+    for (BlockId block_id : unshared)
+    {
+        if (group_block != INVALID_BLOCK_ID && group->count < freeBlocksPerGroup())
+        {
+            group->next_group_block_ids[group->count++] = block_id;
+            group_dirty = true;
+        }
+        else
+        {
+            // 栈顶组已满 (或没有栈顶组): 写回它，被释放的块成为新的栈顶组
+            if (group_dirty && !vdisk_->writeBlock(group_block, buffer.data(), block_size))
+            {
+                std::cerr << "错误: 无法写回空闲组 " << group_block << std::endl;
+                return; // 与 freeBlock 一样不更新超级块: 已写出的组不可达，只是泄漏
+            }
+            std::memset(buffer.data(), 0, block_size);
+            group->next_group_block_ids[0] = group_block;
+            group->count = 1;
+            group_block = block_id;
+            group_dirty = true;
+        }
+    }
+    if (group_dirty && !vdisk_->writeBlock(group_block, buffer.data(), block_size))
+    {
+        std::cerr << "错误: 无法写回空闲组 " << group_block << std::endl;
+        return;
+    }
+
+    superblock_.free_block_stack_top_idx = group_block;
+    superblock_.free_blocks_count += static_cast<long long>(unshared.size());
+    if (!saveSuperBlock())
+    {
+        std::cerr << "警告: 释放块后保存超级块失败。" << std::endl;
+    }
+}
+
+// 每个引用计数表块能登记的共享块数
+int SuperBlockManager::refCountsPerTableBlock() const
+{
+    return freeBlocksPerGroup() / 2;
+}
+
+// 挂载时沿引用计数表块链建立共享块的内存索引
+bool SuperBlockManager::loadBlockRefCounts()
+{
+    shared_blocks_.clear();
+    refcount_slots_.clear();
+    refcount_table_blocks_.clear();
+
+    int per_table_block = refCountsPerTableBlock();
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size, false);
+    const BlockId *entries = reinterpret_cast<const BlockId *>(buffer.data());
+    const BlockRefCount *counts = reinterpret_cast<const BlockRefCount *>(entries + 1);
+    BlockId table_block = superblock_.block_refcount_head_idx;
+    long long remaining = superblock_.shared_blocks_count;
+    refcount_slots_.reserve(remaining);
+    while (remaining > 0)
+    {
+        if (table_block < superblock_.first_data_block_idx || table_block >= superblock_.total_blocks ||
+            !vdisk_->readBlock(table_block, buffer.data(), superblock_.block_size))
+        {
+            std::cerr << "错误: 无法读取引用计数表块 " << table_block << "。" << std::endl;
+            return false;
+        }
+        refcount_table_blocks_.push_back(table_block);
+        int count = static_cast<int>(std::min<long long>(remaining, per_table_block));
+        for (int i = 0; i < count; ++i)
+        {
+            if (counts[i].references < 2 || shared_blocks_.count(counts[i].block_id) != 0)
+            {
+                std::cerr << "错误: 引用计数表块 " << table_block << " 已损坏。" << std::endl;
+                return false;
+            }
+            shared_blocks_[counts[i].block_id] = {counts[i].references, refcount_slots_.size()};
+            refcount_slots_.push_back(counts[i].block_id);
+        }
+        remaining -= count;
+        table_block = entries[0];
+    }
+    return true;
+}
+
+bool SuperBlockManager::writeRefCountSlot(size_t slot)
+{
+    int per_table_block = refCountsPerTableBlock();
+    BlockId table_block = refcount_table_blocks_[slot / per_table_block];
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size, false);
+    if (!vdisk_->readBlock(table_block, buffer.data(), superblock_.block_size))
+    {
+        std::cerr << "错误: 无法读取引用计数表块 " << table_block << "。" << std::endl;
+        return false;
+    }
+    BlockRefCount *counts = reinterpret_cast<BlockRefCount *>(reinterpret_cast<BlockId *>(buffer.data()) + 1);
+    BlockId block_id = refcount_slots_[slot];
+    counts[slot % per_table_block] = {block_id, shared_blocks_.at(block_id).references};
+    if (!vdisk_->writeBlock(table_block, buffer.data(), superblock_.block_size))
+    {
+        std::cerr << "错误: 无法更新引用计数表块 " << table_block << "。" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 块多了一处引用。第一次被共享时在表尾登记 (引用数 2)，表尾的表块已满时先分配新表块并链接到链尾。
+bool SuperBlockManager::addBlockReference(BlockId blockId)
+{
+    if (blockId < superblock_.first_data_block_idx || blockId >= superblock_.total_blocks)
+    {
+        std::cerr << "错误: 尝试共享一个无效的数据块ID " << blockId << "。" << std::endl;
+        return false;
+    }
+    auto shared = shared_blocks_.find(blockId);
+    if (shared != shared_blocks_.end())
+    {
+        shared->second.references++;
+        return writeRefCountSlot(shared->second.slot);
+    }
+
+    size_t slot = refcount_slots_.size();
+    int block_size = superblock_.block_size;
+    if (slot % refCountsPerTableBlock() == 0)
+    {
+        BlockId table_block = allocateBlock();
+        if (table_block == INVALID_BLOCK_ID)
+        {
+            return false;
+        }
+        AlignedBuffer buffer = vdisk_->bufferPool().acquire(block_size); // 已清零
+        BlockId *entries = reinterpret_cast<BlockId *>(buffer.data());
+        entries[0] = INVALID_BLOCK_ID;
+        if (!vdisk_->writeBlock(table_block, buffer.data(), block_size))
+        {
+            freeBlock(table_block);
+            return false;
+        }
+        if (refcount_table_blocks_.empty())
+        {
+            superblock_.block_refcount_head_idx = table_block;
+        }
+        else
+        {
+            BlockId tail = refcount_table_blocks_.back();
+            if (!vdisk_->readBlock(tail, buffer.data(), block_size))
+            {
+                freeBlock(table_block);
+                return false;
+            }
+            entries[0] = table_block;
+            if (!vdisk_->writeBlock(tail, buffer.data(), block_size))
+            {
+                freeBlock(table_block);
+                return false;
+            }
+        }
+        refcount_table_blocks_.push_back(table_block);
+    }
+
+    shared_blocks_[blockId] = {2, slot};
+    refcount_slots_.push_back(blockId);
+    if (!writeRefCountSlot(slot))
+    {
+        shared_blocks_.erase(blockId);
+        refcount_slots_.pop_back();
+        return false;
+    }
+    superblock_.shared_blocks_count++;
+    if (!saveSuperBlock())
+    {
+        std::cerr << "警告: 登记共享块后保存超级块失败。" << std::endl;
+    }
+    return true;
+}
+
+// 共享块只剩一个引用: 从表中去掉，表尾一项移到空出的位置，使表保持紧凑；
+// 表尾的表块不再登记任何项时从链尾摘下并释放。
+bool SuperBlockManager::dropRefCountSlot(BlockId blockId)
+{
+    size_t slot = shared_blocks_.at(blockId).slot;
+    BlockId last = refcount_slots_.back();
+    shared_blocks_.erase(blockId);
+    refcount_slots_.pop_back();
+    bool ok = true;
+    if (last != blockId)
+    {
+        refcount_slots_[slot] = last;
+        shared_blocks_[last].slot = slot;
+        ok = writeRefCountSlot(slot);
+    }
+    superblock_.shared_blocks_count--;
+
+    size_t table_blocks_needed = (refcount_slots_.size() + refCountsPerTableBlock() - 1) / refCountsPerTableBlock();
+    if (refcount_table_blocks_.size() > table_blocks_needed)
+    {
+        BlockId tail = refcount_table_blocks_.back();
+        refcount_table_blocks_.pop_back();
+        if (refcount_table_blocks_.empty())
+        {
+            superblock_.block_refcount_head_idx = INVALID_BLOCK_ID;
+        }
+        else
+        {
+            BlockId previous = refcount_table_blocks_.back();
+            AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size, false);
+            BlockId *entries = reinterpret_cast<BlockId *>(buffer.data());
+            if (vdisk_->readBlock(previous, buffer.data(), superblock_.block_size))
+            {
+                entries[0] = INVALID_BLOCK_ID;
+                ok = vdisk_->writeBlock(previous, buffer.data(), superblock_.block_size) && ok;
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+        freeBlock(tail); // 同时保存超级块
+    }
+    else if (!saveSuperBlock())
+    {
+        std::cerr << "警告: 移除共享块后保存超级块失败。" << std::endl;
+    }
+    if (!ok)
+    {
+        std::cerr << "错误: 更新引用计数表失败 (块 " << blockId << ")。" << std::endl;
+    }
+    return ok;
+}
+
+long long SuperBlockManager::blockReferences(BlockId blockId) const
+{
+    auto shared = shared_blocks_.find(blockId);
+    return shared == shared_blocks_.end() ? 1 : shared->second.references;
+}
+
 const SuperBlock &SuperBlockManager::getSuperBlockInfo() const
 {
     return superblock_;
 }
+
+// 记录卸载状态: 挂载时置为 DIRTY，卸载前 (全部脏块写回之后) 置为 CLEAN。
+// 超级块写入后立即同步到磁盘，状态变化不能停留在块缓存中。
+bool SuperBlockManager::setVolumeState(VolumeState state)
+{
+    superblock_.state = state;
+    if (!saveSuperBlock() || !vdisk_->sync())
+    {
+        std::cerr << "错误: 无法将卸载状态写入超级块。" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 记录文件名索引文件的inode号 (INVALID_INODE_ID 表示删除索引)
+bool SuperBlockManager::setNameIndexInode(int inodeId)
+{
+    superblock_.name_index_inode_idx = inodeId;
+    if (!saveSuperBlock())
+    {
+        std::cerr << "错误: 无法记录文件名索引的 i-node。" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 统计空闲块数: 沿空闲块堆栈逐组累加 count (组块本身计入 count)，再加上从未分配过的区间。
+// 只读取空闲块组块，与已用数据量无关。
+long long SuperBlockManager::countFreeBlocks()
+{
+    long long free_blocks = superblock_.total_blocks - superblock_.free_extent_start_idx;
+    long long max_groups = superblock_.total_blocks - superblock_.first_data_block_idx; // 防止链成环
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size);
+    const FreeBlockGroup *group = reinterpret_cast<const FreeBlockGroup *>(buffer.data());
+    BlockId group_block = superblock_.free_block_stack_top_idx;
+    for (long long visited = 0; group_block != INVALID_BLOCK_ID; ++visited)
+    {
+        if (visited >= max_groups || group_block < superblock_.first_data_block_idx || group_block >= superblock_.total_blocks)
+        {
+            std::cerr << "错误: 空闲块堆栈在块 " << group_block << " 处损坏。" << std::endl;
+            return -1;
+        }
+        if (!vdisk_->readBlock(group_block, buffer.data(), superblock_.block_size))
+        {
+            std::cerr << "错误: 无法读取空闲块组 " << group_block << std::endl;
+            return -1;
+        }
+        if (group->count < 1 || group->count > freeBlocksPerGroup())
+        {
+            std::cerr << "错误: 空闲块组 " << group_block << " 已损坏 (count=" << group->count << ")。" << std::endl;
+            return -1;
+        }
+        free_blocks += group->count;
+        group_block = group->next_group_block_ids[0];
+    }
+    return free_blocks;
+}
+
+// 非正常卸载后的恢复: 超级块中的空闲计数可能与位图、空闲块堆栈不一致，按后两者重新统计。
+// 只扫描已提供的 i-node 对应的位图块和空闲块组块，不遍历目录树。
+bool SuperBlockManager::recoverFreeCounts()
+{
+    int bits_per_block = superblock_.block_size * 8;
+    int used_inodes = 0;
+    AlignedBuffer buffer = vdisk_->bufferPool().acquire(superblock_.block_size);
+    for (int first_bit = 0; first_bit < superblock_.total_inodes; first_bit += bits_per_block)
+    {
+        if (!readInodeBitmapBlock(first_bit / bits_per_block, buffer.data()))
+        {
+            return false;
+        }
+        int bits = std::min(bits_per_block, superblock_.total_inodes - first_bit);
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(buffer.data());
+        for (int i = 0; i < bits / 8; ++i)
+        {
+            used_inodes += __builtin_popcount(bytes[i]);
+        }
+        if (bits % 8 != 0)
+        {
+            used_inodes += __builtin_popcount(bytes[bits / 8] & ((1u << (bits % 8)) - 1));
+        }
+    }
+
+    long long free_blocks = countFreeBlocks();
+    if (free_blocks < 0)
+    {
+        return false;
+    }
+
+    if (superblock_.free_inodes_count != superblock_.total_inodes - used_inodes ||
+        superblock_.free_blocks_count != free_blocks)
+    {
+        std::cout << "信息: 校正空闲计数: i-node " << superblock_.free_inodes_count << " -> " << superblock_.total_inodes - used_inodes
+                  << ", 数据块 " << superblock_.free_blocks_count << " -> " << free_blocks << std::endl;
+    }
+    superblock_.free_inodes_count = superblock_.total_inodes - used_inodes;
+    superblock_.free_blocks_count = free_blocks;
+    inode_alloc_hint_ = 0;
+    return saveSuperBlock();
+}
@@ -4,14 +4,37 @@
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+
+namespace
+{
+    // 当前线程打开的事务层数: 嵌套的 beginTransaction 不等待提交 (提交正在等它所在的外层事务结束)
+    thread_local int transaction_depth = 0;
+}
 
 // VirtualDisk 构造函数
 // 初始化虚拟磁盘对象，记录磁盘文件路径和期望大小。
 // diskFilePath: 虚拟磁盘文件的路径。
 // diskSize: 虚拟磁盘的总大小（字节）。
-VirtualDisk::VirtualDisk(const std::string &diskFilePath, long long diskSize)
-    : diskFilePath_(diskFilePath), diskSize_(diskSize), totalBlocks_(0), blockSize_(DEFAULT_BLOCK_SIZE)
+// directIo: 为 true 时以 O_DIRECT 打开映像，绕过主机页缓存 (文件系统不支持时自动退回普通模式)。
+VirtualDisk::VirtualDisk(const std::string &diskFilePath, long long diskSize, bool directIo)
+    : diskFilePath_(diskFilePath), diskSize_(diskSize), totalBlocks_(0), blockSize_(DEFAULT_BLOCK_SIZE),
+      cache_(DEFAULT_BLOCK_SIZE, DEFAULT_BLOCK_CACHE_BYTES / DEFAULT_BLOCK_SIZE), disk_fd_(-1),
+      direct_io_(directIo), buffer_pool_(DEFAULT_BLOCK_SIZE, DIRECT_IO_ALIGNMENT, BUFFER_POOL_MAX_FREE), stop_flusher_(false),
+      journal_(this), commit_waiting_(false), batch_commit_failed_(false)
 {
+    // 淘汰脏块时同步写回 (此时已持有 cache_mutex_)
+    cache_.setWritebackHandler([this](BlockId blockId, const char *data)
+                               {
+                                   std::lock_guard<std::mutex> io_lock(io_mutex_);
+                                   writeToDisk(blockId, 1, data);
+                               });
+
     // 尝试打开文件以确定实际大小和块大小（如果文件已存在）
     std::fstream diskFile(diskFilePath_, std::ios::in | std::ios::binary | std::ios::ate);
     if (diskFile.is_open())
@@ -38,13 +61,177 @@ VirtualDisk::VirtualDisk(const std::string &diskFilePath, long long diskSize)
             totalBlocks_ = diskSize_ / blockSize_;
         }
     }
+    flusher_ = std::thread(&VirtualDisk::flusherLoop, this);
 }
 
 // VirtualDisk 析构函数
-// 目前不需要特殊操作。
+// 停止后台刷写线程，提交日志并把缓存中剩余的脏块写回磁盘，日志随之清空。
 VirtualDisk::~VirtualDisk()
 {
-    // 如果有文件流成员变量，确保在这里关闭
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        stop_flusher_ = true;
+    }
+    flusher_cv_.notify_one();
+    if (flusher_.joinable())
+    {
+        flusher_.join();
+    }
+    closeJournal();
+    {
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        if (log_)
+        {
+            log_->checkpoint(); // 下次挂载无需前滚
+        }
+    }
+    io_backend_.reset();
+    if (disk_fd_ >= 0)
+    {
+        ::close(disk_fd_);
+    }
+}
+
+// 打开磁盘映像的 POSIX 文件描述符并创建块 I/O 后端 (调用者需持有 io_mutex_)
+bool VirtualDisk::openDiskFd()
+{
+    if (disk_fd_ >= 0 && io_backend_)
+    {
+        return true;
+    }
+    if (disk_fd_ >= 0)
+    {
+        // 块大小改变后按新块大小重建后端
+        io_backend_ = BlockIoBackend::create(disk_fd_, static_cast<int>(blockSize_), IO_QUEUE_DEPTH);
+        return true;
+    }
+    disk_fd_ = ::open(diskFilePath_.c_str(), O_RDWR | (direct_io_ ? O_DIRECT : 0));
+    if (disk_fd_ < 0 && direct_io_ && errno == EINVAL)
+    {
+        std::cerr << "警告: 磁盘文件所在的文件系统不支持 O_DIRECT，改用普通 I/O。" << std::endl;
+        direct_io_ = false;
+        disk_fd_ = ::open(diskFilePath_.c_str(), O_RDWR);
+    }
+    if (disk_fd_ < 0)
+    {
+        std::cerr << "错误: 无法打开磁盘文件 '" << diskFilePath_ << "'。请确保文件已通过 createDiskFile 创建。" << std::endl;
+        return false;
+    }
+    io_backend_ = BlockIoBackend::create(disk_fd_, static_cast<int>(blockSize_), IO_QUEUE_DEPTH);
+    std::cout << "信息: 块 I/O 后端: " << io_backend_->name() << (direct_io_ ? " (O_DIRECT)" : "") << std::endl;
+    return true;
+}
+
+// 提交一批块请求并等待全部完成 (调用者需持有 io_mutex_)。
+// 请求中的块号是文件系统看到的逻辑块号: 日志结构布局下由 LogStructuredStore 翻译，原地布局下就是物理块号。
+bool VirtualDisk::submitIo(std::vector<BlockIoRequest> &requests)
+{
+    if (requests.empty())
+    {
+        return true;
+    }
+    if (!openDiskFd())
+    {
+        return false;
+    }
+    return log_ ? log_->submit(requests) : submitPhysical(requests);
+}
+
+// 按映像中的物理块号提交一批请求并等待全部完成 (调用者需持有 io_mutex_)
+bool VirtualDisk::submitPhysical(std::vector<BlockIoRequest> &requests)
+{
+    if (requests.empty())
+    {
+        return true;
+    }
+    if (!openDiskFd())
+    {
+        return false;
+    }
+
+    // O_DIRECT 下不满足对齐要求的请求单独经对齐的中转缓冲区完成，其余照常整批提交
+    bool ok = true;
+    std::vector<BlockIoRequest> unaligned;
+    if (direct_io_)
+    {
+        auto split = std::stable_partition(requests.begin(), requests.end(),
+                                           [this](const BlockIoRequest &request)
+                                           { return isDirectIoAligned(request); });
+        unaligned.assign(split, requests.end());
+        requests.erase(split, requests.end());
+        for (const BlockIoRequest &request : unaligned)
+        {
+            ok = bounceIo(request) && ok;
+        }
+    }
+
+    if (!requests.empty() && !io_backend_->submitAndWait(requests.data(), static_cast<int>(requests.size())))
+    {
+        for (const BlockIoRequest &request : requests)
+        {
+            if (!request.ok)
+            {
+                std::cerr << "错误: " << (request.is_write ? "写入" : "读取") << "块 " << request.start_block_id
+                          << " 起的 " << request.block_count << " 个块失败。" << std::endl;
+            }
+        }
+        ok = false;
+    }
+    return ok;
+}
+
+bool VirtualDisk::isDirectIoAligned(const BlockIoRequest &request) const
+{
+    long long offset = static_cast<long long>(request.start_block_id) * blockSize_;
+    long long length = static_cast<long long>(request.block_count) * blockSize_;
+    return reinterpret_cast<uintptr_t>(request.buffer) % DIRECT_IO_ALIGNMENT == 0 &&
+           offset % DIRECT_IO_ALIGNMENT == 0 && length % DIRECT_IO_ALIGNMENT == 0;
+}
+
+// 用对齐的中转缓冲区完成一个不对齐的请求: 读取覆盖它的对齐范围，写请求再把数据拼入后整体写回。
+// 对齐范围内其他块在磁盘上的内容原样写回，且全程持有 io_mutex_，不会覆盖其他写入。
+bool VirtualDisk::bounceIo(const BlockIoRequest &request)
+{
+    long long start = static_cast<long long>(request.start_block_id) * blockSize_;
+    long long length = static_cast<long long>(request.block_count) * blockSize_;
+    long long aligned_start = start / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    long long aligned_end = (start + length + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    AlignedBuffer bounce = buffer_pool_.acquire(aligned_end - aligned_start, false);
+
+    BlockIoRequest aligned = {false, aligned_start / blockSize_,
+                              static_cast<int>((aligned_end - aligned_start) / blockSize_), bounce.data(), false, false};
+    if (!io_backend_->submitAndWait(&aligned, 1))
+    {
+        std::cerr << "错误: 经中转缓冲区读取块 " << aligned.start_block_id << " 起的 " << aligned.block_count << " 个块失败。" << std::endl;
+        return false;
+    }
+    if (!request.is_write)
+    {
+        std::memcpy(request.buffer, bounce.data() + (start - aligned_start), length);
+        return true;
+    }
+    std::memcpy(bounce.data() + (start - aligned_start), request.buffer, length);
+    aligned.is_write = true;
+    if (!io_backend_->submitAndWait(&aligned, 1))
+    {
+        std::cerr << "错误: 经中转缓冲区写入块 " << aligned.start_block_id << " 起的 " << aligned.block_count << " 个块失败。" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 从磁盘文件读取连续的 count 个块 (调用者需持有 io_mutex_)
+bool VirtualDisk::readFromDisk(BlockId startBlockId, int count, char *buffer)
+{
+    std::vector<BlockIoRequest> requests = {{false, startBlockId, count, buffer, false, false}};
+    return submitIo(requests);
+}
+
+// 向磁盘文件写入连续的 count 个块 (调用者需持有 io_mutex_)
+bool VirtualDisk::writeToDisk(BlockId startBlockId, int count, const char *buffer)
+{
+    std::vector<BlockIoRequest> requests = {{true, startBlockId, count, const_cast<char *>(buffer), false, false}};
+    return submitIo(requests);
 }
 
 // 从虚拟磁盘读取一个数据块
@@ -52,7 +239,7 @@ VirtualDisk::~VirtualDisk()
 // buffer: 用于存储读取数据的缓冲区。
 // bufferSize: 缓冲区的实际大小，应等于或大于块大小。
 // 返回值: 如果读取成功则为 true，否则为 false。
-bool VirtualDisk::readBlock(int blockId, char *buffer, int bufferSize)
+bool VirtualDisk::readBlock(BlockId blockId, char *buffer, int bufferSize)
 {
     if (blockId < 0 || blockId >= totalBlocks_)
     {
@@ -64,51 +251,134 @@ bool VirtualDisk::readBlock(int blockId, char *buffer, int bufferSize)
         std::cerr << "错误: 缓冲区大小 " << bufferSize << " 小于块大小 " << blockSize_ << "." << std::endl;
         return false;
     }
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return readBlockLocked(blockId, buffer);
+}
 
-    std::fstream diskFile(diskFilePath_, std::ios::in | std::ios::binary);
-    if (!diskFile.is_open())
+bool VirtualDisk::readBlockLocked(BlockId blockId, char *buffer)
+{
+    if (cache_.lookup(blockId, buffer))
     {
-        std::cerr << "错误: 无法打开磁盘文件 '" << diskFilePath_ << "' 进行读取。" << std::endl;
-        return false;
+        return true;
     }
+    {
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        if (!readFromDisk(blockId, 1, buffer))
+        {
+            return false;
+        }
+    }
+    cache_.insert(blockId, buffer, false);
+    return true;
+}
 
-    diskFile.seekg(static_cast<long long>(blockId) * blockSize_, std::ios::beg);
-    if (diskFile.fail())
+// 从虚拟磁盘一次读取连续的多个块 (用于预读)，读到的块同时放入块缓存
+// startBlockId: 第一个块的ID。
+// count: 块数。
+// buffer: 至少 count * 块大小 字节的缓冲区。
+// 返回值: 如果全部读取成功则为 true，否则为 false。
+bool VirtualDisk::readBlocks(BlockId startBlockId, int count, char *buffer)
+{
+    if (count <= 0)
     {
-        std::cerr << "错误: 定位到块 " << blockId << " 失败。" << std::endl;
-        diskFile.close();
+        return true;
+    }
+    if (startBlockId < 0 || startBlockId + count > totalBlocks_)
+    {
+        std::cerr << "错误: 块范围 " << startBlockId << "+" << count << " 超出范围 (0-" << totalBlocks_ - 1 << ")." << std::endl;
         return false;
     }
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return readBlocksLocked(startBlockId, count, buffer);
+}
 
-    diskFile.read(buffer, blockSize_);
-    if (diskFile.gcount() != blockSize_)
+bool VirtualDisk::readBlocksLocked(BlockId startBlockId, int count, char *buffer)
+{
     {
-        // 文件末尾或者读取错误，但对于模拟磁盘，我们期望总是能读满一个块（除非是最后一个不完整的块，但这不应该发生）
-        std::cerr << "警告: 从块 " << blockId << " 读取的字节数 (" << diskFile.gcount() << ") 与期望的块大小 (" << blockSize_ << ") 不符。" << std::endl;
-        // 根据实际情况，这里可能返回 false，或者用0填充剩余部分
-        // 为简单起见，如果读取的字节数少于块大小，我们认为这是一个问题
-        if (diskFile.eof() && diskFile.gcount() < blockSize_ && diskFile.gcount() > 0)
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        if (!readFromDisk(startBlockId, count, buffer))
         {
-            // 如果是文件末尾并且读到了一些数据，可以考虑填充
+            return false;
         }
-        else if (diskFile.fail() && !diskFile.eof())
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        char *block = buffer + static_cast<long long>(i) * blockSize_;
+        // 缓存中的块 (可能尚未写回) 比磁盘上的新
+        if (!cache_.lookup(startBlockId + i, block))
         {
-            std::cerr << "错误: 从块 " << blockId << " 读取数据失败。" << std::endl;
-            diskFile.close();
-            return false;
+            cache_.insert(startBlockId + i, block, false);
         }
     }
-
-    diskFile.close();
     return true;
 }
 
+// 预读: 跳过已缓存的块，把剩余块号排序后合并成物理连续的段，每段一次读取
+void VirtualDisk::prefetchBlocks(const std::vector<BlockId> &blockIds)
+{
+    const int max_run_blocks = std::max(1, IO_MAX_RUN_BYTES / static_cast<int>(blockSize_)); // 每个读请求的块数上限
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    std::vector<BlockId> missing;
+    for (BlockId id : blockIds)
+    {
+        if (id >= 0 && id < totalBlocks_ && !cache_.contains(id))
+        {
+            missing.push_back(id);
+        }
+    }
+    if (missing.empty())
+    {
+        return;
+    }
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+    // 每个连续段一个请求，整批交给 I/O 后端，段之间并行
+    std::vector<BlockIoRequest> requests;
+    AlignedBuffer buffer = buffer_pool_.acquire(missing.size() * blockSize_, false);
+    size_t i = 0;
+    while (i < missing.size())
+    {
+        size_t run_end = i + 1;
+        while (run_end < missing.size() && missing[run_end] == missing[run_end - 1] + 1 && static_cast<int>(run_end - i) < max_run_blocks)
+        {
+            ++run_end;
+        }
+        requests.push_back({false, missing[i], static_cast<int>(run_end - i), buffer.data() + i * blockSize_, false, false});
+        i = run_end;
+    }
+    {
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        if (!submitIo(requests))
+        {
+            return; // 预读只是优化，失败时由正常读取路径报告错误
+        }
+    }
+    for (size_t k = 0; k < missing.size(); ++k)
+    {
+        cache_.insert(missing[k], buffer.data() + k * blockSize_, false);
+    }
+}
+
 // 向虚拟磁盘写入一个数据块
 //  blockId: 要写入的块的ID。
 //  buffer: 包含要写入数据的缓冲区。
 //  bufferSize: 要写入的数据的大小，应等于块大小。
 //  返回值: 如果写入成功则为 true，否则为 false。
-bool VirtualDisk::writeBlock(int blockId, const char *buffer, int bufferSize)
+// 写回模式: 数据只进入块缓存并标记为脏，由后台刷写线程按块号顺序写回磁盘。
+// 事务打开期间写入的块属于元数据，在事务提交到日志之前不会写回原位置。
+bool VirtualDisk::writeBlock(BlockId blockId, const char *buffer, int bufferSize)
+{
+    return writeBlockImpl(blockId, buffer, bufferSize, false);
+}
+
+// 写入文件内容: 与 writeBlock 相同，但不进入日志事务
+bool VirtualDisk::writeDataBlock(BlockId blockId, const char *buffer, int bufferSize)
+{
+    return writeBlockImpl(blockId, buffer, bufferSize, true);
+}
+
+bool VirtualDisk::writeBlockImpl(BlockId blockId, const char *buffer, int bufferSize, bool isData)
 {
     if (blockId < 0 || blockId >= totalBlocks_)
     {
@@ -122,33 +392,476 @@ bool VirtualDisk::writeBlock(int blockId, const char *buffer, int bufferSize)
         bufferSize = blockSize_; // 截断
     }
 
-    // 使用 std::ios::in | std::ios::out 以便文件不存在时不会创建，而是依赖 createDiskFile
-    // 但如果文件已存在，我们需要能够写入
-    std::fstream diskFile(diskFilePath_, std::ios::in | std::ios::out | std::ios::binary);
-    if (!diskFile.is_open())
+    bool wake_flusher;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        if (bufferSize == blockSize_)
+        {
+            cache_.insert(blockId, buffer, true);
+        }
+        else
+        {
+            // 部分写入: 块的剩余部分保持原样
+            AlignedBuffer block = buffer_pool_.acquire();
+            if (!readBlockLocked(blockId, block.data()))
+            {
+                return false;
+            }
+            std::memcpy(block.data(), buffer, bufferSize);
+            cache_.insert(blockId, block.data(), true);
+        }
+        journal_.recordWrite(blockId, isData);
+        wake_flusher = overDirtyRatio();
+    }
+    if (wake_flusher)
+    {
+        flusher_cv_.notify_one();
+    }
+    return true;
+}
+
+// 可写回的脏块占缓存容量的比例是否超过后台刷写阈值 (调用者需持有 cache_mutex_)。
+// 钉住的事务块不计入: 提交前刷写线程写不出它们，按它们唤醒只会反复空扫缓存。
+bool VirtualDisk::overDirtyRatio() const
+{
+    return cache_.unpinnedDirtyCount() * 100 >= cache_.capacity() * DIRTY_BACKGROUND_RATIO_PERCENT;
+}
+
+// 把在 dirtiedBefore 之前变脏的块按块号升序写回，物理连续的块合并为一个请求，
+// 每批最多 IO_QUEUE_DEPTH 个请求同时交给 I/O 后端。
+// 每批在持有 cache_mutex_ 时取出并标记为干净，随后先拿 io_mutex_ 再放开 cache_mutex_，
+// 保证之后对同一块的淘汰写回或磁盘读取都排在这批写入之后。
+bool VirtualDisk::writeBackDirty(std::chrono::steady_clock::time_point dirtiedBefore)
+{
+    const int max_run_blocks = std::max(1, IO_MAX_RUN_BYTES / static_cast<int>(blockSize_));
+    std::vector<BlockId> block_ids;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        block_ids = cache_.collectDirty(dirtiedBefore);
+    }
+
+    bool ok = true;
+    AlignedBuffer batch_buffer;
+    std::vector<BlockIoRequest> requests;
+    size_t i = 0;
+    while (i < block_ids.size())
+    {
+        std::unique_lock<std::mutex> cache_lock(cache_mutex_);
+        requests.clear();
+        size_t remaining = block_ids.size() - i;
+        size_t batch_bytes = std::min(remaining, static_cast<size_t>(IO_QUEUE_DEPTH) * max_run_blocks) * blockSize_;
+        if (batch_buffer.size() < batch_bytes)
+        {
+            batch_buffer = buffer_pool_.acquire(batch_bytes, false);
+        }
+        size_t used_blocks = 0;
+        while (i < block_ids.size() && requests.size() < static_cast<size_t>(IO_QUEUE_DEPTH))
+        {
+            BlockId start = block_ids[i];
+            int count = 0;
+            char *run = batch_buffer.data() + used_blocks * blockSize_;
+            while (i < block_ids.size() && count < max_run_blocks && block_ids[i] == start + count &&
+                   cache_.takeDirty(block_ids[i], run + static_cast<long long>(count) * blockSize_))
+            {
+                ++count;
+                ++i;
+            }
+            if (count == 0)
+            {
+                ++i; // 已被淘汰写回或丢弃
+                continue;
+            }
+            requests.push_back({true, start, count, run, false, false});
+            used_blocks += count;
+        }
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        cache_lock.unlock();
+        if (!submitIo(requests))
+        {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// 把全部未钉住的脏块写回原位置 (调用者需持有 cache_mutex_ 和 io_mutex_)，用于日志检查点
+bool VirtualDisk::writeBackAllLocked()
+{
+    return writeBackLocked(cache_.collectDirty(std::chrono::steady_clock::time_point::max()));
+}
+
+// 把 block_ids 中仍是未钉住脏块的块写回原位置，连续的块合并为一个请求 (调用者需持有 cache_mutex_ 和 io_mutex_)。
+// 已干净或不在缓存中的块跳过: 它们已经写回过。
+bool VirtualDisk::writeBackLocked(const std::vector<BlockId> &block_ids)
+{
+    const int max_run_blocks = std::max(1, IO_MAX_RUN_BYTES / static_cast<int>(blockSize_));
+    if (block_ids.empty())
+    {
+        return true;
+    }
+    AlignedBuffer buffer = buffer_pool_.acquire(block_ids.size() * blockSize_, false);
+    std::vector<BlockIoRequest> requests;
+    size_t used_blocks = 0;
+    size_t i = 0;
+    while (i < block_ids.size())
+    {
+        BlockId start = block_ids[i];
+        int count = 0;
+        char *run = buffer.data() + used_blocks * blockSize_;
+        while (i < block_ids.size() && count < max_run_blocks && block_ids[i] == start + count &&
+               cache_.takeDirty(block_ids[i], run + static_cast<long long>(count) * blockSize_))
+        {
+            ++count;
+            ++i;
+        }
+        if (count == 0)
+        {
+            ++i;
+            continue;
+        }
+        requests.push_back({true, start, count, run, false, false});
+        used_blocks += count;
+    }
+    return submitIo(requests);
+}
+
+// 等待磁盘映像的数据落盘 (调用者需持有 io_mutex_)。日志提交和检查点依赖它保证写入顺序。
+// 日志结构布局下先把待写部分段追加到日志。
+bool VirtualDisk::flushDeviceLocked()
+{
+    if (log_)
+    {
+        return log_->sync();
+    }
+    return fdatasyncLocked();
+}
+
+bool VirtualDisk::fdatasyncLocked()
+{
+    if (!openDiskFd())
     {
-        std::cerr << "错误: 无法打开磁盘文件 '" << diskFilePath_ << "' 进行写入。请确保文件已通过 createDiskFile 创建。" << std::endl;
         return false;
     }
+    if (::fdatasync(disk_fd_) != 0)
+    {
+        std::cerr << "错误: fdatasync 磁盘文件失败: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    diskFile.seekp(static_cast<long long>(blockId) * blockSize_, std::ios::beg);
-    if (diskFile.fail())
+// 提交运行中的日志事务: 先阻止新事务开始，等打开的事务全部结束后写入日志。
+// 本线程自己打开着事务 (例如批处理期间的 sync) 时不提交: 提交会拆开它，而且要等的正是它自己。
+bool VirtualDisk::commitJournalLocked(std::unique_lock<std::mutex> &lock)
+{
+    if (!journal_.enabled() || transaction_depth > 0)
     {
-        std::cerr << "错误: 定位到块 " << blockId << " 进行写入失败。" << std::endl;
-        diskFile.close();
+        return true;
+    }
+    commit_waiting_ = true;
+    journal_cv_.wait(lock, [this]
+                     { return journal_.openHandles() == 0; });
+    bool ok;
+    {
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        ok = journal_.commit();
+    }
+    commit_waiting_ = false;
+    journal_cv_.notify_all();
+    return ok;
+}
+
+void VirtualDisk::beginTransaction()
+{
+    std::unique_lock<std::mutex> lock(cache_mutex_);
+    if (transaction_depth == 0)
+    {
+        journal_cv_.wait(lock, [this]
+                         { return !commit_waiting_; });
+    }
+    ++transaction_depth;
+    journal_.addHandle();
+}
+
+// 结束一个事务。事务不单独提交: 已结束的事务在运行中的事务里累积，
+// 块数达到阈值或最早的写入超过 JOURNAL_COMMIT_INTERVAL_MS 时一起提交 (也可能由刷写线程或 sync 提交)。
+// 批处理 (本线程最外层的事务跨越多个操作) 中，唯一打开的就是它自己时正处在操作边界:
+// 缓存中的块正好是已完成操作的结果，运行中的事务达到阈值就先提交这一部分。
+// 大批处理由此成为多个各自一致的日志事务，钉住的块也不会超过提交阈值。
+void VirtualDisk::endTransaction()
+{
+    std::unique_lock<std::mutex> lock(cache_mutex_);
+    --transaction_depth;
+    journal_.dropHandle();
+    if (journal_.openHandles() == 0)
+    {
+        journal_cv_.notify_all();
+        if (journal_.commitDue(std::chrono::steady_clock::now()))
+        {
+            commitJournalLocked(lock);
+        }
+    }
+    else if (transaction_depth == 1 && journal_.openHandles() == 1 && journal_.runningFull())
+    {
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        if (!journal_.commit())
+        {
+            batch_commit_failed_ = true;
+        }
+    }
+}
+
+// 立即提交已结束的事务，不等待 group commit 的时间间隔
+bool VirtualDisk::commitJournal()
+{
+    std::unique_lock<std::mutex> lock(cache_mutex_);
+    bool ok = commitJournalLocked(lock) && !batch_commit_failed_;
+    batch_commit_failed_ = false;
+    return ok;
+}
+
+// 格式化时建立空日志 (日志区中旧文件系统的内容作废)
+bool VirtualDisk::formatJournal(BlockId startBlockId, int blockCount)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    return journal_.format(startBlockId, blockCount);
+}
+
+// 挂载时打开日志: 重放已提交但可能尚未写回原位置的事务。日志已在使用中时 (格式化后立即挂载) 不做任何事。
+bool VirtualDisk::openJournal(BlockId startBlockId, int blockCount)
+{
+    if (startBlockId < 0 || blockCount < 2 || startBlockId + blockCount > totalBlocks_)
+    {
+        std::cerr << "错误: 日志区 " << startBlockId << "+" << blockCount << " 超出磁盘范围。" << std::endl;
         return false;
     }
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    if (journal_.enabled())
+    {
+        return true;
+    }
+    return journal_.recover(startBlockId, blockCount);
+}
+
+// 停用日志前提交全部事务并做检查点，之后日志为空，下次挂载无需重放
+bool VirtualDisk::closeJournal()
+{
+    bool ok = sync();
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    ok = journal_.checkpoint() && ok;
+    journal_.disable();
+    return ok;
+}
+
+// 后台刷写线程: 周期性写回超过 DIRTY_EXPIRE_MS 的脏块；脏块比例超过阈值时被提前唤醒并写回全部脏块。
+// 同时负责提交已到期的日志事务 (group commit)。
+void VirtualDisk::flusherLoop()
+{
+    std::unique_lock<std::mutex> lock(cache_mutex_);
+    while (!stop_flusher_)
+    {
+        flusher_cv_.wait_for(lock, std::chrono::milliseconds(FLUSHER_INTERVAL_MS));
+        if (stop_flusher_)
+        {
+            break;
+        }
+        if (journal_.commitDue(std::chrono::steady_clock::now()))
+        {
+            commitJournalLocked(lock);
+        }
+        if (log_)
+        {
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> io_lock(io_mutex_);
+                log_->backgroundWork();
+            }
+            lock.lock();
+        }
+        bool write_all = overDirtyRatio();
+        if (cache_.unpinnedDirtyCount() == 0)
+        {
+            continue;
+        }
+        lock.unlock();
+        auto now = std::chrono::steady_clock::now();
+        writeBackDirty(write_all ? std::chrono::steady_clock::time_point::max()
+                                 : now - std::chrono::milliseconds(DIRTY_EXPIRE_MS));
+        lock.lock();
+    }
+}
 
-    diskFile.write(buffer, bufferSize);
-    if (diskFile.fail())
+// 提交日志中运行的事务，写回全部脏块，并等待后台线程正在进行的写入完成。
+// 本线程打开着事务时只写回未钉住的脏块，事务中的块留到事务结束后提交。
+// 日志结构布局下写回的块还要从待写部分段追加到日志。
+bool VirtualDisk::sync()
+{
+    bool ok;
     {
-        std::cerr << "错误: 向块 " << blockId << " 写入数据失败。" << std::endl;
-        diskFile.close();
+        std::unique_lock<std::mutex> lock(cache_mutex_);
+        ok = commitJournalLocked(lock);
+    }
+    ok = writeBackDirty(std::chrono::steady_clock::time_point::max()) && ok;
+    std::lock_guard<std::mutex> io_lock(io_mutex_); // 刷写线程写入期间一直持有 io_mutex_
+    if (log_)
+    {
+        ok = log_->flush() && ok;
+    }
+    return ok;
+}
+
+// 改变块大小: 块大小在格式化时选定并记录在超级块中，挂载时据此切换。
+// 先写回全部脏块，再清空块缓存、缓冲区池和 I/O 后端 (它们都按块大小工作)，总块数按新块大小重新计算。
+// blockSize: 必须是 MIN_BLOCK_SIZE 到 MAX_BLOCK_SIZE 之间的 2 的幂。
+bool VirtualDisk::setBlockSize(int blockSize)
+{
+    if (blockSize < MIN_BLOCK_SIZE || blockSize > MAX_BLOCK_SIZE || (blockSize & (blockSize - 1)) != 0)
+    {
+        std::cerr << "错误: 不支持的块大小 " << blockSize << " (应为 " << MIN_BLOCK_SIZE << " 到 "
+                  << MAX_BLOCK_SIZE << " 之间的 2 的幂)。" << std::endl;
+        return false;
+    }
+    if (blockSize == blockSize_)
+    {
+        return true;
+    }
+    if (diskSize_ / blockSize == 0)
+    {
+        std::cerr << "错误: 磁盘大小 " << diskSize_ << " 对于块大小 " << blockSize << " 太小。" << std::endl;
+        return false;
+    }
+    closeJournal(); // 日志按块大小组织，挂载时按新块大小重新打开
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    if (log_)
+    {
+        log_->checkpoint(); // 块映射同样按块大小组织，之后按物理块访问
+        log_.reset();
+    }
+    blockSize_ = blockSize;
+    totalBlocks_ = diskSize_ / blockSize_;
+    cache_.reset(blockSize, std::max<long long>(1, DEFAULT_BLOCK_CACHE_BYTES / blockSize));
+    buffer_pool_.setBufferSize(blockSize);
+    io_backend_.reset(); // 下次 I/O 时按新块大小重建
+    return true;
+}
+
+// 读取块 0 开头的 length 字节 (用于在得知块大小之前读取超级块)
+// 映像是日志结构布局时先按日志头切换块大小并加载块映射，块 0 是映射后的逻辑块 0。
+// 块 0 在缓存中时直接取缓存 (可能尚未写回)，否则按 O_DIRECT 对齐粒度读取。
+bool VirtualDisk::readHeader(char *buffer, int length)
+{
+    if (length <= 0 || length > blockSize_ || !loadLogLayout())
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    AlignedBuffer block = buffer_pool_.acquire(blockSize_, false);
+    if (cache_.lookup(0, block.data()))
+    {
+        std::memcpy(buffer, block.data(), length);
+        return true;
+    }
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    if (log_)
+    {
+        if (!readFromDisk(0, 1, block.data()))
+        {
+            return false;
+        }
+        std::memcpy(buffer, block.data(), length);
+        return true;
+    }
+    return readImageStart(buffer, length);
+}
+
+// 读取映像开头的 length 字节，按 O_DIRECT 对齐粒度读取 (调用者需持有 io_mutex_)
+bool VirtualDisk::readImageStart(char *buffer, int length)
+{
+    if (!openDiskFd())
+    {
+        return false;
+    }
+    size_t aligned_length = (static_cast<size_t>(length) + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    AlignedBuffer header = buffer_pool_.acquire(aligned_length);
+    ssize_t n;
+    do
+    {
+        n = ::pread(disk_fd_, header.data(), aligned_length, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < length)
+    {
+        return false;
+    }
+    std::memcpy(buffer, header.data(), length);
+    return true;
+}
+
+// 映像开头是日志头时切换到它记录的块大小，加载块映射并前滚；总块数变为日志结构布局的逻辑块数。
+// 已经加载或映像是原地布局时不做任何事。
+bool VirtualDisk::loadLogLayout()
+{
+    LogHeader header = {};
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        if (log_)
+        {
+            return true;
+        }
+        if (!readImageStart(reinterpret_cast<char *>(&header), sizeof(LogHeader)) || header.magic != LOG_MAGIC_NUMBER)
+        {
+            return true; // 原地布局 (或尚未格式化)，由调用者检查超级块
+        }
+    }
+    if (!setBlockSize(header.block_size))
+    {
+        std::cerr << "错误: 日志头中的块大小 " << header.block_size << " 无效。" << std::endl;
         return false;
     }
-    // 如果 bufferSize < blockSize_，块的剩余部分将保持原样或未定义，这取决于文件系统如何处理
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    auto store = std::make_unique<LogStructuredStore>(this);
+    if (!store->load(header))
+    {
+        return false;
+    }
+    cache_.clear(); // 缓存中的块是按物理块号读入的
+    totalBlocks_ = store->logicalBlocks();
+    log_ = std::move(store);
+    return true;
+}
 
-    diskFile.close();
+// 格式化时选择布局。旧布局下的块号不再有意义: 日志先停用，块缓存清空。
+// 原地布局清零映像开头，使旧的日志头不再被识别；日志结构布局在映像上建立空日志，总块数变为逻辑块数。
+bool VirtualDisk::formatLayout(DiskLayout layout)
+{
+    closeJournal();
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    cache_.clear();
+    log_.reset();
+    totalBlocks_ = diskSize_ / blockSize_;
+    if (layout == DiskLayout::IN_PLACE)
+    {
+        AlignedBuffer zero = buffer_pool_.acquire(blockSize_);
+        std::vector<BlockIoRequest> requests = {{true, 0, 1, zero.data(), false, false}};
+        return submitPhysical(requests);
+    }
+    if (!openDiskFd())
+    {
+        return false;
+    }
+    auto store = std::make_unique<LogStructuredStore>(this);
+    if (!store->format(totalBlocks_))
+    {
+        return false;
+    }
+    totalBlocks_ = store->logicalBlocks();
+    log_ = std::move(store);
     return true;
 }
 
@@ -159,6 +872,12 @@ long long VirtualDisk::getTotalBlocks() const
     return totalBlocks_;
 }
 
+// 对齐缓冲区池: 块大小的缓冲区可复用，地址满足 O_DIRECT 的对齐要求
+AlignedBufferPool &VirtualDisk::bufferPool()
+{
+    return buffer_pool_;
+}
+
 // 获取虚拟磁盘的块大小
 // 返回值: 块大小（字节）。
 int VirtualDisk::getBlockSize() const
@@ -224,43 +943,32 @@ bool VirtualDisk::createDiskFile()
         diskFile.close(); // 关闭后以 trunc 模式重新打开以清空并设置大小
     }
 
-    // 文件不存在或为空，创建新文件
+    // 文件不存在或为空，创建新文件；旧内容作废，缓存 (包括脏块) 一并清空
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        journal_.disable();
+        cache_.clear();
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        log_.reset();
+    }
+    std::lock_guard<std::mutex> io_lock(io_mutex_); // 等待刷写线程正在进行的写入
     std::ofstream newDiskFile(diskFilePath_, std::ios::binary | std::ios::trunc);
     if (!newDiskFile.is_open())
     {
         std::cerr << "错误: 无法创建或打开磁盘文件 '" << diskFilePath_ << "' 进行初始化。" << std::endl;
         return false;
     }
+    newDiskFile.close();
 
-    // 将文件扩展到指定大小，用零填充
-    // 注意：直接 seekp 然后 write 一个字节可能不足以保证文件在所有系统上都被正确分配空间
-    // 更可靠（但可能较慢）的方法是逐块写入或写入一个大的零缓冲区
-    std::vector<char> zeroBlock(blockSize_, 0); // 创建一个全零的块
-    for (long long i = 0; i < totalBlocks_; ++i)
+    // 用 truncate 把文件扩展到指定大小: 生成稀疏文件，未写过的部分读出为 0，
+    // 多 TB 的映像也无需逐块写零
+    if (::truncate(diskFilePath_.c_str(), diskSize_) != 0)
     {
-        if (!newDiskFile.write(zeroBlock.data(), blockSize_))
-        {
-            std::cerr << "错误: 初始化磁盘文件时写入块 " << i << " 失败。" << std::endl;
-            newDiskFile.close();
-            // 可以考虑删除部分创建的文件
-            std::remove(diskFilePath_.c_str());
-            return false;
-        }
-    }
-    // 处理磁盘大小不是块大小整数倍的剩余部分
-    long long remainder = diskSize_ % blockSize_;
-    if (remainder > 0)
-    {
-        if (!newDiskFile.write(zeroBlock.data(), remainder))
-        {
-            std::cerr << "错误: 初始化磁盘文件时写入剩余 " << remainder << " 字节失败。" << std::endl;
-            newDiskFile.close();
-            std::remove(diskFilePath_.c_str());
-            return false;
-        }
+        std::cerr << "错误: 无法把磁盘文件扩展到 " << diskSize_ << " 字节: " << std::strerror(errno) << std::endl;
+        std::remove(diskFilePath_.c_str());
+        return false;
     }
 
     std::cout << "信息: 虚拟磁盘文件 '" << diskFilePath_ << "' 已成功创建并初始化为 " << diskSize_ << " 字节。" << std::endl;
-    newDiskFile.close();
     return true;
 }
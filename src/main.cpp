@@ -2,18 +2,35 @@
 
 int main(int argc, char *argv[])
 {
-    // Check command line arguments
-    if (argc < 2)
+    // Check command line arguments; --direct-io, --block-size=<bytes> and --log-structured may appear anywhere
+    bool directIo = false;
+    DiskLayout layout = DiskLayout::IN_PLACE; // only used when the disk gets formatted
+    int blockSize = DEFAULT_BLOCK_SIZE; // only used when the disk gets formatted
+    std::vector<std::string> positional;
+    const std::string blockSizeOption = "--block-size=";
+    for (int i = 1; i < argc; ++i)
     {
-        std::cerr << "Usage: " << argv[0] << " <disk_file_path> [disk_size_in_bytes]" << std::endl;
+        std::string arg = argv[i];
+        if (arg == "--direct-io")
+            directIo = true;
+        else if (arg == "--log-structured")
+            layout = DiskLayout::LOG_STRUCTURED;
+        else if (arg.compare(0, blockSizeOption.size(), blockSizeOption) == 0)
+            blockSize = std::stoi(arg.substr(blockSizeOption.size()));
+        else
+            positional.push_back(argv[i]);
+    }
+    if (positional.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " <disk_file_path> [disk_size_in_bytes] [--direct-io] [--block-size=<bytes>] [--log-structured]" << std::endl;
         return 1;
     }
 
-    std::string diskFilePath = argv[1];
-    long long diskSize = (argc >= 3) ? std::stoll(argv[2]) : DEFAULT_DISK_SIZE;
+    std::string diskFilePath = positional[0];
+    long long diskSize = (positional.size() >= 2) ? std::stoll(positional[1]) : DEFAULT_DISK_SIZE;
 
     // Initialize the file system
-    FileSystem fs(diskFilePath, diskSize);
+    FileSystem fs(diskFilePath, diskSize, DEFAULT_MAX_SYSTEM_OPEN_FILES, DEFAULT_MAX_OPEN_FILES_PER_PROCESS, directIo, blockSize, layout);
 
     // Mount the file system
     if (!fs.mount())
@@ -95,6 +95,22 @@ void Shell::executeCommand(const std::vector<std::string> &tokens)
     { //
         handleRm(tokens);
     }
+    else if (command == "cp")
+    {
+        handleCp(tokens);
+    }
+    else if (command == "mv")
+    {
+        handleMv(tokens);
+    }
+    else if (command == "find")
+    {
+        handleFind(tokens);
+    }
+    else if (command == "index")
+    {
+        handleIndex(tokens);
+    }
     else if (command == "open")
     {
         handleOpen(tokens);
@@ -111,6 +127,18 @@ void Shell::executeCommand(const std::vector<std::string> &tokens)
     {
         handleRead(tokens);
     }
+    else if (command == "seek")
+    {
+        handleSeek(tokens);
+    }
+    else if (command == "fsync")
+    {
+        handleFsync(tokens);
+    }
+    else if (command == "sync")
+    {
+        handleSync(tokens);
+    }
 
     else if (command == "help")
     {                       //
@@ -211,6 +239,62 @@ void Shell::handleRm(const std::vector<std::string> &args)
     }
 }
 
+void Shell::handleCp(const std::vector<std::string> &args)
+{
+    // 解析 -r 参数，其余依次为源路径和目标路径
+    bool recursive = false;
+    std::vector<std::string> paths;
+    for (size_t i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-r")
+            recursive = true;
+        else
+            paths.push_back(args[i]);
+    }
+    if (paths.size() != 2)
+    {
+        std::cerr << "Usage: cp [-r] <source> <destination>" << std::endl;
+    }
+    else if (!fs_->cp(paths[0], paths[1], recursive))
+    {
+        std::cerr << "cp: Failed to copy " << paths[0] << " to " << paths[1] << std::endl;
+    }
+}
+
+void Shell::handleMv(const std::vector<std::string> &args)
+{
+    if (args.size() != 3)
+    {
+        std::cerr << "Usage: mv <source> <destination>" << std::endl;
+    }
+    else if (!fs_->mv(args[1], args[2]))
+    {
+        std::cerr << "mv: Failed to move " << args[1] << " to " << args[2] << std::endl;
+    }
+}
+
+void Shell::handleFind(const std::vector<std::string> &args)
+{
+    if (args.size() < 2 || args.size() > 3)
+    {
+        std::cerr << "Usage: find [start_path] <name|pattern>" << std::endl;
+        return;
+    }
+    std::string startPath = (args.size() == 3) ? args[1] : "."; // 默认从当前目录开始
+    for (const std::string &path : fs_->find(startPath, args.back()))
+    {
+        std::cout << path << std::endl;
+    }
+}
+
+void Shell::handleIndex(const std::vector<std::string> &args)
+{
+    if (!fs_->buildNameIndex())
+    {
+        std::cerr << "index: Failed to build the filename index" << std::endl;
+    }
+}
+
 void Shell::handleLogout(const std::vector<std::string> &args)
 {                      //
     fs_->logoutUser(); //
@@ -392,6 +476,93 @@ void Shell::handleWrite(const std::vector<std::string> &args)
     }
 }
 
+void Shell::handleSeek(const std::vector<std::string> &args)
+{
+    if (args.size() < 3)
+    {
+        std::cerr << "Usage: seek <fd> <offset> [SEEK_SET|SEEK_CUR|SEEK_END]" << std::endl;
+        return;
+    }
+    int whence = SEEK_SET;
+    if (args.size() > 3)
+    {
+        if (args[3] == "SEEK_SET")
+            whence = SEEK_SET;
+        else if (args[3] == "SEEK_CUR")
+            whence = SEEK_CUR;
+        else if (args[3] == "SEEK_END")
+            whence = SEEK_END;
+        else
+        {
+            std::cerr << "Invalid whence: " << args[3] << ". Use SEEK_SET, SEEK_CUR or SEEK_END." << std::endl;
+            return;
+        }
+    }
+    try
+    {
+        int fd = std::stoi(args[1]);
+        long long offset = std::stoll(args[2]);
+        long long new_offset = fs_->lseek(fd, offset, whence);
+        if (new_offset >= 0)
+        {
+            std::cout << "File descriptor " << fd << " now at offset " << new_offset << "." << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to seek file descriptor " << fd << "." << std::endl;
+        }
+    }
+    catch (const std::invalid_argument &ia)
+    {
+        std::cerr << "Invalid argument format for fd or offset. Must be integers." << std::endl;
+    }
+    catch (const std::out_of_range &oor)
+    {
+        std::cerr << "Argument for fd or offset is out of range." << std::endl;
+    }
+}
+
+void Shell::handleFsync(const std::vector<std::string> &args)
+{
+    if (args.size() < 2)
+    {
+        std::cerr << "Usage: fsync <fd>" << std::endl;
+        return;
+    }
+    try
+    {
+        int fd = std::stoi(args[1]);
+        if (fs_->fsync(fd))
+        {
+            std::cout << "File descriptor " << fd << " synced." << std::endl;
+        }
+        else
+        {
+            std::cerr << "Failed to sync file descriptor " << fd << "." << std::endl;
+        }
+    }
+    catch (const std::invalid_argument &ia)
+    {
+        std::cerr << "Invalid argument format for fd. Must be an integer." << std::endl;
+    }
+    catch (const std::out_of_range &oor)
+    {
+        std::cerr << "Argument for fd is out of range." << std::endl;
+    }
+}
+
+void Shell::handleSync(const std::vector<std::string> &args)
+{
+    if (fs_->sync())
+    {
+        std::cout << "All data written to disk." << std::endl;
+    }
+    else
+    {
+        std::cerr << "Failed to write some data to disk." << std::endl;
+    }
+}
+
 void Shell::handleHelp(const std::vector<std::string> &args)
 { //
     std::cout << "Available commands:" << std::endl;
@@ -406,12 +577,16 @@ void Shell::handleHelp(const std::vector<std::string> &args)
     std::cout << "  close <fd>                    - Close an open file descriptor" << std::endl;               //
     std::cout << "  read <fd> <length>            - Read from an open file" << std::endl;                      //
     std::cout << "  write <fd> <data>             - Write to an open file" << std::endl;                       //
+    std::cout << "  seek <fd> <offset> [whence]   - Move the file offset (SEEK_SET, SEEK_CUR, SEEK_END)" << std::endl;
+    std::cout << "  fsync <fd>                    - Write an open file's data to disk" << std::endl;
+    std::cout << "  sync                          - Write all cached data to disk" << std::endl;
     std::cout << "  cp [-r] <source> <destination> - Copy a file or directory" << std::endl;                   //
     std::cout << "  mv <source> <destination>     - Move/rename a file or directory" << std::endl;             //
     std::cout << "  ln <target> <link_name>       - Create a hard link" << std::endl;                          //
     std::cout << "  chmod <path> <mode>           - Change file permissions (e.g., 755)" << std::endl;         //
     std::cout << "  chown <path> <username>       - Change file owner" << std::endl;                           //
-    std::cout << "  find [start_path] <filename>  - Find a file" << std::endl;                                 //
+    std::cout << "  find [start_path] <name>      - Find files by name or glob pattern (e.g. '*.log')" << std::endl;
+    std::cout << "  index                         - Build the filename index used by find" << std::endl;
     std::cout << "  format                        - Format the disk (CAUTION: deletes all data)" << std::endl; //
     std::cout << "  help                          - Display this help message" << std::endl;
     std::cout << "  exit                          - Exit the shell" << std::endl;